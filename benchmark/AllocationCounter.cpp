@@ -0,0 +1,36 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> allocation_count{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+}// namespace
+
+uint64_t lesma::bench::getAllocationCount() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+uint64_t lesma::bench::getAllocatedBytes() {
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+// Array and nothrow variants forward to these in libstdc++ and libc++
+void *operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+namespace lesma::bench {
+    uint64_t getAllocationCount();
+    uint64_t getAllocatedBytes();
+
+    /**
+     * Counts the heap allocations done by the measured regions of a benchmark, through the global operator new
+     * replaced in AllocationCounter.cpp. Start and Stop bracket every region, Report attaches per-iteration averages.
+     */
+    class AllocationMeter {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        uint64_t start_count = 0;
+        uint64_t start_bytes = 0;
+
+    public:
+        void Start() {
+            start_count = getAllocationCount();
+            start_bytes = getAllocatedBytes();
+        }
+
+        void Stop() {
+            count += getAllocationCount() - start_count;
+            bytes += getAllocatedBytes() - start_bytes;
+        }
+
+        void Report(benchmark::State &state) const {
+            state.counters["allocs"] = benchmark::Counter(static_cast<double>(count), benchmark::Counter::kAvgIterations);
+            state.counters["alloc_bytes"] = benchmark::Counter(static_cast<double>(bytes), benchmark::Counter::kAvgIterations, benchmark::Counter::kIs1024);
+        }
+    };
+}// namespace lesma::bench
@@ -0,0 +1,174 @@
+#include "CorpusGenerator.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "fmt/format.h"
+
+using namespace lesma::bench;
+
+namespace {
+    const char *operators[] = {"+", "-", "*"};
+
+    std::string genLeaf(size_t seed, size_t local) {
+        switch (seed % 4) {
+            case 0:
+                return "a";
+            case 1:
+                return "b";
+            case 2:
+                return local == 0 ? "a" : fmt::format("v{}", local - 1);
+            default:
+                return std::to_string(seed % 97 + 1);
+        }
+    }
+
+    // Left-deep chain so the size of the expression grows linearly with the depth
+    std::string genExpression(unsigned int depth, size_t seed, size_t local) {
+        std::string expr = genLeaf(seed, local);
+        for (unsigned int i = 0; i < depth; i++)
+            expr = fmt::format("({} {} {})", expr, operators[(seed + i) % 3], genLeaf(seed + i + 1, local));
+        return expr;
+    }
+
+    size_t genFunction(std::ostringstream &out, const std::string &name, size_t statements, unsigned int depth, size_t seed, bool exported) {
+        out << (exported ? "export " : "") << "def " << name << "(a: int, b: int) -> int\n";
+        for (size_t j = 0; j < statements; j++)
+            out << "    var v" << j << " = " << genExpression(depth, seed + j, j) << "\n";
+        out << "    if v" << statements - 1 << " > a\n";
+        out << "        return v" << statements - 1 << " - a\n";
+        out << "    return v" << statements - 1 << "\n";
+
+        return statements + 4;
+    }
+
+    size_t genClass(std::ostringstream &out, size_t index) {
+        out << "class C" << index << "\n";
+        out << "    var x: int\n";
+        out << "    def new(v: int)\n";
+        out << "        self.x = v\n";
+        out << "    def get(y: int) -> int\n";
+        out << "        return self.x * y + " << index % 97 << "\n";
+
+        return 6;
+    }
+
+    void writeFile(const std::filesystem::path &path, const std::string &contents) {
+        std::ofstream file(path);
+        file << contents;
+    }
+}// namespace
+
+namespace lesma::bench {
+    CorpusOptions getCorpusOptions(CorpusShape shape, size_t lines) {
+        switch (shape) {
+            case CorpusShape::FUNCTIONS:
+                return {lines, std::max<size_t>(lines / 16, 1), 2, 0, 0};
+            case CorpusShape::EXPRESSIONS:
+                return {lines, std::max<size_t>(lines / 256, 1), 32, 0, 0};
+            case CorpusShape::CLASSES:
+                return {lines, std::max<size_t>(lines / 64, 1), 2, std::max<size_t>(lines / 32, 1), 0};
+            case CorpusShape::IMPORTS:
+                return {lines, std::max<size_t>(lines / 16, 1), 2, 0, 16};
+        }
+
+        return {lines, 1, 1, 0, 0};
+    }
+
+    std::string getCorpusShapeName(CorpusShape shape) {
+        switch (shape) {
+            case CorpusShape::FUNCTIONS:
+                return "Functions";
+            case CorpusShape::EXPRESSIONS:
+                return "Expressions";
+            case CorpusShape::CLASSES:
+                return "Classes";
+            case CorpusShape::IMPORTS:
+                return "Imports";
+        }
+
+        return "Unknown";
+    }
+
+    static std::string generateCorpus(const CorpusOptions &options, const std::filesystem::path &dir) {
+        std::ostringstream out;
+        size_t lines = 0;
+
+        // Every imported module exports a single function backed by a few private ones
+        for (size_t i = 0; i < options.imports; i++) {
+            std::ostringstream module;
+            for (size_t j = 0; j < 8; j++)
+                genFunction(module, fmt::format("h{}", j), 8, options.expr_depth, i + j, false);
+            genFunction(module, "g", 8, options.expr_depth, i, true);
+            writeFile(dir / fmt::format("mod{}.les", i), module.str());
+
+            out << "import \"mod" << i << ".les\"\n";
+            lines++;
+        }
+
+        for (size_t i = 0; i < options.classes; i++)
+            lines += genClass(out, i);
+
+        // Top-level code references every declaration so the optimizer can't drop them
+        size_t top_level = 1 + options.functions + 2 * options.classes + options.imports;
+        size_t remaining = options.lines > lines + top_level ? options.lines - lines - top_level : 0;
+        size_t statements = std::max<size_t>(remaining / options.functions, 5) - 4;
+
+        for (size_t i = 0; i < options.functions; i++)
+            lines += genFunction(out, fmt::format("f{}", i), statements, options.expr_depth, i, false);
+
+        out << "var acc = 0\n";
+        for (size_t i = 0; i < options.functions; i++)
+            out << "acc = acc + f" << i << "(" << i % 97 << ", 3)\n";
+        for (size_t i = 0; i < options.classes; i++) {
+            out << "var c" << i << " = C" << i << "(" << i % 97 << ")\n";
+            out << "acc = acc + c" << i << ".get(2)\n";
+        }
+        for (size_t i = 0; i < options.imports; i++)
+            out << "acc = acc + mod" << i << ".g(" << i << ", 3)\n";
+
+        return out.str();
+    }
+
+    const Corpus &getGeneratedCorpus(CorpusShape shape, size_t lines) {
+        static std::map<std::pair<CorpusShape, size_t>, Corpus> cache;
+
+        auto key = std::make_pair(shape, lines);
+        auto it = cache.find(key);
+        if (it != cache.end())
+            return it->second;
+
+        auto dir = std::filesystem::temp_directory_path() / "lesma-corpus" / fmt::format("{}-{}", getCorpusShapeName(shape), lines);
+        std::filesystem::create_directories(dir);
+
+        Corpus corpus;
+        corpus.filename = (dir / "main.les").string();
+        corpus.source = generateCorpus(getCorpusOptions(shape, lines), dir);
+        corpus.lines = std::count(corpus.source.begin(), corpus.source.end(), '\n');
+        writeFile(corpus.filename, corpus.source);
+
+        return cache.emplace(key, std::move(corpus)).first->second;
+    }
+
+    const Corpus &getFileCorpus(const std::string &filename) {
+        static std::map<std::string, Corpus> cache;
+
+        auto it = cache.find(filename);
+        if (it != cache.end())
+            return it->second;
+
+        std::ifstream file(filename);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+
+        Corpus corpus;
+        corpus.filename = filename;
+        corpus.source = buffer.str();
+        corpus.lines = std::count(corpus.source.begin(), corpus.source.end(), '\n') + 1;
+
+        return cache.emplace(filename, std::move(corpus)).first->second;
+    }
+}// namespace lesma::bench
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace lesma::bench {
+    enum class CorpusShape {
+        FUNCTIONS,  // Many small functions with shallow expressions
+        EXPRESSIONS,// Few large functions with deeply nested expressions
+        CLASSES,    // Classes with fields, constructors and methods
+        IMPORTS,    // Main module importing a fan-out of modules
+    };
+
+    struct CorpusOptions {
+        size_t lines;
+        size_t functions;
+        unsigned int expr_depth;
+        size_t classes;
+        size_t imports;
+    };
+
+    struct Corpus {
+        std::string filename;
+        std::string source;
+        size_t lines;
+    };
+
+    CorpusOptions getCorpusOptions(CorpusShape shape, size_t lines);
+    std::string getCorpusShapeName(CorpusShape shape);
+
+    // Generated sources are written to a temporary directory so imports can be resolved, and cached for the process lifetime
+    const Corpus &getGeneratedCorpus(CorpusShape shape, size_t lines);
+    const Corpus &getFileCorpus(const std::string &filename);
+}// namespace lesma::bench
@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+
+#include "runtime/Runtime.h"
+
+namespace {
+    // Same layout as the Node class of benchmark/runtime/binary_trees.les
+    struct Node {
+        Node *left;
+        Node *right;
+        bool leaf;
+    };
+
+    struct RuntimeAllocator {
+        static void *allocate(size_t size) { return lesma_alloc(static_cast<int64_t>(size)); }
+        static void release(void *ptr) { lesma_free(ptr); }
+    };
+
+    struct SystemAllocator {
+        static void *allocate(size_t size) { return std::malloc(size); }
+        static void release(void *ptr) { std::free(ptr); }
+    };
+
+    template<typename Allocator>
+    Node *bottomUp(int depth) {
+        auto node = static_cast<Node *>(Allocator::allocate(sizeof(Node)));
+        node->leaf = depth == 0;
+        node->left = node->leaf ? nullptr : bottomUp<Allocator>(depth - 1);
+        node->right = node->leaf ? nullptr : bottomUp<Allocator>(depth - 1);
+        return node;
+    }
+
+    template<typename Allocator>
+    int64_t check(Node *node) {
+        return node->leaf ? 1 : 1 + check<Allocator>(node->left) + check<Allocator>(node->right);
+    }
+
+    template<typename Allocator>
+    void release(Node *node) {
+        if (!node->leaf) {
+            release<Allocator>(node->left);
+            release<Allocator>(node->right);
+        }
+        Allocator::release(node);
+    }
+}// namespace
+
+// Builds, walks and frees a complete tree of the given depth, the allocation pattern of binary-trees
+template<typename Allocator>
+static void BM_BinaryTrees(benchmark::State &state) {
+    auto depth = static_cast<int>(state.range(0));
+    for ([[maybe_unused]] auto _: state) {
+        Node *tree = bottomUp<Allocator>(depth);
+        benchmark::DoNotOptimize(check<Allocator>(tree));
+        release<Allocator>(tree);
+    }
+    state.SetItemsProcessed(state.iterations() * ((int64_t{1} << (depth + 1)) - 1));
+}
+
+// Keeps a long-lived tree alive while short-lived ones are churned, so freed objects are interleaved with live ones
+template<typename Allocator>
+static void BM_BinaryTreesLongLived(benchmark::State &state) {
+    auto depth = static_cast<int>(state.range(0));
+    Node *longLived = bottomUp<Allocator>(depth + 2);
+    for ([[maybe_unused]] auto _: state) {
+        Node *tree = bottomUp<Allocator>(depth);
+        benchmark::DoNotOptimize(check<Allocator>(tree));
+        release<Allocator>(tree);
+    }
+    release<Allocator>(longLived);
+    state.SetItemsProcessed(state.iterations() * ((int64_t{1} << (depth + 1)) - 1));
+}
+
+BENCHMARK_TEMPLATE(BM_BinaryTrees, RuntimeAllocator)->Arg(4)->Arg(12)->Arg(18);
+BENCHMARK_TEMPLATE(BM_BinaryTrees, SystemAllocator)->Arg(4)->Arg(12)->Arg(18);
+BENCHMARK_TEMPLATE(BM_BinaryTreesLongLived, RuntimeAllocator)->Arg(12);
+BENCHMARK_TEMPLATE(BM_BinaryTreesLongLived, SystemAllocator)->Arg(12);
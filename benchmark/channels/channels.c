@@ -0,0 +1,143 @@
+// C reference for channels.les, with the channel a ring buffer behind a mutex and two condition variables, growing
+// when it's full if CHANNEL_CAPACITY is 0.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    long long *values;
+    long long capacity;
+    long long head;
+    long long count;
+    bool growable;
+    bool closed;
+} channel;
+
+static channel *channel_new(long long capacity) {
+    channel *c = calloc(1, sizeof(channel));
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->not_empty, NULL);
+    pthread_cond_init(&c->not_full, NULL);
+    c->growable = capacity == 0;
+    c->capacity = capacity > 0 ? capacity : 1024;
+    c->values = malloc(sizeof(long long) * (size_t) c->capacity);
+    return c;
+}
+
+static void channel_send(channel *c, long long value) {
+    pthread_mutex_lock(&c->lock);
+    if (c->count == c->capacity && c->growable) {
+        long long *values = malloc(sizeof(long long) * (size_t) c->capacity * 2);
+        for (long long i = 0; i < c->count; i++)
+            values[i] = c->values[(c->head + i) % c->capacity];
+        free(c->values);
+        c->values = values;
+        c->head = 0;
+        c->capacity *= 2;
+    }
+    while (c->count == c->capacity)
+        pthread_cond_wait(&c->not_full, &c->lock);
+    c->values[(c->head + c->count) % c->capacity] = value;
+    c->count++;
+    pthread_cond_signal(&c->not_empty);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static bool channel_recv(channel *c, long long *value) {
+    pthread_mutex_lock(&c->lock);
+    while (c->count == 0 && !c->closed)
+        pthread_cond_wait(&c->not_empty, &c->lock);
+    if (c->count == 0) {
+        pthread_mutex_unlock(&c->lock);
+        return false;
+    }
+    *value = c->values[c->head];
+    c->head = (c->head + 1) % c->capacity;
+    c->count--;
+    pthread_cond_signal(&c->not_full);
+    pthread_mutex_unlock(&c->lock);
+    return true;
+}
+
+static void channel_close(channel *c) {
+    pthread_mutex_lock(&c->lock);
+    c->closed = true;
+    pthread_cond_broadcast(&c->not_empty);
+    pthread_mutex_unlock(&c->lock);
+}
+
+static channel *queue;
+static channel *replies;
+static long long messages;
+
+static void *produce(void *arg) {
+    (void) arg;
+    for (long long i = 0; i < messages; i++)
+        channel_send(queue, i);
+    return NULL;
+}
+
+static void *consume(void *arg) {
+    long long total = 0;
+    long long value;
+    while (channel_recv(queue, &value))
+        total += value;
+    *(long long *) arg = total;
+    return NULL;
+}
+
+static void *bounce(void *arg) {
+    (void) arg;
+    long long value;
+    while (channel_recv(queue, &value))
+        channel_send(replies, value + 1);
+    return NULL;
+}
+
+int main(void) {
+    int producers = atoi(getenv("CHANNEL_PRODUCERS"));
+    int consumers = atoi(getenv("CHANNEL_CONSUMERS"));
+    messages = atoll(getenv("CHANNEL_MESSAGES"));
+    long long capacity = atoll(getenv("CHANNEL_CAPACITY"));
+    long long rounds = atoll(getenv("CHANNEL_ROUNDS"));
+
+    if (rounds > 0) {
+        queue = channel_new(1);
+        replies = channel_new(1);
+        pthread_t bouncer;
+        pthread_create(&bouncer, NULL, bounce, NULL);
+        long long value = 0;
+        for (long long i = 0; i < rounds; i++) {
+            channel_send(queue, value);
+            channel_recv(replies, &value);
+        }
+        channel_close(queue);
+        pthread_join(bouncer, NULL);
+        printf("%lld\n", value);
+        return 0;
+    }
+
+    queue = channel_new(capacity);
+    pthread_t *threads = malloc(sizeof(pthread_t) * (size_t) (producers + consumers));
+    long long *totals = calloc((size_t) consumers, sizeof(long long));
+    for (int i = 0; i < consumers; i++)
+        pthread_create(&threads[i], NULL, consume, &totals[i]);
+    for (int i = 0; i < producers; i++)
+        pthread_create(&threads[consumers + i], NULL, produce, NULL);
+
+    for (int i = 0; i < producers; i++)
+        pthread_join(threads[consumers + i], NULL);
+    channel_close(queue);
+    long long total = 0;
+    for (int i = 0; i < consumers; i++) {
+        pthread_join(threads[i], NULL);
+        total += totals[i];
+    }
+    printf("%lld\n", total);
+    return 0;
+}
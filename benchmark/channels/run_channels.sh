@@ -0,0 +1,115 @@
+#!/bin/bash
+# Measures the throughput of Lesma channels with 1 to 16 producers and as many consumers, unbounded and bounded,
+# and the round trip latency of a pair of channels, against the mutex and condition variable queue of channels.c.
+# Outputs are compared against the C reference and the results are written as JSON.
+#
+# Usage: run_channels.sh [lesma] [clang] [output.json] [messages] [capacity] [rounds] [repetitions]
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+
+compiler_path="${1:-${SCRIPT_DIR}/../../build/lesma}"
+clang_path="${2:-clang}"
+output_path="${3:-}"
+messages="${4:-1000000}"
+capacity="${5:-1024}"
+rounds="${6:-100000}"
+repetitions="${7:-3}"
+
+work_dir=$(mktemp -d)
+trap 'rm -rf "${work_dir}"' EXIT
+
+mismatch_count=0
+results=()
+c_ns=0
+lesma_ns=0
+
+now_ns() {
+  date +%s%N
+}
+
+min() {
+  printf "%s\n" "$@" | sort -g | head -n 1
+}
+
+"${clang_path}" -O3 -pthread -o "${work_dir}/channels_c" "${SCRIPT_DIR}/channels.c" || exit 1
+(cd "${work_dir}" && "${compiler_path}" compile "${SCRIPT_DIR}/channels.les" -o channels_lesma) || exit 1
+
+# Runs an implementation `repetitions` times, saves its output and prints the fastest wall time in ns
+time_run() {
+  local output="$1"
+  shift
+  local times=()
+  for ((r = 0; r < repetitions; r++)); do
+    local start
+    start=$(now_ns)
+    "$@" > "${output}" || return 1
+    times+=($(($(now_ns) - start)))
+  done
+  min "${times[@]}"
+}
+
+# Times both implementations with the CHANNEL_* variables already exported into c_ns and lesma_ns
+compare() {
+  c_ns=$(time_run "${work_dir}/c.out" "${work_dir}/channels_c")
+  lesma_ns=$(time_run "${work_dir}/lesma.out" "${work_dir}/channels_lesma") || {
+    printf "  Lesma failed\n" >&2
+    mismatch_count=$((mismatch_count + 1))
+    return 1
+  }
+  if ! cmp -s "${work_dir}/c.out" "${work_dir}/lesma.out"; then
+    printf "  Output differs from the C reference\n" >&2
+    mismatch_count=$((mismatch_count + 1))
+  fi
+}
+
+benchmark_throughput() {
+  local threads="$1" bound="$2"
+  local per_producer=$((messages / threads))
+  printf "Benchmarking %s producers and consumers, capacity %s\n" "${threads}" "${bound}" >&2
+
+  export CHANNEL_PRODUCERS="${threads}" CHANNEL_CONSUMERS="${threads}" CHANNEL_MESSAGES="${per_producer}"
+  export CHANNEL_CAPACITY="${bound}" CHANNEL_ROUNDS=0
+  compare || return
+
+  local total=$((per_producer * threads))
+  local c_rate lesma_rate
+  c_rate=$(awk -v n="${total}" -v t="${c_ns}" 'BEGIN { printf "%.0f", n * 1e9 / t }')
+  lesma_rate=$(awk -v n="${total}" -v t="${lesma_ns}" 'BEGIN { printf "%.0f", n * 1e9 / t }')
+  printf "  c: %s msg/s, lesma: %s msg/s\n" "${c_rate}" "${lesma_rate}" >&2
+  results+=("$(printf '    {"name": "throughput", "producers": %s, "consumers": %s, "capacity": %s, "messages": %s, "c": {"messages_per_second": %s}, "lesma": {"messages_per_second": %s}}' \
+    "${threads}" "${threads}" "${bound}" "${total}" "${c_rate}" "${lesma_rate}")")
+}
+
+benchmark_latency() {
+  printf "Benchmarking round trips\n" >&2
+
+  export CHANNEL_PRODUCERS=1 CHANNEL_CONSUMERS=1 CHANNEL_MESSAGES=0 CHANNEL_CAPACITY=1 CHANNEL_ROUNDS="${rounds}"
+  compare || return
+
+  local c_us lesma_us
+  c_us=$(awk -v t="${c_ns}" -v n="${rounds}" 'BEGIN { printf "%.2f", t / n / 1000 }')
+  lesma_us=$(awk -v t="${lesma_ns}" -v n="${rounds}" 'BEGIN { printf "%.2f", t / n / 1000 }')
+  printf "  c: %s us, lesma: %s us per round trip\n" "${c_us}" "${lesma_us}" >&2
+  results+=("$(printf '    {"name": "latency", "rounds": %s, "c": {"round_trip_us": %s}, "lesma": {"round_trip_us": %s}}' \
+    "${rounds}" "${c_us}" "${lesma_us}")")
+}
+
+for threads in 1 2 4 8 16; do
+  benchmark_throughput "${threads}" 0
+  benchmark_throughput "${threads}" "${capacity}"
+done
+benchmark_latency
+
+json=$(printf '{\n  "repetitions": %s,\n  "benchmarks": [' "${repetitions}")
+for ((i = 0; i < ${#results[@]}; i++)); do
+  json+=$(printf '\n%s%s' "${results[$i]}" "$([ $((i + 1)) -lt ${#results[@]} ] && echo ",")")
+done
+json+=$(printf '\n  ]\n}')
+
+if [ -n "${output_path}" ]; then
+  printf "%s\n" "${json}" > "${output_path}"
+else
+  printf "%s\n" "${json}"
+fi
+
+exit ${mismatch_count}
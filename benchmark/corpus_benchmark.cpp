@@ -0,0 +1,242 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <utility>
+
+#include "AllocationCounter.h"
+#include "CorpusGenerator.h"
+
+#include "liblesma/Backend/Codegen.h"
+#include "liblesma/Common/Utils.h"
+#include "liblesma/Frontend/Lexer.h"
+#include "liblesma/Frontend/Parser.h"
+
+using namespace lesma;
+using namespace lesma::bench;
+
+namespace {
+    // Either a generated corpus whose size is the benchmark argument, or one of the real test files
+    struct CorpusSource {
+        CorpusShape shape;
+        std::string file;
+
+        [[nodiscard]] const Corpus &get(const benchmark::State &state) const {
+            return file.empty() ? getGeneratedCorpus(shape, state.range(0)) : getFileCorpus(file);
+        }
+    };
+
+    struct Frontend {
+        std::shared_ptr<SourceMgr> srcMgr;
+        std::shared_ptr<Lexer> lexer;
+        std::shared_ptr<Parser> parser;
+    };
+
+    std::shared_ptr<SourceMgr> initializeSrcMgr(const Corpus &corpus) {
+        auto sourceMgr = std::make_shared<SourceMgr>(SourceMgr());
+        sourceMgr->AddNewSourceBuffer(MemoryBuffer::getMemBuffer(corpus.source, corpus.filename, false), llvm::SMLoc());
+
+        return sourceMgr;
+    }
+
+    Frontend initializeFrontend(const Corpus &corpus, bool parse = true) {
+        Frontend frontend;
+        frontend.srcMgr = initializeSrcMgr(corpus);
+        frontend.lexer = std::make_shared<Lexer>(frontend.srcMgr);
+        frontend.lexer->ScanAll();
+        if (parse) {
+            frontend.parser = std::make_shared<Parser>(frontend.lexer->getTokens());
+            frontend.parser->Parse();
+        }
+
+        return frontend;
+    }
+
+    std::unique_ptr<Codegen> initializeCodegen(const Frontend &frontend, const Corpus &corpus, bool jit) {
+        auto codegen = std::make_unique<Codegen>(frontend.parser, frontend.srcMgr, corpus.filename, std::vector<std::string>{}, jit, true);
+        codegen->Run();
+
+        return codegen;
+    }
+
+    // Non-JIT compilation writes the objects of the imported modules to the working directory, keep them in a scratch one
+    class ScopedWorkingDirectory {
+        std::filesystem::path previous;
+
+    public:
+        explicit ScopedWorkingDirectory(const std::filesystem::path &dir) : previous(std::filesystem::current_path()) {
+            std::filesystem::current_path(dir);
+        }
+        ~ScopedWorkingDirectory() {
+            std::filesystem::current_path(previous);
+        }
+    };
+
+    void reportThroughput(benchmark::State &state, const Corpus &corpus, const AllocationMeter &allocations) {
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpus.source.size()));
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * corpus.lines));
+        state.counters["lines"] = static_cast<double>(corpus.lines);
+        allocations.Report(state);
+    }
+
+    // Runs the stage on a fresh copy of its input every iteration, only `stage` is timed
+    void runStage(benchmark::State &state, const Corpus &corpus,
+                  const std::function<void()> &setup, const std::function<void()> &stage) {
+        AllocationMeter allocations;
+        try {
+            for ([[maybe_unused]] auto _: state) {
+                state.PauseTiming();
+                setup();
+                allocations.Start();
+                state.ResumeTiming();
+
+                stage();
+
+                state.PauseTiming();
+                allocations.Stop();
+                state.ResumeTiming();
+            }
+        } catch (const LesmaError &err) {
+            state.SkipWithError(err.what());
+            return;
+        }
+
+        reportThroughput(state, corpus, allocations);
+    }
+
+    void BM_Lexer(benchmark::State &state, const CorpusSource &source) {
+        const auto &corpus = source.get(state);
+        std::shared_ptr<SourceMgr> srcMgr;
+
+        runStage(
+                state, corpus, [&] { srcMgr = initializeSrcMgr(corpus); },
+                [&] {
+                    Lexer lexer(srcMgr);
+                    lexer.ScanAll();
+                    benchmark::DoNotOptimize(lexer.getTokens().data());
+                });
+    }
+
+    void BM_Parser(benchmark::State &state, const CorpusSource &source) {
+        const auto &corpus = source.get(state);
+        Frontend frontend;
+
+        runStage(
+                state, corpus, [&] { frontend = initializeFrontend(corpus, false); },
+                [&] {
+                    Parser parser(frontend.lexer->getTokens());
+                    parser.Parse();
+                    benchmark::DoNotOptimize(parser.getAST());
+                });
+    }
+
+    void BM_Codegen(benchmark::State &state, const CorpusSource &source) {
+        const auto &corpus = source.get(state);
+        Frontend frontend;
+        std::unique_ptr<Codegen> codegen;
+
+        // The previous module is destroyed in the untimed setup
+        runStage(
+                state, corpus,
+                [&] {
+                    codegen.reset();
+                    frontend = initializeFrontend(corpus);
+                },
+                [&] { codegen = initializeCodegen(frontend, corpus, true); });
+    }
+
+    void BM_Optimize(benchmark::State &state, const CorpusSource &source) {
+        const auto &corpus = source.get(state);
+        Frontend frontend;
+        std::unique_ptr<Codegen> codegen;
+
+        runStage(
+                state, corpus,
+                [&] {
+                    frontend = initializeFrontend(corpus);
+                    codegen = initializeCodegen(frontend, corpus, true);
+                },
+                [&] { codegen->Optimize(OptimizationLevel::O3); });
+    }
+
+    void BM_JIT(benchmark::State &state, const CorpusSource &source) {
+        const auto &corpus = source.get(state);
+        Frontend frontend;
+        std::unique_ptr<Codegen> codegen;
+
+        runStage(
+                state, corpus,
+                [&] {
+                    frontend = initializeFrontend(corpus);
+                    codegen = initializeCodegen(frontend, corpus, true);
+                    codegen->Optimize(OptimizationLevel::O3);
+                },
+                [&] { codegen->PrepareJIT(); });
+    }
+
+    void BM_Object(benchmark::State &state, const CorpusSource &source) {
+        const auto &corpus = source.get(state);
+        auto scratch = std::filesystem::temp_directory_path() / "lesma-corpus-objects";
+        std::filesystem::create_directories(scratch);
+        auto output = (scratch / "output").string();
+        Frontend frontend;
+        std::unique_ptr<Codegen> codegen;
+
+        {
+            ScopedWorkingDirectory cwd(scratch);
+            runStage(
+                    state, corpus,
+                    [&] {
+                        frontend = initializeFrontend(corpus);
+                        codegen = initializeCodegen(frontend, corpus, false);
+                        codegen->Optimize(OptimizationLevel::O3);
+                    },
+                    [&] { codegen->WriteToObjectFile(output); });
+        }
+
+        std::filesystem::remove_all(scratch);
+    }
+
+    using StageFn = void (*)(benchmark::State &, const CorpusSource &);
+
+    const std::vector<std::pair<std::string, StageFn>> stages = {
+            {"Lexer", BM_Lexer},
+            {"Parser", BM_Parser},
+            {"Codegen", BM_Codegen},
+            {"Optimize", BM_Optimize},
+            {"JIT", BM_JIT},
+            {"Object", BM_Object},
+    };
+
+    [[maybe_unused]] const bool registered = [] {
+        for (auto shape: {CorpusShape::FUNCTIONS, CorpusShape::EXPRESSIONS, CorpusShape::CLASSES, CorpusShape::IMPORTS}) {
+            for (const auto &[stage, fn]: stages) {
+                auto name = fmt::format("Corpus/{}/{}", getCorpusShapeName(shape), stage);
+                benchmark::RegisterBenchmark(name.c_str(), fn, CorpusSource{shape, ""})
+                        ->RangeMultiplier(10)
+                        ->Range(1000, 1000000)
+                        ->Unit(benchmark::kMillisecond)
+                        ->UseRealTime();
+            }
+        }
+
+        // The real test programs, imports resolve relative to their location
+        std::vector<std::filesystem::path> tests;
+        for (const auto &entry: std::filesystem::directory_iterator(LESMA_TESTS_DIR))
+            if (entry.path().extension() == ".les")
+                tests.push_back(entry.path());
+        std::sort(tests.begin(), tests.end());
+
+        for (const auto &test: tests) {
+            for (const auto &[stage, fn]: stages) {
+                auto name = fmt::format("Tests/{}/{}", test.stem().string(), stage);
+                benchmark::RegisterBenchmark(name.c_str(), fn, CorpusSource{CorpusShape::FUNCTIONS, test.string()})
+                        ->Unit(benchmark::kMicrosecond)
+                        ->UseRealTime();
+            }
+        }
+
+        return true;
+    }();
+}// namespace
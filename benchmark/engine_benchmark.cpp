@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+
+#include "liblesma/Driver/Engine.h"
+
+using namespace lesma;
+
+namespace {
+    // Same body as the Lesma function, kept out of line so both sides pay for a real call
+    [[gnu::noinline]] int64_t nativeStep(int64_t value, int64_t step) {
+        return value + step;
+    }
+
+    Engine &getEngine() {
+        static auto engine = Engine::FromSource(
+                "export def step(value: int, step: int) -> int\n"
+                "    return value + step\n");
+        return *engine;
+    }
+
+    // The pointer goes through DoNotOptimize, so the compiler can't see which function it calls
+    template<typename Callable>
+    void callLoop(benchmark::State &state, Callable function) {
+        int64_t value = 0;
+        for ([[maybe_unused]] auto _: state) {
+            benchmark::DoNotOptimize(function);
+            value = function(value, 1);
+            benchmark::DoNotOptimize(value);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+}// namespace
+
+// Baseline, a native function called through a pointer
+static void BM_NativeCall(benchmark::State &state) {
+    callLoop(state, &nativeStep);
+}
+
+// The handle is looked up once, every call is an indirect call into JIT compiled code
+static void BM_EngineCall(benchmark::State &state) {
+    callLoop(state, getEngine().get<int64_t(int64_t, int64_t)>("step"));
+}
+
+// What every call would cost if the function were looked up by name each time
+static void BM_EngineLookup(benchmark::State &state) {
+    auto &engine = getEngine();
+    for ([[maybe_unused]] auto _: state)
+        benchmark::DoNotOptimize(engine.get<int64_t(int64_t, int64_t)>("step"));
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_NativeCall)->ThreadRange(1, 8);
+BENCHMARK(BM_EngineCall)->ThreadRange(1, 8);
+BENCHMARK(BM_EngineLookup);
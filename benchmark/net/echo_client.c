@@ -0,0 +1,128 @@
+// Load generator for the echo servers in this directory. Every connection sends a message, waits until all of it
+// came back and sends the next one, so the latency of each request is the time of a round trip.
+//
+// Usage: echo_client <port> <connections> <requests per connection> <message size>
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    int fd;
+    long long sent;
+    long long received;
+    long long remaining;
+    long long started;
+} connection;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void die(const char *what) {
+    fprintf(stderr, "echo_client: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static int compare(const void *a, const void *b) {
+    long long x = *(const long long *) a;
+    long long y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s <port> <connections> <requests per connection> <message size>\n", argv[0]);
+        return 2;
+    }
+
+    int port = atoi(argv[1]);
+    int count = atoi(argv[2]);
+    long long requests = atoll(argv[3]);
+    long long size = atoll(argv[4]);
+
+    char *message = malloc((size_t) size);
+    char *buffer = malloc((size_t) size);
+    long long *latencies = malloc(sizeof(long long) * (size_t) (requests * count));
+    connection *connections = calloc((size_t) count, sizeof(connection));
+    memset(message, 'x', (size_t) size);
+
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons((uint16_t) port)};
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    int epoll = epoll_create1(0);
+    for (int i = 0; i < count; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+            die("cannot connect");
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        connections[i].fd = fd;
+        connections[i].remaining = requests;
+        struct epoll_event event = {.events = EPOLLIN, .data = {.ptr = &connections[i]}};
+        epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    long long start = now_ns();
+    long long measured = 0;
+    for (int i = 0; i < count; i++) {
+        connections[i].started = now_ns();
+        if (write(connections[i].fd, message, (size_t) size) != size)
+            die("cannot send");
+    }
+
+    int active = count;
+    struct epoll_event events[64];
+    while (active > 0) {
+        int ready = epoll_wait(epoll, events, 64, -1);
+        if (ready < 0 && errno != EINTR)
+            die("cannot wait");
+
+        for (int e = 0; e < ready; e++) {
+            connection *c = events[e].data.ptr;
+            ssize_t got = read(c->fd, buffer, (size_t) (size - c->received));
+            if (got <= 0) {
+                fprintf(stderr, "echo_client: the server closed a connection\n");
+                return 1;
+            }
+
+            c->received += got;
+            if (c->received < size)
+                continue;
+
+            long long end = now_ns();
+            latencies[measured++] = end - c->started;
+            c->received = 0;
+            if (--c->remaining == 0) {
+                close(c->fd);
+                active--;
+                continue;
+            }
+
+            c->started = end;
+            if (write(c->fd, message, (size_t) size) != size)
+                die("cannot send");
+        }
+    }
+    long long elapsed = now_ns() - start;
+
+    qsort(latencies, (size_t) measured, sizeof(long long), compare);
+    printf("{\"requests\": %lld, \"requests_per_second\": %.0f, \"p50_us\": %.1f, \"p99_us\": %.1f}\n", measured,
+           (double) measured * 1e9 / (double) elapsed, (double) latencies[measured / 2] / 1000.0,
+           (double) latencies[measured * 99 / 100] / 1000.0);
+    return 0;
+}
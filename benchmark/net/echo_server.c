@@ -0,0 +1,104 @@
+// C reference for echo_server.les, ECHO_LISTENERS threads each accept connections on ECHO_PORT of the loopback
+// with their own listener and edge-triggered epoll loop.
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static int port;
+
+static int listen_on(void) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons((uint16_t) port)};
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("echo_server");
+        exit(1);
+    }
+    return fd;
+}
+
+// Small echoes fit in the socket buffer, a full one is waited for in place
+static void write_all(int fd, const char *data, ssize_t size) {
+    while (size > 0) {
+        ssize_t sent = write(fd, data, (size_t) size);
+        if (sent < 0 && errno == EAGAIN) {
+            struct pollfd writable = {.fd = fd, .events = POLLOUT};
+            poll(&writable, 1, -1);
+            continue;
+        }
+        if (sent <= 0)
+            return;
+        data += sent;
+        size -= sent;
+    }
+}
+
+static void *serve(void *arg) {
+    (void) arg;
+    int listener = listen_on();
+    int epoll = epoll_create1(0);
+    struct epoll_event registration = {.events = EPOLLIN | EPOLLET, .data = {.fd = listener}};
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &registration);
+
+    char buffer[16384];
+    struct epoll_event events[64];
+    for (;;) {
+        int ready = epoll_wait(epoll, events, 64, -1);
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listener) {
+                int connection;
+                while ((connection = accept4(listener, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+                    int one = 1;
+                    setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    struct epoll_event event = {.events = EPOLLIN | EPOLLRDHUP | EPOLLET, .data = {.fd = connection}};
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, connection, &event);
+                }
+                continue;
+            }
+
+            for (;;) {
+                ssize_t got = read(fd, buffer, sizeof(buffer));
+                if (got > 0) {
+                    write_all(fd, buffer, got);
+                    continue;
+                }
+                if (got == 0 || errno != EAGAIN)
+                    close(fd);
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(void) {
+    port = atoi(getenv("ECHO_PORT"));
+    int listeners = atoi(getenv("ECHO_LISTENERS"));
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 1; i < listeners; i++) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, serve, NULL);
+    }
+    serve(NULL);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#!/bin/bash
+# Drives the Lesma echo server and its C reference over 127.0.0.1 with echo_client.c, and reports the requests per
+# second and latency percentiles of each as JSON. The Lesma server is measured with both event loop backends.
+#
+# Usage: run_echo.sh [lesma] [clang] [output.json] [listeners] [connections] [requests] [message size] [port]
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+
+compiler_path="${1:-${SCRIPT_DIR}/../../build/lesma}"
+clang_path="${2:-clang}"
+output_path="${3:-}"
+listeners="${4:-1}"
+connections="${5:-64}"
+requests="${6:-10000}"
+message_size="${7:-64}"
+port="${8:-7878}"
+
+work_dir=$(mktemp -d)
+server_pid=""
+trap '[ -n "${server_pid}" ] && kill "${server_pid}" 2> /dev/null; rm -rf "${work_dir}"' EXIT
+
+failure_count=0
+results=()
+
+"${clang_path}" -O3 -o "${work_dir}/echo_client" "${SCRIPT_DIR}/echo_client.c" || exit 1
+"${clang_path}" -O3 -pthread -o "${work_dir}/echo_server_c" "${SCRIPT_DIR}/echo_server.c" || exit 1
+(cd "${work_dir}" && "${compiler_path}" compile "${SCRIPT_DIR}/echo_server.les" -o echo_server_lesma) || exit 1
+
+# Starts a server in the background and waits until it accepts connections
+start_server() {
+  ECHO_PORT="${port}" ECHO_LISTENERS="${listeners}" "$@" &
+  server_pid=$!
+  for ((i = 0; i < 100; i++)); do
+    (exec 3<> "/dev/tcp/127.0.0.1/${port}") 2> /dev/null && return 0
+    sleep 0.05
+  done
+  return 1
+}
+
+stop_server() {
+  kill "${server_pid}" 2> /dev/null
+  wait "${server_pid}" 2> /dev/null
+  server_pid=""
+}
+
+benchmark_server() {
+  local name="$1"
+  shift
+  printf "Benchmarking %s\n" "${name}" >&2
+
+  # Every server gets its own port, the previous one may linger in TIME_WAIT
+  port=$((port + 1))
+  if ! start_server "$@"; then
+    printf "  Server didn't start\n" >&2
+    failure_count=$((failure_count + 1))
+    stop_server
+    return
+  fi
+
+  local report
+  if ! report=$("${work_dir}/echo_client" "${port}" "${connections}" "${requests}" "${message_size}"); then
+    printf "  Client failed\n" >&2
+    failure_count=$((failure_count + 1))
+    stop_server
+    return
+  fi
+  stop_server
+
+  printf "  %s\n" "${report}" >&2
+  results+=("$(printf '    {"name": "%s", "result": %s}' "${name}" "${report}")")
+}
+
+benchmark_server c "${work_dir}/echo_server_c"
+benchmark_server lesma_io_uring "${work_dir}/echo_server_lesma"
+LESMA_EVENT_LOOP=epoll benchmark_server lesma_epoll "${work_dir}/echo_server_lesma"
+
+json=$(printf '{\n  "listeners": %s,\n  "connections": %s,\n  "requests_per_connection": %s,\n  "message_size": %s,\n  "servers": [' \
+  "${listeners}" "${connections}" "${requests}" "${message_size}")
+for ((i = 0; i < ${#results[@]}; i++)); do
+  json+=$(printf '\n%s%s' "${results[$i]}" "$([ $((i + 1)) -lt ${#results[@]} ] && echo ",")")
+done
+json+=$(printf '\n  ]\n}')
+
+if [ -n "${output_path}" ]; then
+  printf "%s\n" "${json}" > "${output_path}"
+else
+  printf "%s\n" "${json}"
+fi
+
+exit ${failure_count}
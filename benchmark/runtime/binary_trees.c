@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct Node {
+    struct Node *left;
+    struct Node *right;
+    bool leaf;
+} Node;
+
+static Node *bottomUp(long long depth) {
+    Node *node = malloc(sizeof(Node));
+    if (depth == 0) {
+        node->leaf = true;
+        return node;
+    }
+
+    node->left = bottomUp(depth - 1);
+    node->right = bottomUp(depth - 1);
+    node->leaf = false;
+    return node;
+}
+
+static long long check(const Node *node) {
+    if (node->leaf)
+        return 1;
+    return 1 + check(node->left) + check(node->right);
+}
+
+static void release(Node *node) {
+    if (!node->leaf) {
+        release(node->left);
+        release(node->right);
+    }
+    free(node);
+}
+
+int main(void) {
+    const long long minDepth = 4;
+    const long long maxDepth = 18;
+
+    Node *stretch = bottomUp(maxDepth + 1);
+    printf("stretch tree of depth %lld\t check: %lld\n", maxDepth + 1, check(stretch));
+    release(stretch);
+
+    Node *longLived = bottomUp(maxDepth);
+
+    for (long long depth = minDepth; depth <= maxDepth; depth += 2) {
+        long long iterations = 1LL << (maxDepth - depth + minDepth);
+        long long total = 0;
+        for (long long i = 0; i < iterations; i++) {
+            Node *tree = bottomUp(depth);
+            total += check(tree);
+            release(tree);
+        }
+        printf("%lld\t trees of depth %lld\t check: %lld\n", iterations, depth, total);
+    }
+
+    printf("long lived tree of depth %lld\t check: %lld\n", maxDepth, check(longLived));
+    release(longLived);
+    return 0;
+}
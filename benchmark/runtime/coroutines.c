@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+int main(void) {
+    long long total = 0;
+    for (long long id = 4096; id < 8192; id++)
+        for (long long i = 0; i < 500; i++)
+            total = total + (id * i) % 1000;
+    printf("%lld\n", total);
+
+    total = 0;
+    for (long long i = 0; i < 10000000; i++)
+        total = total + i * i % 1000;
+    printf("%lld\n", total);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+
+// Same packed representation as fannkuch.les, so both measure the same work
+static long long shift(long long i) {
+    long long p = 1;
+    for (long long j = 0; j < i; j++)
+        p = p * 16;
+    return p;
+}
+
+static long long digit(long long packed, long long i) {
+    return packed / shift(i) % 16;
+}
+
+static long long replace(long long packed, long long i, long long value) {
+    return packed + (value - digit(packed, i)) * shift(i);
+}
+
+static long long fannkuch(long long n) {
+    long long perm, perm1 = 0, count = 0;
+    long long max_flips = 0, checksum = 0, perm_count = 0;
+    long long r = n;
+
+    for (long long i = 0; i < n; i++)
+        perm1 = replace(perm1, i, i);
+
+    while (1) {
+        while (r != 1) {
+            count = replace(count, r - 1, r);
+            r = r - 1;
+        }
+
+        perm = perm1;
+        long long flips = 0;
+        long long k = digit(perm, 0);
+        while (k != 0) {
+            for (long long i = 0, j = k; i < j; i++, j--) {
+                long long tmp = digit(perm, i);
+                perm = replace(perm, i, digit(perm, j));
+                perm = replace(perm, j, tmp);
+            }
+            flips = flips + 1;
+            k = digit(perm, 0);
+        }
+
+        if (flips > max_flips)
+            max_flips = flips;
+        if (perm_count % 2 == 0)
+            checksum = checksum + flips;
+        else
+            checksum = checksum - flips;
+
+        // Next permutation
+        while (1) {
+            if (r == n) {
+                printf("%lld\nPfannkuchen(%lld) = %lld\n", checksum, n, max_flips);
+                return max_flips;
+            }
+
+            long long perm0 = digit(perm1, 0);
+            for (long long i = 0; i < r; i++)
+                perm1 = replace(perm1, i, digit(perm1, i + 1));
+            perm1 = replace(perm1, r, perm0);
+
+            count = replace(count, r, digit(count, r) - 1);
+            if (digit(count, r) > 0)
+                break;
+            r = r + 1;
+        }
+
+        perm_count = perm_count + 1;
+    }
+}
+
+int main(void) {
+    fannkuch(10);
+    return 0;
+}
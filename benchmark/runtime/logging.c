@@ -0,0 +1,10 @@
+#include <stdio.h>
+
+int main(void) {
+    const char *names[] = {"alpha", "beta ", "gamma", "delta"};
+
+    for (long long i = 0; i < 1000000; i++)
+        printf("request %lld from %s: status %lld, took %lld us, ok %s\n",
+               i, names[i % 4], 200 + i % 3, i % 1000, i % 7 != 0 ? "true" : "false");
+    return 0;
+}
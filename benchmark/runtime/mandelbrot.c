@@ -0,0 +1,29 @@
+#include <stdio.h>
+
+static long long mandelbrot(long long size, long long max_iter) {
+    long long inside = 0;
+    for (long long y = 0; y < size; y++) {
+        double ci = 2.0 * (double) y / (double) size - 1.0;
+        for (long long x = 0; x < size; x++) {
+            double cr = 2.0 * (double) x / (double) size - 1.5;
+            double zr = 0.0, zi = 0.0;
+            long long i = 0;
+            while (i < max_iter) {
+                double tr = zr * zr - zi * zi + cr;
+                zi = 2.0 * zr * zi + ci;
+                zr = tr;
+                if (zr * zr + zi * zi > 4.0)
+                    break;
+                i = i + 1;
+            }
+            if (i == max_iter)
+                inside++;
+        }
+    }
+    return inside;
+}
+
+int main(void) {
+    printf("%lld\n", mandelbrot(1000, 200));
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <math.h>
+#include <stdio.h>
+
+#define PI 3.141592653589793
+#define SOLAR_MASS (4.0 * PI * PI)
+#define DAYS_PER_YEAR 365.24
+
+typedef struct {
+    double x, y, z, vx, vy, vz, mass;
+} Body;
+
+static Body body(double x, double y, double z, double vx, double vy, double vz, double mass) {
+    Body b = {x, y, z, vx * DAYS_PER_YEAR, vy * DAYS_PER_YEAR, vz * DAYS_PER_YEAR, mass * SOLAR_MASS};
+    return b;
+}
+
+static void interact(Body *a, Body *b, double dt) {
+    double dx = a->x - b->x;
+    double dy = a->y - b->y;
+    double dz = a->z - b->z;
+    double distance2 = dx * dx + dy * dy + dz * dz;
+    double mag = dt / (distance2 * sqrt(distance2));
+    double a_mass = a->mass * mag;
+    double b_mass = b->mass * mag;
+    a->vx = a->vx - dx * b_mass;
+    a->vy = a->vy - dy * b_mass;
+    a->vz = a->vz - dz * b_mass;
+    b->vx = b->vx + dx * a_mass;
+    b->vy = b->vy + dy * a_mass;
+    b->vz = b->vz + dz * a_mass;
+}
+
+static void move(Body *b, double dt) {
+    b->x = b->x + dt * b->vx;
+    b->y = b->y + dt * b->vy;
+    b->z = b->z + dt * b->vz;
+}
+
+static double kinetic(const Body *b) {
+    return 0.5 * b->mass * (b->vx * b->vx + b->vy * b->vy + b->vz * b->vz);
+}
+
+static double potential(const Body *a, const Body *b) {
+    double dx = a->x - b->x;
+    double dy = a->y - b->y;
+    double dz = a->z - b->z;
+    return a->mass * b->mass / sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+static double energy(Body *sun, Body *jupiter, Body *saturn, Body *uranus, Body *neptune) {
+    double e = kinetic(sun) + kinetic(jupiter) + kinetic(saturn) + kinetic(uranus) + kinetic(neptune);
+    e = e - (potential(sun, jupiter) + potential(sun, saturn) + potential(sun, uranus) + potential(sun, neptune));
+    e = e - (potential(jupiter, saturn) + potential(jupiter, uranus) + potential(jupiter, neptune));
+    e = e - (potential(saturn, uranus) + potential(saturn, neptune));
+    e = e - (potential(uranus, neptune));
+    return e;
+}
+
+static void advance(Body *sun, Body *jupiter, Body *saturn, Body *uranus, Body *neptune, double dt) {
+    interact(sun, jupiter, dt);
+    interact(sun, saturn, dt);
+    interact(sun, uranus, dt);
+    interact(sun, neptune, dt);
+    interact(jupiter, saturn, dt);
+    interact(jupiter, uranus, dt);
+    interact(jupiter, neptune, dt);
+    interact(saturn, uranus, dt);
+    interact(saturn, neptune, dt);
+    interact(uranus, neptune, dt);
+    move(sun, dt);
+    move(jupiter, dt);
+    move(saturn, dt);
+    move(uranus, dt);
+    move(neptune, dt);
+}
+
+int main(void) {
+    Body sun = body(0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0);
+    Body jupiter = body(4.841431442464721, -1.1603200440274284, -0.10362204447112311, 0.001660076642744037, 0.007699011184197404, -0.0000690460016972063, 0.0009547919384243266);
+    Body saturn = body(8.34336671824458, 4.124798564124305, -0.4035234171143214, -0.002767425107268624, 0.004998528012349172, 0.00002304172975737639, 0.0002858859806661308);
+    Body uranus = body(12.894369562139131, -15.111151401698631, -0.22330757889265573, 0.002964601375647616, 0.0023784717395948095, -0.00002965895685402376, 0.00004366244043351563);
+    Body neptune = body(15.379697114850917, -25.919314609987964, 0.17925877295037118, 0.0026806777249038932, 0.001628241700382423, -0.00009515922545197159, 0.00005151389020466115);
+
+    // Offset the momentum of the sun
+    sun.vx = -(jupiter.vx * jupiter.mass + saturn.vx * saturn.mass + uranus.vx * uranus.mass + neptune.vx * neptune.mass) / SOLAR_MASS;
+    sun.vy = -(jupiter.vy * jupiter.mass + saturn.vy * saturn.mass + uranus.vy * uranus.mass + neptune.vy * neptune.mass) / SOLAR_MASS;
+    sun.vz = -(jupiter.vz * jupiter.mass + saturn.vz * saturn.mass + uranus.vz * uranus.mass + neptune.vz * neptune.mass) / SOLAR_MASS;
+
+    printf("%.9f\n", energy(&sun, &jupiter, &saturn, &uranus, &neptune));
+    for (long long step = 0; step < 5000000; step++)
+        advance(&sun, &jupiter, &saturn, &uranus, &neptune, 0.01);
+    printf("%.9f\n", energy(&sun, &jupiter, &saturn, &uranus, &neptune));
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+
+typedef struct {
+    long long state;
+} Random;
+
+typedef struct {
+    double x, y, vx, vy;
+    long long bounces;
+} Particle;
+
+static long long random_next(Random *self) {
+    self->state = self->state * 48271 % 2147483647;
+    return self->state;
+}
+
+static double random_uniform(Random *self) {
+    return (double) random_next(self) / 2147483647.0;
+}
+
+static void particle_kick(Particle *self, Random *rng, double strength) {
+    self->vx = self->vx + (random_uniform(rng) - 0.5) * strength;
+    self->vy = self->vy + (random_uniform(rng) - 0.5) * strength;
+}
+
+static void particle_step(Particle *self, double dt) {
+    self->x = self->x + self->vx * dt;
+    self->y = self->y + self->vy * dt;
+    if (self->x < 0.0) {
+        self->x = -self->x;
+        self->vx = -self->vx;
+        self->bounces = self->bounces + 1;
+    }
+    if (self->x > 1.0) {
+        self->x = 2.0 - self->x;
+        self->vx = -self->vx;
+        self->bounces = self->bounces + 1;
+    }
+    if (self->y < 0.0) {
+        self->y = -self->y;
+        self->vy = -self->vy;
+        self->bounces = self->bounces + 1;
+    }
+    if (self->y > 1.0) {
+        self->y = 2.0 - self->y;
+        self->vy = -self->vy;
+        self->bounces = self->bounces + 1;
+    }
+}
+
+static void particle_collide(Particle *self, Particle *other) {
+    double dx = self->x - other->x;
+    double dy = self->y - other->y;
+    if (dx * dx + dy * dy < 0.0001) {
+        double vx = self->vx;
+        double vy = self->vy;
+        self->vx = other->vx;
+        self->vy = other->vy;
+        other->vx = vx;
+        other->vy = vy;
+    }
+}
+
+static double particle_energy(Particle *self) {
+    return 0.5 * (self->vx * self->vx + self->vy * self->vy);
+}
+
+static void simulate(long long steps) {
+    Random rng = {42};
+    Particle a = {0.1, 0.2, 0.3, 0.1, 0};
+    Particle b = {0.5, 0.5, -0.2, 0.4, 0};
+    Particle c = {0.9, 0.1, 0.1, -0.3, 0};
+    Particle d = {0.3, 0.8, -0.4, -0.2, 0};
+    for (long long step = 0; step < steps; step++) {
+        particle_kick(&a, &rng, 0.01);
+        particle_kick(&b, &rng, 0.01);
+        particle_kick(&c, &rng, 0.01);
+        particle_kick(&d, &rng, 0.01);
+        particle_step(&a, 0.01);
+        particle_step(&b, 0.01);
+        particle_step(&c, 0.01);
+        particle_step(&d, 0.01);
+        particle_collide(&a, &b);
+        particle_collide(&a, &c);
+        particle_collide(&a, &d);
+        particle_collide(&b, &c);
+        particle_collide(&b, &d);
+        particle_collide(&c, &d);
+    }
+
+    printf("%lld\n", a.bounces + b.bounces + c.bounces + d.bounces);
+    printf("%.6f\n", particle_energy(&a) + particle_energy(&b) + particle_energy(&c) + particle_energy(&d));
+}
+
+int main(void) {
+    simulate(10000000);
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <unistd.h>
+
+/* The ceiling, digits are formatted by hand into a buffer that goes straight to write(2) */
+static char buffer[64 * 1024];
+static size_t length = 0;
+
+static void flush(void) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t written = write(STDOUT_FILENO, buffer + done, length - done);
+        if (written <= 0)
+            break;
+        done += (size_t) written;
+    }
+    length = 0;
+}
+
+static void print_int(long long value) {
+    char digits[21];
+    char *end = digits + sizeof(digits);
+    char *cursor = end;
+    unsigned long long remaining = value < 0 ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+    do {
+        *--cursor = (char) ('0' + remaining % 10);
+        remaining /= 10;
+    } while (remaining > 0);
+    if (value < 0)
+        *--cursor = '-';
+
+    if (length + sizeof(digits) + 1 > sizeof(buffer))
+        flush();
+    while (cursor < end)
+        buffer[length++] = *cursor++;
+    buffer[length++] = '\n';
+}
+
+int main(void) {
+    for (long long i = 0; i < 10000000; i++)
+        print_int(i * 7 - 35000000);
+    flush();
+    return 0;
+}
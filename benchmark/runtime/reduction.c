@@ -0,0 +1,16 @@
+#include <stdio.h>
+
+static long long checksum(long long n) {
+    long long total = 0;
+    for (long long i = 0; i < n; i++)
+        total = total + (i % 16) * (i % 16) + i * 5;
+    return total;
+}
+
+int main(void) {
+    long long total = 0;
+    for (long long round = 0; round < 2000; round++)
+        total = total + checksum(1000000 + round);
+    printf("%lld\n", total);
+    return 0;
+}
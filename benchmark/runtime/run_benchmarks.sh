@@ -0,0 +1,133 @@
+#!/bin/bash
+# Measures the speed of the code generated by Lesma on the kernels in this directory.
+# Every kernel runs through the JIT (`lesma run`) and AOT (`lesma compile`), and its C reference is built with clang -O3.
+# Outputs are compared against the C reference and the results are written as JSON.
+#
+# Usage: run_benchmarks.sh [lesma] [clang] [output.json] [repetitions]
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+
+compiler_path="${1:-${SCRIPT_DIR}/../../build/lesma}"
+clang_path="${2:-clang}"
+output_path="${3:-}"
+repetitions="${4:-5}"
+
+work_dir=$(mktemp -d)
+trap 'rm -rf "${work_dir}"' EXIT
+
+mismatch_count=0
+results=()
+
+now_ms() {
+  echo $(($(date +%s%N) / 1000000))
+}
+
+# Prints the total time and the time of a stage from a `--stats=json` report
+stats_total_ms() {
+  awk -F': ' '/^  "total_ms":/ { sub(/,$/, "", $2); print $2 }' "$1"
+}
+
+stats_stage_ms() {
+  awk -F': ' -v stage="\"$2\"," '/"name":/ { name = $2 } /"time_ms":/ && name == stage { sub(/,$/, "", $2); print $2 }' "$1"
+}
+
+min() {
+  printf "%s\n" "$@" | sort -g | head -n 1
+}
+
+ratio() {
+  awk -v a="$1" -v b="$2" 'BEGIN { printf "%.3f", (b > 0 ? a / b : 0) }'
+}
+
+# Runs a command `repetitions` times, saves its output and prints the fastest wall time in ms
+time_command() {
+  local output="$1"
+  shift
+  local times=()
+  for ((i = 0; i < repetitions; i++)); do
+    local start
+    start=$(now_ms)
+    "$@" > "${output}" || return 1
+    times+=($(($(now_ms) - start)))
+  done
+  min "${times[@]}"
+}
+
+benchmark_kernel() {
+  local file="$1"
+  local name
+  name=$(basename -s .les "${file}")
+  local reference="${SCRIPT_DIR}/${name}.c"
+  printf "Benchmarking %s\n" "${name}" >&2
+
+  if [ ! -f "${reference}" ]; then
+    printf "  Missing C reference %s\n" "${reference}" >&2
+    mismatch_count=$((mismatch_count + 1))
+    return
+  fi
+
+  # C reference, built by the same LLVM
+  "${clang_path}" -O3 -o "${work_dir}/${name}_c" "${reference}" -lm || {
+    printf "  C reference failed to compile\n" >&2
+    mismatch_count=$((mismatch_count + 1))
+    return
+  }
+  local c_ms
+  c_ms=$(time_command "${work_dir}/${name}_c.out" "${work_dir}/${name}_c")
+
+  # AOT, the executable is timed on its own
+  (cd "${work_dir}" && "${compiler_path}" --stats json --stats-file "${name}_aot.json" compile "${file}" -o "${name}_aot") || {
+    printf "  Compilation failed\n" >&2
+    mismatch_count=$((mismatch_count + 1))
+    return
+  }
+  local aot_ms
+  aot_ms=$(time_command "${work_dir}/${name}_aot.out" "${work_dir}/${name}_aot")
+
+  # JIT, the execution stage is taken from the statistics of the fastest run
+  local jit_times=()
+  local jit_exec_times=()
+  for ((i = 0; i < repetitions; i++)); do
+    local start
+    start=$(now_ms)
+    "${compiler_path}" --stats json --stats-file "${work_dir}/${name}_jit.json" run "${file}" > "${work_dir}/${name}_jit.out"
+    jit_times+=($(($(now_ms) - start)))
+    jit_exec_times+=("$(stats_stage_ms "${work_dir}/${name}_jit.json" "Execution")")
+  done
+  local jit_ms jit_exec_ms
+  jit_ms=$(min "${jit_times[@]}")
+  jit_exec_ms=$(min "${jit_exec_times[@]}")
+
+  local jit_match=true aot_match=true
+  cmp -s "${work_dir}/${name}_c.out" "${work_dir}/${name}_jit.out" || jit_match=false
+  cmp -s "${work_dir}/${name}_c.out" "${work_dir}/${name}_aot.out" || aot_match=false
+  if [ "${jit_match}" = false ] || [ "${aot_match}" = false ]; then
+    mismatch_count=$((mismatch_count + 1))
+    printf "  Output differs from the C reference (jit: %s, aot: %s)\n" "${jit_match}" "${aot_match}" >&2
+  fi
+
+  printf "  c: %s ms, aot: %s ms, jit: %s ms (execution %s ms)\n" "${c_ms}" "${aot_ms}" "${jit_ms}" "${jit_exec_ms}" >&2
+
+  results+=("$(printf '    {\n      "name": "%s",\n      "c": {"run_ms": %s},\n      "aot": {"compile_ms": %s, "run_ms": %s, "matches_c": %s, "slowdown_vs_c": %s},\n      "jit": {"wall_ms": %s, "execution_ms": %s, "matches_c": %s, "slowdown_vs_c": %s}\n    }' \
+    "${name}" "${c_ms}" \
+    "$(stats_total_ms "${work_dir}/${name}_aot.json")" "${aot_ms}" "${aot_match}" "$(ratio "${aot_ms}" "${c_ms}")" \
+    "${jit_ms}" "${jit_exec_ms}" "${jit_match}" "$(ratio "${jit_exec_ms}" "${c_ms}")")")
+}
+
+for file in "${SCRIPT_DIR}"/*.les; do
+  benchmark_kernel "${file}"
+done
+
+json=$(printf '{\n  "repetitions": %s,\n  "benchmarks": [\n' "${repetitions}")
+for ((i = 0; i < ${#results[@]}; i++)); do
+  json+=$(printf '\n%s%s' "${results[$i]}" "$([ $((i + 1)) -lt ${#results[@]} ] && echo ",")")
+done
+json+=$(printf '\n  ]\n}')
+
+if [ -n "${output_path}" ]; then
+  printf "%s\n" "${json}" > "${output_path}"
+else
+  printf "%s\n" "${json}"
+fi
+
+exit ${mismatch_count}
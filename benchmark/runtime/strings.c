@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *slice(const char *str, long long start, long long end) {
+    char *result = malloc(end - start + 1);
+    memcpy(result, str + start, end - start);
+    result[end - start] = '\0';
+    return result;
+}
+
+static char *concat(const char *left, const char *right) {
+    size_t left_length = strlen(left);
+    size_t right_length = strlen(right);
+    char *result = malloc(left_length + right_length + 1);
+    memcpy(result, left, left_length);
+    memcpy(result + left_length, right, right_length + 1);
+    return result;
+}
+
+int main(void) {
+    const char *words = "alpha beta gamma delta epsilon zeta eta theta iota kappa lambda mu ";
+
+    long long total = 0;
+    for (long long round = 0; round < 3000000; round++) {
+        long long start = (round * 7) % 50;
+        char *word = slice(words, start, start + 12);
+        char *prefix = slice(words, 0, round % 24);
+        char *key = concat(word, prefix);
+        if (strcmp(key, "kappa") < 0)
+            total += strlen(key);
+        if (strcmp(key, word) == 0)
+            total += 1;
+        free(key);
+        free(prefix);
+        free(word);
+    }
+    printf("%lld\n", total);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#!/bin/bash
+# Runs a tiny script many times, with a new lesma process every time and through lesma server, both with the thin
+# lesma-client and with lesma run --client. Outputs are compared against the first cold run and the mean wall time
+# per run of each is written as JSON.
+#
+# Usage: run_server.sh [lesma] [lesma-client] [output.json] [runs]
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+
+compiler_path="${1:-${SCRIPT_DIR}/../../build/lesma}"
+client_path="${2:-${SCRIPT_DIR}/../../build/lesma-client}"
+output_path="${3:-}"
+runs="${4:-200}"
+
+work_dir=$(mktemp -d)
+socket_path="${work_dir}/server.sock"
+server_pid=""
+trap '[ -n "${server_pid}" ] && kill "${server_pid}" 2> /dev/null; rm -rf "${work_dir}"' EXIT
+
+mismatch_count=0
+results=()
+
+now_ns() {
+  date +%s%N
+}
+
+"${compiler_path}" run "${SCRIPT_DIR}/tiny.les" > "${work_dir}/expected.txt" || exit 1
+
+# Runs the script `runs` times, checks every output and saves the mean wall time in ms
+benchmark_runs() {
+  local name="$1"
+  shift
+  printf "Benchmarking %s\n" "${name}" >&2
+
+  local start
+  start=$(now_ns)
+  for ((r = 0; r < runs; r++)); do
+    if ! "$@" "${SCRIPT_DIR}/tiny.les" > "${work_dir}/output.txt" || ! cmp -s "${work_dir}/expected.txt" "${work_dir}/output.txt"; then
+      printf "  Output mismatch\n" >&2
+      mismatch_count=$((mismatch_count + 1))
+      return
+    fi
+  done
+  local mean_ms
+  mean_ms=$(awk -v ns="$(($(now_ns) - start))" -v runs="${runs}" 'BEGIN { printf "%.3f", ns / runs / 1000000 }')
+
+  printf "  %s ms per run\n" "${mean_ms}" >&2
+  results+=("$(printf '    {"name": "%s", "mean_ms": %s}' "${name}" "${mean_ms}")")
+}
+
+benchmark_runs cold "${compiler_path}" run
+
+"${compiler_path}" server --socket "${socket_path}" > /dev/null &
+server_pid=$!
+for ((i = 0; i < 100; i++)); do
+  [ -S "${socket_path}" ] && break
+  sleep 0.05
+done
+
+benchmark_runs lesma_client "${client_path}" run --socket "${socket_path}"
+benchmark_runs run_client "${compiler_path}" run --client --socket "${socket_path}"
+
+json=$(printf '{\n  "runs": %s,\n  "modes": [' "${runs}")
+for ((i = 0; i < ${#results[@]}; i++)); do
+  json+=$(printf '\n%s%s' "${results[$i]}" "$([ $((i + 1)) -lt ${#results[@]} ] && echo ",")")
+done
+json+=$(printf '\n  ]\n}')
+
+if [ -n "${output_path}" ]; then
+  printf "%s\n" "${json}" > "${output_path}"
+else
+  printf "%s\n" "${json}"
+fi
+
+exit ${mismatch_count}
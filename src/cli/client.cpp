@@ -0,0 +1,36 @@
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "liblesma/Driver/Protocol.h"
+#include "liblesma/Driver/Server.h"
+
+using namespace lesma;
+
+// Thin client of lesma server, takes the same arguments as lesma. It doesn't link the compiler, so it starts as fast
+// as any small program, and runs lesma itself when no server is listening.
+int main(int argc, char **argv) {
+    std::string socket = protocol::defaultSocketPath();
+    std::vector<std::string> args{"lesma"};
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc)
+            socket = argv[i + 1];
+        else if (arg.rfind("--socket=", 0) == 0)
+            socket = arg.substr(9);
+        args.push_back(arg);
+    }
+
+    try {
+        if (auto exit_code = Client::Forward(socket, args))
+            return *exit_code;
+    } catch (const LesmaError &err) {
+        print(ERROR, "{}\n", err.what());
+        return err.exit_code;
+    }
+
+    argv[0] = const_cast<char *>("lesma");
+    execvp(argv[0], argv);
+    print(ERROR, "No server listens on {}, and lesma isn't in the PATH\n", socket);
+    return 1;
+}
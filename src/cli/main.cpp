@@ -5,6 +5,8 @@
 #include "liblesma/Common/LesmaVersion.h"
 #include "liblesma/Common/Utils.h"
 #include "liblesma/Driver/Driver.h"
+#include "liblesma/Driver/Protocol.h"
+#include "liblesma/Driver/Server.h"
 
 using namespace lesma;
 
@@ -13,21 +15,44 @@ std::unique_ptr<CLIOptions> parseCLI(int argc, char **argv) {
     bool timer = false;
     std::string output = "output";
     std::string file;
+    std::string stats;
+    std::string stats_file;
+    std::vector<std::string> remarks;
+    std::string remarks_file;
+    bool client = false;
+    std::string socket = protocol::defaultSocketPath();
 
     CLI::App app{"Lesma programming language", "lesma"};
     app.set_version_flag("-v,--version", LESMA_VERSION, "Print the Lesma version");
     app.set_help_all_flag("-s,--subcommands", "Expand help to show subcommand flags and options");
     app.add_flag("-d,--debug", debug, "Enable debug logging");
     app.add_flag("-t,--timer", timer, "Enable compiler timer");
+    app.add_option("--stats", stats, "Print per-stage compiler statistics")->check(CLI::IsMember({"text", "json"}));
+    app.add_option("--stats-file", stats_file, "Write compiler statistics to a file instead of stdout");
+    app.add_option("-R", remarks, "Show optimization remarks, as pass=<regex>, pass-missed=<regex> or pass-analysis=<regex>")
+            ->check([](const std::string &remark) -> std::string {
+                auto kind = remark.substr(0, remark.find('='));
+                if (remark.find('=') == std::string::npos || (kind != "pass" && kind != "pass-missed" && kind != "pass-analysis"))
+                    return "Expected pass=<regex>, pass-missed=<regex> or pass-analysis=<regex>, found " + remark;
+                return "";
+            });
+    app.add_option("--remarks-file", remarks_file, "Write optimization remarks to a YAML file");
 
     CLI::App *run = app.add_subcommand("run", "Run source code");
     CLI::App *compile = app.add_subcommand("compile", "Compile source code");
+    CLI::App *server = app.add_subcommand("server", "Keep a compiler running and serve run and compile requests");
     app.require_subcommand();
 
     run->add_option("file", file, "Lesma source filename")->required();
     compile->add_option("file", file, "Lesma source filename")->required();
     compile->add_option("-o,--output", output, "Output filename");
 
+    for (auto *command: {run, compile}) {
+        command->add_flag("--client", client, "Send to a running lesma server, or compile here if there isn't one");
+        command->add_option("--socket", socket, "Socket of the lesma server");
+    }
+    server->add_option("--socket", socket, "Socket to listen on");
+
     try {
         app.parse(argc, argv);
     } catch (const CLI::ParseError &e) {
@@ -39,13 +64,58 @@ std::unique_ptr<CLIOptions> parseCLI(int argc, char **argv) {
         }
     }
 
-    return std::make_unique<CLIOptions>(CLIOptions{std::filesystem::absolute(file), output, debug, timer, run->parsed()});
+    return std::make_unique<CLIOptions>(CLIOptions{file.empty() ? file : std::filesystem::absolute(file).string(), output, debug, timer, run->parsed(), stats, stats_file, remarks, remarks_file, server->parsed(), client, socket});
+}
+
+RemarkOptions parseRemarks(const std::vector<std::string> &remarks, const std::string &remarks_file) {
+    RemarkOptions options;
+    options.filename = remarks_file;
+
+    for (const auto &remark: remarks) {
+        auto separator = remark.find('=');
+        auto kind = remark.substr(0, separator);
+        auto regex = remark.substr(separator + 1);
+        if (kind == "pass")
+            options.passed = regex;
+        else if (kind == "pass-missed")
+            options.missed = regex;
+        else if (kind == "pass-analysis")
+            options.analysis = regex;
+    }
+
+    return options;
+}
+
+int execute(const CLIOptions *options) {
+    auto stats = options->stats == "json" ? StatsFormat::JSON : options->stats == "text" ? StatsFormat::TEXT
+                                                                                          : StatsFormat::NONE;
+    auto driver_options = std::make_unique<Options>(Options{SourceType::FILE, options->file,
+                                                            static_cast<Debug>(options->debug ? (LEXER | AST | IR) : NONE), options->output, options->timer,
+                                                            stats, options->stats_file, parseRemarks(options->remarks, options->remarks_file)});
+    return options->jit ? Driver::Run(std::move(driver_options)) : Driver::Compile(std::move(driver_options));
 }
 
 int main(int argc, char **argv) {
     // CLI Parsing
     auto options = parseCLI(argc, argv);
-    auto driver_options = std::make_unique<Options>(Options{SourceType::FILE, options->file,
-                                                            static_cast<Debug>(options->debug ? (LEXER | AST | IR) : NONE), options->output, options->timer});
-    return options->jit ? Driver::Run(std::move(driver_options)) : Driver::Compile(std::move(driver_options));
+
+    try {
+        // Requests are run by forks of the server, they parse the command line of their client like it would have
+        if (options->server)
+            return Server::Serve(options->socket, [](const std::vector<std::string> &args) {
+                std::vector<char *> request_argv;
+                for (const auto &arg: args)
+                    request_argv.push_back(const_cast<char *>(arg.c_str()));
+                return execute(parseCLI(static_cast<int>(request_argv.size()), request_argv.data()).get());
+            });
+
+        if (options->client)
+            if (auto exit_code = Client::Forward(options->socket, std::vector<std::string>(argv, argv + argc)))
+                return *exit_code;
+    } catch (const LesmaError &err) {
+        print(ERROR, "{}\n", err.what());
+        return err.exit_code;
+    }
+
+    return execute(options.get());
 }
\ No newline at end of file
@@ -322,6 +322,143 @@ namespace lesma {
         }
     };
 
+    // Variable of a parallel loop that each thread updates on its own, combined with op (+, min or max) at the end
+    class Reduction {
+    public:
+        std::string op;
+        Literal *var;
+
+        Reduction(std::string op, Literal *var) : op(std::move(op)), var(var) {}
+
+        ~Reduction() {
+            delete var;
+        }
+    };
+
+    // Loops over a range, or over the values received from a channel until it's closed, then end is null
+    class For : public Statement {
+        Literal *var;
+        Expression *start;
+        Expression *end;
+        std::optional<Expression *> step;
+        bool inclusive;
+        Compound *block;
+        bool parallel;
+        std::optional<Expression *> chunk;
+        std::vector<Reduction *> reductions;
+
+    public:
+        For(llvm::SMRange Loc, Literal *var, Expression *start, Expression *end, std::optional<Expression *> step, bool inclusive, Compound *block,
+            bool parallel, std::optional<Expression *> chunk, std::vector<Reduction *> reductions) : Statement(Loc), var(var), start(start), end(end), step(step), inclusive(inclusive), block(block),
+                                                                                                      parallel(parallel), chunk(chunk), reductions(std::move(reductions)) {}
+        ~For() override {
+            delete var;
+            delete start;
+            delete end;
+            if (step.has_value())
+                delete step.value();
+            delete block;
+            if (chunk.has_value())
+                delete chunk.value();
+            for (auto reduction: reductions)
+                delete reduction;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] Literal *getIdentifier() const { return var; }
+        [[nodiscard]] [[maybe_unused]] Expression *getRangeStart() const { return start; }
+        [[nodiscard]] [[maybe_unused]] Expression *getRangeEnd() const { return end; }
+        [[nodiscard]] [[maybe_unused]] std::optional<Expression *> getStep() const { return step; }
+        [[nodiscard]] [[maybe_unused]] bool isInclusive() const { return inclusive; }
+        [[nodiscard]] [[maybe_unused]] Compound *getBlock() const { return block; }
+        [[nodiscard]] [[maybe_unused]] bool isParallel() const { return parallel; }
+        [[nodiscard]] [[maybe_unused]] std::optional<Expression *> getChunk() const { return chunk; }
+        [[nodiscard]] [[maybe_unused]] std::vector<Reduction *> getReductions() const { return reductions; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            std::string clauses;
+            if (chunk.has_value())
+                clauses += " chunk " + chunk.value()->toString(srcMgr, prefix, isTail);
+            for (auto reduction: reductions)
+                clauses += fmt::format(" reduce({}: {})", reduction->op, reduction->var->toString(srcMgr, prefix, isTail));
+
+            return fmt::format("{}{}{}For[Line({}-{}):Col({}-{})]: {} in {}{}{}{}{}\n{}",
+                               prefix, isTail ? "└──" : "├──", parallel ? "Parallel" : "",
+                               srcMgr->getLineAndColumn(getStart()).first,
+                               srcMgr->getLineAndColumn(getEnd()).first,
+                               srcMgr->getLineAndColumn(getStart()).second,
+                               srcMgr->getLineAndColumn(getEnd()).second,
+                               var->toString(srcMgr, prefix, isTail),
+                               start->toString(srcMgr, prefix, isTail),
+                               end == nullptr ? "" : inclusive ? "..." : "..",
+                               end == nullptr ? "" : end->toString(srcMgr, prefix, isTail),
+                               (step.has_value() ? " step " + step.value()->toString(srcMgr, prefix, isTail) : ""),
+                               clauses,
+                               block->toString(srcMgr, prefix + (isTail ? "    " : "│   "), true));
+        }
+    };
+
+    // Case of a select, which runs block with the value received from channel as var
+    class SelectCase {
+    public:
+        Literal *var;
+        Expression *channel;
+        Compound *block;
+
+        SelectCase(Literal *var, Expression *channel, Compound *block) : var(var), channel(channel), block(block) {}
+
+        ~SelectCase() {
+            delete var;
+            delete channel;
+            delete block;
+        }
+    };
+
+    // Receives from whichever channel of its cases has a value first, the else block runs once all of them are closed
+    class Select : public Statement {
+        std::vector<SelectCase *> cases;
+        std::optional<Compound *> elseBlock;
+
+    public:
+        Select(llvm::SMRange Loc, std::vector<SelectCase *> cases, std::optional<Compound *> elseBlock) : Statement(Loc), cases(std::move(cases)), elseBlock(elseBlock) {}
+        ~Select() override {
+            for (auto selectCase: cases)
+                delete selectCase;
+            if (elseBlock.has_value())
+                delete elseBlock.value();
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] std::vector<SelectCase *> getCases() const { return cases; }
+        [[nodiscard]] [[maybe_unused]] std::optional<Compound *> getElseBlock() const { return elseBlock; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            auto ret = fmt::format("{}{}Select[Line({}-{}):Col({}-{})]:\n",
+                                   prefix, isTail ? "└──" : "├──",
+                                   srcMgr->getLineAndColumn(getStart()).first,
+                                   srcMgr->getLineAndColumn(getEnd()).first,
+                                   srcMgr->getLineAndColumn(getStart()).second,
+                                   srcMgr->getLineAndColumn(getEnd()).second);
+            for (auto selectCase: cases) {
+                bool last = !elseBlock.has_value() && selectCase == cases.back();
+                ret += fmt::format("{}{}Case: {} from {}\n{}",
+                                   prefix + (isTail ? "    " : "│   "), last ? "└──" : "├──",
+                                   selectCase->var->toString(srcMgr, prefix, isTail),
+                                   selectCase->channel->toString(srcMgr, prefix, isTail),
+                                   selectCase->block->toString(srcMgr, prefix + (isTail ? "    " : "│   ") + (last ? "    " : "│   "), true));
+            }
+            if (elseBlock.has_value())
+                ret += fmt::format("{}└──Else\n{}", prefix + (isTail ? "    " : "│   "),
+                                   elseBlock.value()->toString(srcMgr, prefix + (isTail ? "    " : "│   ") + "    ", true));
+
+            return ret;
+        }
+    };
+
     class Parameter {
     public:
         std::string name;
@@ -344,11 +481,12 @@ namespace lesma {
         Compound *body;
         bool varargs;
         bool exported;
+        bool async;
 
     public:
         FuncDecl(llvm::SMRange Loc, std::string name, TypeExpr *return_type,
-                 std::vector<Parameter *> parameters, Compound *body, bool varargs, bool exported) : Statement(Loc), name(std::move(name)), return_type(return_type), parameters(std::move(parameters)),
-                                                                                                     body(body), varargs(varargs), exported(exported) {}
+                 std::vector<Parameter *> parameters, Compound *body, bool varargs, bool exported, bool async) : Statement(Loc), name(std::move(name)), return_type(return_type), parameters(std::move(parameters)),
+                                                                                                                 body(body), varargs(varargs), exported(exported), async(async) {}
         ~FuncDecl() override {
             for (auto param: parameters)
                 delete param;
@@ -366,10 +504,11 @@ namespace lesma {
         [[nodiscard]] [[maybe_unused]] Compound *getBody() const { return body; }
         [[nodiscard]] [[maybe_unused]] bool getVarArgs() const { return varargs; }
         [[nodiscard]] [[maybe_unused]] bool isExported() const { return exported; }
+        [[nodiscard]] [[maybe_unused]] bool isAsync() const { return async; }
 
         std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
-            auto ret = fmt::format("{}{}FuncDecl[Line({}-{}):Col({}-{})]: {}(",
-                                   prefix, isTail ? "└──" : "├──",
+            auto ret = fmt::format("{}{}{}FuncDecl[Line({}-{}):Col({}-{})]: {}(",
+                                   prefix, isTail ? "└──" : "├──", async ? "Async" : "",
                                    srcMgr->getLineAndColumn(getStart()).first,
                                    srcMgr->getLineAndColumn(getEnd()).first,
                                    srcMgr->getLineAndColumn(getStart()).second,
@@ -394,10 +533,11 @@ namespace lesma {
         std::vector<Parameter *> parameters;
         bool varargs;
         bool exported;
+        bool async;
 
     public:
         ExternFuncDecl(llvm::SMRange Loc, std::string name, TypeExpr *return_type,
-                       std::vector<Parameter *> parameters, bool varargs, bool exported) : Statement(Loc), name(std::move(name)), return_type(return_type), parameters(std::move(parameters)), varargs(varargs), exported(exported) {}
+                       std::vector<Parameter *> parameters, bool varargs, bool exported, bool async) : Statement(Loc), name(std::move(name)), return_type(return_type), parameters(std::move(parameters)), varargs(varargs), exported(exported), async(async) {}
 
         ~ExternFuncDecl() override {
             for (auto param: parameters)
@@ -414,10 +554,11 @@ namespace lesma {
         [[nodiscard]] [[maybe_unused]] std::vector<Parameter *> getParameters() const { return parameters; }
         [[nodiscard]] [[maybe_unused]] bool getVarArgs() const { return varargs; }
         [[nodiscard]] [[maybe_unused]] bool isExported() const { return exported; }
+        [[nodiscard]] [[maybe_unused]] bool isAsync() const { return async; }
 
         std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
-            auto ret = fmt::format("{}{}ExternFuncDecl[Line({}-{}):Col({}-{})]: {}(",
-                                   prefix, isTail ? "└──" : "├──",
+            auto ret = fmt::format("{}{}{}ExternFuncDecl[Line({}-{}):Col({}-{})]: {}(",
+                                   prefix, isTail ? "└──" : "├──", async ? "Async" : "",
                                    srcMgr->getLineAndColumn(getStart()).first,
                                    srcMgr->getLineAndColumn(getEnd()).first,
                                    srcMgr->getLineAndColumn(getStart()).second,
@@ -635,6 +776,173 @@ namespace lesma {
         }
     };
 
+    class Slice : public Expression {
+        Expression *expr;
+        Expression *startIndex;
+        Expression *endIndex;
+
+    public:
+        Slice(llvm::SMRange Loc, Expression *expr, Expression *startIndex, Expression *endIndex) : Expression(Loc), expr(expr), startIndex(startIndex), endIndex(endIndex) {}
+        ~Slice() override {
+            delete expr;
+            delete startIndex;
+            delete endIndex;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] Expression *getExpression() const { return expr; }
+        [[nodiscard]] [[maybe_unused]] Expression *getStartIndex() const { return startIndex; }
+        [[nodiscard]] [[maybe_unused]] Expression *getEndIndex() const { return endIndex; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            return expr->toString(srcMgr, prefix, isTail) + "[" +
+                   (startIndex != nullptr ? startIndex->toString(srcMgr, prefix, isTail) : "") + ":" +
+                   (endIndex != nullptr ? endIndex->toString(srcMgr, prefix, isTail) : "") + "]";
+        }
+    };
+
+    class Interpolation : public Expression {
+        // String literals and the expressions in braces between them, in order
+        std::vector<Expression *> parts;
+
+    public:
+        Interpolation(llvm::SMRange Loc, std::vector<Expression *> parts) : Expression(Loc), parts(std::move(parts)) {}
+        ~Interpolation() override {
+            for (auto part: parts)
+                delete part;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] std::vector<Expression *> getParts() const { return parts; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            std::string ret = "\"";
+            for (auto part: parts) {
+                auto literal = dynamic_cast<Literal *>(part);
+                if (literal != nullptr && literal->getType() == TokenType::STRING)
+                    ret += literal->getValue();
+                else
+                    ret += "{" + part->toString(srcMgr, prefix, isTail) + "}";
+            }
+            return ret + "\"";
+        }
+    };
+
+    class Spawn : public Expression {
+        FuncCall *call;
+
+    public:
+        Spawn(llvm::SMRange Loc, FuncCall *call) : Expression(Loc), call(call) {}
+        ~Spawn() override {
+            delete call;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] FuncCall *getCall() const { return call; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            return "spawn " + call->toString(srcMgr, prefix, isTail);
+        }
+    };
+
+    class Join : public Expression {
+        Expression *task;
+
+    public:
+        Join(llvm::SMRange Loc, Expression *task) : Expression(Loc), task(task) {}
+        ~Join() override {
+            delete task;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] Expression *getTask() const { return task; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            return "join " + task->toString(srcMgr, prefix, isTail);
+        }
+    };
+
+    class Await : public Expression {
+        Expression *value;
+
+    public:
+        Await(llvm::SMRange Loc, Expression *value) : Expression(Loc), value(value) {}
+        ~Await() override {
+            delete value;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] Expression *getValue() const { return value; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            return "await " + value->toString(srcMgr, prefix, isTail);
+        }
+    };
+
+    // Creates a channel of type: unbounded without arguments, otherwise bounded by the first one, and for a single
+    // producer and consumer if the second one is true
+    class NewChannel : public Expression {
+        TypeExpr *type;
+        std::vector<Expression *> arguments;
+
+    public:
+        NewChannel(llvm::SMRange Loc, TypeExpr *type, std::vector<Expression *> arguments) : Expression(Loc), type(type), arguments(std::move(arguments)) {}
+        ~NewChannel() override {
+            delete type;
+            for (auto arg: arguments)
+                delete arg;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] TypeExpr *getType() const { return type; }
+        [[nodiscard]] [[maybe_unused]] std::vector<Expression *> getArguments() const { return arguments; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            auto ret = type->getName() + "(";
+            for (auto arg: arguments) {
+                ret += arg->toString(srcMgr, prefix, isTail);
+                if (arguments.back() != arg) ret += ", ";
+            }
+            return ret + ")";
+        }
+    };
+
+    // Creates an atomic of type holding value, or the zero value without one
+    class NewAtomic : public Expression {
+        TypeExpr *type;
+        std::optional<Expression *> value;
+
+    public:
+        NewAtomic(llvm::SMRange Loc, TypeExpr *type, std::optional<Expression *> value) : Expression(Loc), type(type), value(value) {}
+        ~NewAtomic() override {
+            delete type;
+            if (value.has_value())
+                delete value.value();
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] TypeExpr *getType() const { return type; }
+        [[nodiscard]] [[maybe_unused]] std::optional<Expression *> getValue() const { return value; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            return type->getName() + "(" + (value.has_value() ? value.value()->toString(srcMgr, prefix, isTail) : "") + ")";
+        }
+    };
+
     class Else : public Expression {
     public:
         explicit Else(llvm::SMRange Loc) : Expression(Loc) {}
@@ -734,6 +1042,56 @@ namespace lesma {
         }
     };
 
+    class Region : public Statement {
+        Compound *block;
+
+    public:
+        Region(llvm::SMRange Loc, Compound *block) : Statement(Loc), block(block) {}
+        ~Region() override {
+            delete block;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] Compound *getBlock() const { return block; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            return fmt::format("{}{}Region[Line({}-{}):Col({}-{})]:\n{}",
+                               prefix, isTail ? "└──" : "├──",
+                               srcMgr->getLineAndColumn(getStart()).first,
+                               srcMgr->getLineAndColumn(getEnd()).first,
+                               srcMgr->getLineAndColumn(getStart()).second,
+                               srcMgr->getLineAndColumn(getEnd()).second,
+                               block->toString(srcMgr, prefix + (isTail ? "    " : "│   "), true));
+        }
+    };
+
+    class Delete : public Statement {
+        Expression *value;
+
+    public:
+        Delete(llvm::SMRange Loc, Expression *value) : Statement(Loc), value(value) {}
+        ~Delete() override {
+            delete value;
+        }
+        void accept(ASTVisitor &visitor) const override {
+            visitor.visit(this);
+        }
+
+        [[nodiscard]] [[maybe_unused]] Expression *getValue() const { return value; }
+
+        std::string toString(llvm::SourceMgr *srcMgr, const std::string &prefix, bool isTail) const override {
+            return fmt::format("{}{}Delete[Line({}-{}):Col({}-{})]: {}\n",
+                               prefix, isTail ? "└──" : "├──",
+                               srcMgr->getLineAndColumn(getStart()).first,
+                               srcMgr->getLineAndColumn(getEnd()).first,
+                               srcMgr->getLineAndColumn(getStart()).second,
+                               srcMgr->getLineAndColumn(getEnd()).second,
+                               value->toString(srcMgr, prefix, true));
+        }
+    };
+
     class Class : public Statement {
         std::string identifier;
         std::vector<VarDecl *> fields;
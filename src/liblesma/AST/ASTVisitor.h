@@ -10,6 +10,8 @@ namespace lesma {
     class VarDecl;
     class If;
     class While;
+    class For;
+    class Select;
     class FuncDecl;
     class ExternFuncDecl;
     class Assignment;
@@ -18,12 +20,21 @@ namespace lesma {
     class Continue;
     class Return;
     class Defer;
+    class Region;
+    class Delete;
     class Expression;
     class Literal;
     class FuncCall;
     class BinaryOp;
     class DotOp;
     class CastOp;
+    class Slice;
+    class Interpolation;
+    class Spawn;
+    class Join;
+    class Await;
+    class NewChannel;
+    class NewAtomic;
     class IsOp;
     class UnaryOp;
     class Else;
@@ -40,6 +51,8 @@ namespace lesma {
         virtual void visit(const VarDecl *node) = 0;
         virtual void visit(const If *node) = 0;
         virtual void visit(const While *node) = 0;
+        virtual void visit(const For *node) = 0;
+        virtual void visit(const Select *node) = 0;
         virtual void visit(const FuncDecl *node) = 0;
         virtual void visit(const ExternFuncDecl *node) = 0;
         virtual void visit(const Assignment *node) = 0;
@@ -48,6 +61,8 @@ namespace lesma {
         virtual void visit(const Continue *node) = 0;
         virtual void visit(const Return *node) = 0;
         virtual void visit(const Defer *node) = 0;
+        virtual void visit(const Region *node) = 0;
+        virtual void visit(const Delete *node) = 0;
 
         virtual void visit(const Expression *node) = 0;
         virtual void visit(const Literal *node) = 0;
@@ -55,6 +70,13 @@ namespace lesma {
         virtual void visit(const BinaryOp *node) = 0;
         virtual void visit(const DotOp *node) = 0;
         virtual void visit(const CastOp *node) = 0;
+        virtual void visit(const Slice *node) = 0;
+        virtual void visit(const Interpolation *node) = 0;
+        virtual void visit(const Spawn *node) = 0;
+        virtual void visit(const Join *node) = 0;
+        virtual void visit(const Await *node) = 0;
+        virtual void visit(const NewChannel *node) = 0;
+        virtual void visit(const NewAtomic *node) = 0;
         virtual void visit(const IsOp *node) = 0;
         virtual void visit(const UnaryOp *node) = 0;
         virtual void visit(const Else *node) = 0;
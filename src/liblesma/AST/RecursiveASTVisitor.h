@@ -0,0 +1,210 @@
+#pragma once
+
+#include "liblesma/AST/AST.h"
+
+namespace lesma {
+    /**
+     * ASTVisitor that walks every node of the tree in source order. Subclasses override the
+     * visit methods they are interested in and call back into RecursiveASTVisitor to keep descending,
+     * or override visitNode to observe every node regardless of its kind.
+     */
+    class RecursiveASTVisitor : public ASTVisitor {
+    public:
+        ~RecursiveASTVisitor() override = default;
+
+        /**
+         * Called once for every node before its children are visited
+         *
+         * @param kind Name of the node class
+         * @param node Visited node
+         */
+        virtual void visitNode([[maybe_unused]] const char *kind, [[maybe_unused]] const AST *node) {}
+
+        void walk(const AST *node) {
+            if (node != nullptr)
+                node->accept(*this);
+        }
+
+        void visit(const Statement *node) override { visitNode("Statement", node); }
+        void visit(const Compound *node) override {
+            visitNode("Compound", node);
+            for (auto child: node->getChildren())
+                walk(child);
+        }
+        void visit(const Import *node) override { visitNode("Import", node); }
+        void visit(const Enum *node) override { visitNode("Enum", node); }
+        void visit(const Class *node) override {
+            visitNode("Class", node);
+            for (auto field: node->getFields())
+                walk(field);
+            for (auto method: node->getMethods())
+                walk(method);
+        }
+        void visit(const VarDecl *node) override {
+            visitNode("VarDecl", node);
+            walk(node->getIdentifier());
+            if (node->getType().has_value())
+                walk(node->getType().value());
+            if (node->getValue().has_value())
+                walk(node->getValue().value());
+        }
+        void visit(const If *node) override {
+            visitNode("If", node);
+            auto conds = node->getConds();
+            auto blocks = node->getBlocks();
+            for (unsigned long i = 0; i < blocks.size(); i++) {
+                if (i < conds.size())
+                    walk(conds[i]);
+                walk(blocks[i]);
+            }
+        }
+        void visit(const While *node) override {
+            visitNode("While", node);
+            walk(node->getCond());
+            walk(node->getBlock());
+        }
+        void visit(const For *node) override {
+            visitNode("For", node);
+            walk(node->getIdentifier());
+            walk(node->getRangeStart());
+            walk(node->getRangeEnd());
+            if (node->getStep().has_value())
+                walk(node->getStep().value());
+            if (node->getChunk().has_value())
+                walk(node->getChunk().value());
+            for (auto reduction: node->getReductions())
+                walk(reduction->var);
+            walk(node->getBlock());
+        }
+        void visit(const Select *node) override {
+            visitNode("Select", node);
+            for (auto selectCase: node->getCases()) {
+                walk(selectCase->var);
+                walk(selectCase->channel);
+                walk(selectCase->block);
+            }
+            if (node->getElseBlock().has_value())
+                walk(node->getElseBlock().value());
+        }
+        void visit(const FuncDecl *node) override {
+            visitNode("FuncDecl", node);
+            for (auto param: node->getParameters()) {
+                walk(param->type);
+                walk(param->default_val);
+            }
+            walk(node->getReturnType());
+            walk(node->getBody());
+        }
+        void visit(const ExternFuncDecl *node) override {
+            visitNode("ExternFuncDecl", node);
+            for (auto param: node->getParameters()) {
+                walk(param->type);
+                walk(param->default_val);
+            }
+            walk(node->getReturnType());
+        }
+        void visit(const Assignment *node) override {
+            visitNode("Assignment", node);
+            walk(node->getLeftHandSide());
+            walk(node->getRightHandSide());
+        }
+        void visit(const ExpressionStatement *node) override {
+            visitNode("ExpressionStatement", node);
+            walk(node->getExpression());
+        }
+        void visit(const Break *node) override { visitNode("Break", node); }
+        void visit(const Continue *node) override { visitNode("Continue", node); }
+        void visit(const Return *node) override {
+            visitNode("Return", node);
+            walk(node->getValue());
+        }
+        void visit(const Defer *node) override {
+            visitNode("Defer", node);
+            walk(node->getStatement());
+        }
+        void visit(const Region *node) override {
+            visitNode("Region", node);
+            walk(node->getBlock());
+        }
+        void visit(const Delete *node) override {
+            visitNode("Delete", node);
+            walk(node->getValue());
+        }
+
+        void visit(const Expression *node) override { visitNode("Expression", node); }
+        void visit(const Literal *node) override { visitNode("Literal", node); }
+        void visit(const FuncCall *node) override {
+            visitNode("FuncCall", node);
+            for (auto arg: node->getArguments())
+                walk(arg);
+        }
+        void visit(const BinaryOp *node) override {
+            visitNode("BinaryOp", node);
+            walk(node->getLeft());
+            walk(node->getRight());
+        }
+        void visit(const DotOp *node) override {
+            visitNode("DotOp", node);
+            walk(node->getLeft());
+            walk(node->getRight());
+        }
+        void visit(const CastOp *node) override {
+            visitNode("CastOp", node);
+            walk(node->getExpression());
+            walk(node->getType());
+        }
+        void visit(const Slice *node) override {
+            visitNode("Slice", node);
+            walk(node->getExpression());
+            walk(node->getStartIndex());
+            walk(node->getEndIndex());
+        }
+        void visit(const Interpolation *node) override {
+            visitNode("Interpolation", node);
+            for (auto part: node->getParts())
+                walk(part);
+        }
+        void visit(const Spawn *node) override {
+            visitNode("Spawn", node);
+            walk(node->getCall());
+        }
+        void visit(const Join *node) override {
+            visitNode("Join", node);
+            walk(node->getTask());
+        }
+        void visit(const Await *node) override {
+            visitNode("Await", node);
+            walk(node->getValue());
+        }
+        void visit(const NewChannel *node) override {
+            visitNode("NewChannel", node);
+            walk(node->getType());
+            for (auto arg: node->getArguments())
+                walk(arg);
+        }
+        void visit(const NewAtomic *node) override {
+            visitNode("NewAtomic", node);
+            walk(node->getType());
+            if (node->getValue().has_value())
+                walk(node->getValue().value());
+        }
+        void visit(const IsOp *node) override {
+            visitNode("IsOp", node);
+            walk(node->getLeft());
+            walk(node->getRight());
+        }
+        void visit(const UnaryOp *node) override {
+            visitNode("UnaryOp", node);
+            walk(node->getExpression());
+        }
+        void visit(const Else *node) override { visitNode("Else", node); }
+
+        void visit(const TypeExpr *node) override {
+            visitNode("TypeExpr", node);
+            walk(node->getElementType());
+            for (auto param: node->getParams())
+                walk(param);
+            walk(node->getReturnType());
+        }
+    };
+}// namespace lesma
@@ -1,13 +1,51 @@
 #include "Codegen.h"
+#include "liblesma/AST/RecursiveASTVisitor.h"
+#include <map>
+#include <mutex>
+#include <set>
 
 using namespace lesma;
 
+namespace {
+    // The target registry and the symbols of the process JITs resolve C functions from are shared by the whole
+    // process, so they're set up once, by whichever thread compiles first
+    std::once_flag targetsInitialized;
+
+    // LLD keeps global state between links, so only one can run at a time
+    std::mutex lldLock;
+
+    // Standard library modules don't change while the process runs, so each one is compiled for the JIT once and
+    // every later program, or fork of a compile server, links the same object
+    std::mutex stdObjectsLock;
+    std::map<std::string, std::unique_ptr<llvm::MemoryBuffer>> stdObjects;
+
+    const llvm::MemoryBuffer *findStdObject(const std::string &path) {
+        std::lock_guard<std::mutex> lock(stdObjectsLock);
+        auto found = stdObjects.find(path);
+        return found != stdObjects.end() ? found->second.get() : nullptr;
+    }
+
+    // Threads that compiled the same module at once keep whichever object was cached first
+    const llvm::MemoryBuffer *cacheStdObject(const std::string &path, std::unique_ptr<llvm::MemoryBuffer> object) {
+        std::lock_guard<std::mutex> lock(stdObjectsLock);
+        return stdObjects.emplace(path, std::move(object)).first->second.get();
+    }
+
+    void initializeTargets() {
+        std::call_once(targetsInitialized, [] {
+            InitializeNativeTarget();
+            InitializeNativeTargetAsmPrinter();
+            InitializeNativeTargetAsmParser();
+            llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+        });
+    }
+}// namespace
+
 Codegen::Codegen(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr, const std::string &filename, std::vector<std::string> imports, bool jit, bool main, std::string alias, const std::shared_ptr<ThreadSafeContext> &context) {
-    InitializeNativeTarget();
-    InitializeNativeTargetAsmPrinter();
-    InitializeNativeTargetAsmParser();
+    initializeTargets();
 
     TheContext = context == nullptr ? std::make_shared<ThreadSafeContext>(std::make_unique<LLVMContext>()) : context;
+    isJIT = jit;
     TargetMachine = InitializeTargetMachine();
     TheModule = InitializeModule();
     if (jit) {
@@ -17,18 +55,18 @@ Codegen::Codegen(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcM
     Builder = std::make_unique<IRBuilder<>>(*TheContext->getContext());
     Parser_ = std::move(parser);
     SourceManager = std::move(srcMgr);
+    bufferId = SourceManager->getNumBuffers();
     Scope = new SymbolTable(nullptr);
 
     this->alias = std::move(alias);
     this->filename = filename;
     isMain = main;
-    isJIT = jit;
 
     ImportedModules = std::move(imports);
     TopLevelFunc = InitializeTopLevel();
 
-    // If it's not base.les stdlib, then import it
-    if (std::filesystem::absolute(filename) != getStdDir() + "base.les") {
+    // If it's not base.les stdlib, then import it, sources given as strings have no file name
+    if (filename.empty() || std::filesystem::absolute(filename) != getStdDir() + "base.les") {
         CompileModule(llvm::SMRange(), getStdDir() + "base.les", true, "base", true, true, {});
     }
 }
@@ -53,16 +91,41 @@ std::unique_ptr<llvm::TargetMachine> Codegen::InitializeTargetMachine() {
     if (!target)
         throw CodegenError({}, "Target not available:\n{}", error);
 
+    // JIT code only runs on this machine, so the optimizer can use every feature of the host CPU
+    std::string cpu = "generic";
+    llvm::SubtargetFeatures features;
+    llvm::StringMap<bool> hostFeatures;
+    if (isJIT) {
+        cpu = llvm::sys::getHostCPUName().str();
+        if (llvm::sys::getHostCPUFeatures(hostFeatures))
+            for (auto &feature: hostFeatures)
+                features.AddFeature(feature.first(), feature.second);
+    }
+
     llvm::TargetOptions opt;
     llvm::Reloc::Model rm = llvm::Reloc::Model();
-    std::unique_ptr<llvm::TargetMachine> target_machine(target->createTargetMachine(tripletString, "generic", "", opt, rm));
+    std::unique_ptr<llvm::TargetMachine> target_machine(target->createTargetMachine(tripletString, cpu, features.getString(), opt, rm));
     return target_machine;
 }
 
+// Target of the code the JIT compiles, which differs from the one of object files in its code model
+llvm::orc::JITTargetMachineBuilder Codegen::InitializeJITTargetMachineBuilder() {
+    auto machineBuilder = llvm::orc::JITTargetMachineBuilder(TargetMachine->getTargetTriple());
+    machineBuilder.setCPU(TargetMachine->getTargetCPU().str());
+    machineBuilder.addFeatures(llvm::SubtargetFeatures(TargetMachine->getTargetFeatureString()).getFeatures());
+    return machineBuilder;
+}
+
+// Compiles the module like the JIT would have, so it can be added to one as an object
+std::unique_ptr<llvm::MemoryBuffer> Codegen::CompileForJIT() {
+    auto machine = cantFail(InitializeJITTargetMachineBuilder().createTargetMachine());
+    return cantFail(llvm::orc::SimpleCompiler(*machine)(*TheModule), fmt::format("Failed compiling {}", filename).c_str());
+}
+
 std::unique_ptr<LLJIT> Codegen::InitializeJIT() {
     llvm::orc::LLJITBuilder builder;
     builder.setDataLayout(TheModule->getDataLayout());
-    builder.setJITTargetMachineBuilder(llvm::orc::JITTargetMachineBuilder(TargetMachine->getTargetTriple()));
+    builder.setJITTargetMachineBuilder(InitializeJITTargetMachineBuilder());
     auto jit = llvm::cantFail(builder.create());
     if (!jit) {
         throw CodegenError({}, "Couldn't initialize JIT\n");
@@ -74,6 +137,81 @@ std::unique_ptr<LLJIT> Codegen::InitializeJIT() {
             cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(
                     jit->getDataLayout().getGlobalPrefix())));
 
+    // The runtime library is linked into the compiler, hand its functions to the JIT directly
+    llvm::orc::SymbolMap runtimeSymbols;
+    for (const auto &[name, address]: std::initializer_list<std::pair<const char *, void *>>{
+                 {"lesma_alloc", reinterpret_cast<void *>(&lesma_alloc)},
+                 {"lesma_alloc_frame", reinterpret_cast<void *>(&lesma_alloc_frame)},
+                 {"lesma_free", reinterpret_cast<void *>(&lesma_free)},
+                 {"lesma_region_enter", reinterpret_cast<void *>(&lesma_region_enter)},
+                 {"lesma_region_exit", reinterpret_cast<void *>(&lesma_region_exit)},
+                 {"lesma_string_length", reinterpret_cast<void *>(&lesma_string_length)},
+                 {"lesma_string_from_c", reinterpret_cast<void *>(&lesma_string_from_c)},
+                 {"lesma_string_concat", reinterpret_cast<void *>(&lesma_string_concat)},
+                 {"lesma_string_equal", reinterpret_cast<void *>(&lesma_string_equal)},
+                 {"lesma_string_compare", reinterpret_cast<void *>(&lesma_string_compare)},
+                 {"lesma_string_slice", reinterpret_cast<void *>(&lesma_string_slice)},
+                 {"lesma_string_read_line", reinterpret_cast<void *>(&lesma_string_read_line)},
+                 {"lesma_format_int", reinterpret_cast<void *>(&lesma_format_int)},
+                 {"lesma_format_float", reinterpret_cast<void *>(&lesma_format_float)},
+                 {"lesma_write_string", reinterpret_cast<void *>(&lesma_write_string)},
+                 {"lesma_write_int", reinterpret_cast<void *>(&lesma_write_int)},
+                 {"lesma_write_float", reinterpret_cast<void *>(&lesma_write_float)},
+                 {"lesma_write_newline", reinterpret_cast<void *>(&lesma_write_newline)},
+                 {"lesma_flush", reinterpret_cast<void *>(&lesma_flush)},
+                 {"lesma_panic", reinterpret_cast<void *>(&lesma_panic)},
+                 {"lesma_writer_open", reinterpret_cast<void *>(&lesma_writer_open)},
+                 {"lesma_writer_write_string", reinterpret_cast<void *>(&lesma_writer_write_string)},
+                 {"lesma_writer_write_int", reinterpret_cast<void *>(&lesma_writer_write_int)},
+                 {"lesma_writer_write_float", reinterpret_cast<void *>(&lesma_writer_write_float)},
+                 {"lesma_writer_flush", reinterpret_cast<void *>(&lesma_writer_flush)},
+                 {"lesma_writer_close", reinterpret_cast<void *>(&lesma_writer_close)},
+                 {"lesma_file_exists", reinterpret_cast<void *>(&lesma_file_exists)},
+                 {"lesma_file_remove", reinterpret_cast<void *>(&lesma_file_remove)},
+                 {"lesma_file_map", reinterpret_cast<void *>(&lesma_file_map)},
+                 {"lesma_file_unmap", reinterpret_cast<void *>(&lesma_file_unmap)},
+                 {"lesma_reader_open", reinterpret_cast<void *>(&lesma_reader_open)},
+                 {"lesma_reader_next", reinterpret_cast<void *>(&lesma_reader_next)},
+                 {"lesma_reader_line", reinterpret_cast<void *>(&lesma_reader_line)},
+                 {"lesma_reader_close", reinterpret_cast<void *>(&lesma_reader_close)},
+                 {"lesma_task_new", reinterpret_cast<void *>(&lesma_task_new)},
+                 {"lesma_task_spawn", reinterpret_cast<void *>(&lesma_task_spawn)},
+                 {"lesma_task_join", reinterpret_cast<void *>(&lesma_task_join)},
+                 {"lesma_task_free", reinterpret_cast<void *>(&lesma_task_free)},
+                 {"lesma_parallel_slots", reinterpret_cast<void *>(&lesma_parallel_slots)},
+                 {"lesma_parallel_fill", reinterpret_cast<void *>(&lesma_parallel_fill)},
+                 {"lesma_parallel_for", reinterpret_cast<void *>(&lesma_parallel_for)},
+                 {"lesma_channel_new", reinterpret_cast<void *>(&lesma_channel_new)},
+                 {"lesma_channel_send", reinterpret_cast<void *>(&lesma_channel_send)},
+                 {"lesma_channel_recv", reinterpret_cast<void *>(&lesma_channel_recv)},
+                 {"lesma_channel_select", reinterpret_cast<void *>(&lesma_channel_select)},
+                 {"lesma_channel_close", reinterpret_cast<void *>(&lesma_channel_close)},
+                 {"lesma_channel_closed", reinterpret_cast<void *>(&lesma_channel_closed)},
+                 {"lesma_channel_free", reinterpret_cast<void *>(&lesma_channel_free)},
+                 {"lesma_async_ready", reinterpret_cast<void *>(&lesma_async_ready)},
+                 {"lesma_async_step", reinterpret_cast<void *>(&lesma_async_step)},
+                 {"lesma_event_read", reinterpret_cast<void *>(&lesma_event_read)},
+                 {"lesma_event_read_into", reinterpret_cast<void *>(&lesma_event_read_into)},
+                 {"lesma_event_write", reinterpret_cast<void *>(&lesma_event_write)},
+                 {"lesma_event_read_file", reinterpret_cast<void *>(&lesma_event_read_file)},
+                 {"lesma_event_write_file", reinterpret_cast<void *>(&lesma_event_write_file)},
+                 {"lesma_event_readable", reinterpret_cast<void *>(&lesma_event_readable)},
+                 {"lesma_event_writable", reinterpret_cast<void *>(&lesma_event_writable)},
+                 {"lesma_event_sleep", reinterpret_cast<void *>(&lesma_event_sleep)},
+                 {"lesma_event_close", reinterpret_cast<void *>(&lesma_event_close)},
+                 {"lesma_event_pipe", reinterpret_cast<void *>(&lesma_event_pipe)},
+                 {"lesma_net_listen", reinterpret_cast<void *>(&lesma_net_listen)},
+                 {"lesma_net_local_port", reinterpret_cast<void *>(&lesma_net_local_port)},
+                 {"lesma_net_accept", reinterpret_cast<void *>(&lesma_net_accept)},
+                 {"lesma_net_connect", reinterpret_cast<void *>(&lesma_net_connect)},
+                 {"lesma_net_connecting", reinterpret_cast<void *>(&lesma_net_connecting)},
+                 {"lesma_net_connected", reinterpret_cast<void *>(&lesma_net_connected)},
+                 {"lesma_net_buffer_acquire", reinterpret_cast<void *>(&lesma_net_buffer_acquire)},
+                 {"lesma_net_buffer_release", reinterpret_cast<void *>(&lesma_net_buffer_release)},
+         })
+        runtimeSymbols[jit->mangleAndIntern(name)] = JITEvaluatedSymbol(pointerToJITTargetAddress(address), JITSymbolFlags::Exported);
+    llvm::cantFail(MainJD.define(absoluteSymbols(std::move(runtimeSymbols))));
+
     return jit;
 }
 
@@ -89,15 +227,81 @@ llvm::Function *Codegen::InitializeTopLevel() {
     return F;
 }
 
+void Codegen::EnableDebugInfo() {
+    if (DBuilder != nullptr)
+        return;
+
+    std::filesystem::path path = filename.empty() ? "<string>" : filename;
+    DBuilder = std::make_unique<DIBuilder>(*TheModule);
+    DebugFile = DBuilder->createFile(path.filename().string(), path.parent_path().string());
+    DBuilder->createCompileUnit(dwarf::DW_LANG_C, DebugFile, "Lesma Compiler", true, "", 0, "", DICompileUnit::LineTablesOnly);
+
+    TheModule->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+    TheModule->addModuleFlag(Module::Warning, "Dwarf Version", 4);
+}
+
+void Codegen::EnableRemarks(const RemarkOptions &options) {
+    if (!options.isEnabled())
+        return;
+
+    // Remarks are only useful if they can point to a line of code
+    EnableDebugInfo();
+
+    auto *context = TheContext->getContext();
+    if (options.isRendered())
+        context->setDiagnosticHandler(std::make_unique<RemarkHandler>(SourceManager.get(), bufferId, filename, options));
+
+    if (!options.filename.empty()) {
+        auto file = setupLLVMOptimizationRemarks(*context, options.filename, "", "yaml", false);
+        if (!file)
+            throw CodegenError({}, "Could not open remarks file {}: {}", options.filename, toString(file.takeError()));
+
+        RemarksFile = std::move(*file);
+        RemarksFile->keep();
+    }
+}
+
+DISubprogram *Codegen::CreateSubprogram(llvm::Function *F, const AST *node) {
+    if (DBuilder == nullptr)
+        return nullptr;
+
+    unsigned int line = SourceManager->getLineAndColumn(node->getStart()).first;
+    auto flags = F->hasLocalLinkage() ? DISubprogram::SPFlagDefinition | DISubprogram::SPFlagLocalToUnit : DISubprogram::SPFlagDefinition;
+    auto *SP = DBuilder->createFunction(DebugFile, getDemangledName(F->getName().str()), F->getName(), DebugFile, line,
+                                        DBuilder->createSubroutineType(DBuilder->getOrCreateTypeArray({})), line,
+                                        DINode::FlagPrototyped, flags);
+    F->setSubprogram(SP);
+
+    return SP;
+}
+
+void Codegen::EmitLocation(const AST *node) {
+    if (DBuilder == nullptr || node == nullptr || Builder->GetInsertBlock() == nullptr)
+        return;
+
+    auto *SP = Builder->GetInsertBlock()->getParent()->getSubprogram();
+    if (SP == nullptr)
+        return;
+
+    auto loc = SourceManager->getLineAndColumn(node->getStart());
+    Builder->SetCurrentDebugLocation(DILocation::get(SP->getContext(), loc.first, loc.second, SP));
+}
+
 void Codegen::defineFunction(lesma::Value *value, const FuncDecl *node, Value *clsSymbol) {
     Scope = Scope->createChildBlock(node->getName());
     currentFunction = value;
+    regionDepth = 0;
     deferStack.emplace();
 
     auto *F = cast<Function>(value->getLLVMValue());
 
     BasicBlock *entry = BasicBlock::Create(*TheContext->getContext(), "entry", F);
     Builder->SetInsertPoint(entry);
+    CreateSubprogram(F, node);
+    EmitLocation(node);
+
+    if (node->isAsync())
+        genCoroutineBegin(F, value->getType()->getReturnType()->getElementType());
 
     int fieldIndex = 0;
     for (auto &field: value->getType()->getFields()) {
@@ -108,7 +312,7 @@ void Codegen::defineFunction(lesma::Value *value, const FuncDecl *node, Value *c
         else
             param->setName(node->getParameters()[param->getArgNo() - (clsSymbol != nullptr ? 1 : 0)]->name);
 
-        llvm::Value *ptr = Builder->CreateAlloca(param->getType(), nullptr, param->getName() + "_ptr");
+        llvm::Value *ptr = CreateEntryBlockAlloca(param->getType(), param->getName().str() + "_ptr");
         Builder->CreateStore(param, ptr);
 
         auto symbol = new Value(field->name, field->type, ptr);
@@ -119,19 +323,19 @@ void Codegen::defineFunction(lesma::Value *value, const FuncDecl *node, Value *c
 
     node->getBody()->accept(*this);
 
-    auto instrs = deferStack.top();
-    deferStack.pop();
-
     if (!isReturn)
-        for (auto inst: instrs)
-            inst->accept(*this);
+        genDeferred();
+    deferStack.pop();
 
     // Check for well-formness of all BBs. In particular, look for
     // any unterminated BB and try to add a Return to it.
     for (BasicBlock &BB: *F) {
         Instruction *Terminator = BB.getTerminator();
         if (Terminator != nullptr) continue;// Well-formed
-        if (value->getType()->getReturnType()->is(TY_VOID)) {
+        if (node->isAsync() && value->getType()->getReturnType()->getElementType()->is(TY_VOID)) {
+            Builder->SetInsertPoint(&BB);
+            Builder->CreateBr(coroutine.finalBlock);
+        } else if (value->getType()->getReturnType()->is(TY_VOID)) {
             // Make implicit return of void Function explicit.
             Builder->SetInsertPoint(&BB);
             Builder->CreateRetVoid();
@@ -154,9 +358,11 @@ void Codegen::defineFunction(lesma::Value *value, const FuncDecl *node, Value *c
     Scope = Scope->getParent();
 
     currentFunction = nullptr;
+    coroutine = {};
 
     // Reset Insert Point to Top Level
     Builder->SetInsertPoint(&TopLevelFunc->back());
+    Builder->SetCurrentDebugLocation(DebugLoc());
 }
 
 void Codegen::CompileModule(llvm::SMRange span, const std::string &filepath, bool isStd, const std::string &module_alias, bool importAll, bool importToScope, const std::vector<std::pair<std::string, std::string>> &imported_names) {
@@ -177,6 +383,9 @@ void Codegen::CompileModule(llvm::SMRange span, const std::string &filepath, boo
     auto source_str = SourceManager->getMemoryBuffer(file_id)->getBuffer().str();
     ImportedModules.push_back(absolute_path);
 
+    // A standard library module compiled earlier only needs its declarations, its object is linked instead
+    const llvm::MemoryBuffer *stdObject = isStd && isJIT ? findStdObject(absolute_path) : nullptr;
+
     try {
         // Lexer
         auto lexer = std::make_unique<Lexer>(SourceManager);
@@ -189,11 +398,15 @@ void Codegen::CompileModule(llvm::SMRange span, const std::string &filepath, boo
         // TODO: Delete it, memory leak, smart pointer made us lose the references to other modules
         // Codegen
         auto codegen = std::make_unique<Codegen>(std::move(parser), SourceManager, absolute_path, ImportedModules, isJIT, false, !importToScope ? module_alias : "", TheContext);
+        codegen->isStd = isStd;
+        codegen->declarationsOnly = stdObject != nullptr;
         codegen->Run();
 
         // Optimize
-        codegen->Optimize(OptimizationLevel::O3);
-        codegen->TheModule->setModuleIdentifier(filepath);
+        if (stdObject == nullptr) {
+            codegen->Optimize(OptimizationLevel::O3);
+            codegen->TheModule->setModuleIdentifier(filepath);
+        }
 
         ImportedModules = std::move(codegen->ImportedModules);
 
@@ -213,7 +426,11 @@ void Codegen::CompileModule(llvm::SMRange span, const std::string &filepath, boo
             return "";
         };
 
-        if (isJIT) {
+        if (isJIT && isStd) {
+            if (stdObject == nullptr)
+                stdObject = cacheStdObject(absolute_path, codegen->CompileForJIT());
+            cantFail(TheJIT->addObjectFile(MemoryBuffer::getMemBuffer(stdObject->getMemBufferRef(), false)), fmt::format("Failed adding import {} to JIT", filename).c_str());
+        } else if (isJIT) {
             // Add the module to JIT
             cantFail(TheJIT->addIRModule(ThreadSafeModule(std::move(codegen->TheModule), *TheContext)), fmt::format("Failed adding import {} to JIT", filename).c_str());
         } else {
@@ -255,6 +472,8 @@ void Codegen::CompileModule(llvm::SMRange span, const std::string &filepath, boo
                 // TODO: methods should only be imported if they class is in the imports specified
                 if (func_symbol != nullptr && func_symbol->isExported() && (importAll || !imp_alias.empty() || isMethod(sym.second->getMangledName()))) {
                     auto symbol = new Value(imp_alias.empty() ? name : std::regex_replace(name, std::regex(name), imp_alias), func_symbol->getType());
+                    symbol->setExtern(func_symbol->isExtern());
+                    symbol->setRuntime(func_symbol->isRuntime());
 
                     if (isJIT) {
                         symbol->getType()->setLLVMType(FTy);
@@ -285,9 +504,6 @@ void Codegen::CompileModule(llvm::SMRange span, const std::string &filepath, boo
 }
 
 void Codegen::Optimize(OptimizationLevel opt) {
-    if (opt == OptimizationLevel::O0)
-        return;
-
     llvm::LoopAnalysisManager LAM;
     llvm::FunctionAnalysisManager FAM;
     llvm::CGSCCAnalysisManager CGAM;
@@ -301,12 +517,27 @@ void Codegen::Optimize(OptimizationLevel opt) {
     PB.registerLoopAnalyses(LAM);
     PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
 
+    // Even unoptimized, async functions have to be split into coroutines before code generation
+    if (opt == OptimizationLevel::O0) {
+        PB.buildO0DefaultPipeline(opt).run(*TheModule, MAM);
+        return;
+    }
+
+    // The module optimization pipeline expects simplified functions, promote locals to SSA values first
+    llvm::FunctionPassManager EarlyFPM;
+    EarlyFPM.addPass(llvm::SROAPass());
+    EarlyFPM.addPass(llvm::EarlyCSEPass());
+    EarlyFPM.addPass(llvm::InstCombinePass());
+    EarlyFPM.addPass(llvm::SimplifyCFGPass());
+
     // Add custom passes to LoopPassManager
     llvm::LoopPassManager LPM;
     LPM.addPass(llvm::LoopFullUnrollPass());
 
     // Add custom passes to FunctionPassManager
     llvm::FunctionPassManager FPM;
+    FPM.addPass(HeapToStackPass());
+    FPM.addPass(llvm::SROAPass());
     FPM.addPass(llvm::ADCEPass());
     FPM.addPass(llvm::GVNPass());
     FPM.addPass(llvm::DSEPass());
@@ -314,12 +545,22 @@ void Codegen::Optimize(OptimizationLevel opt) {
     FPM.addPass(llvm::createFunctionToLoopPassAdaptor(std::move(LPM)));
 
     // Add custom passes to CGSCCPassManager
+    // Async functions are split into their resume and destroy parts bottom-up, so by the time a caller is visited the
+    // start of the coroutine it calls has been inlined, and CoroElide can move frames that don't outlive it to its stack
     llvm::CGSCCPassManager CGPM;
     CGPM.addPass(llvm::InlinerPass());
+    CGPM.addPass(llvm::createCGSCCToFunctionPassAdaptor(llvm::CoroElidePass()));
+    CGPM.addPass(llvm::CoroSplitPass(true));
+    CGPM.addPass(llvm::PostOrderFunctionAttrsPass());
 
     // Add custom pass managers to ModulePassManager
-    llvm::ModulePassManager MPM = PB.buildModuleOptimizationPipeline(opt, ThinOrFullLTOPhase::FullLTOPreLink);
+    // Coroutines have to be split before the module pipeline, which lowers what is left of them
+    llvm::ModulePassManager MPM;
+    MPM.addPass(llvm::CoroEarlyPass());
+    MPM.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(EarlyFPM)));
     MPM.addPass(llvm::createModuleToPostOrderCGSCCPassAdaptor(std::move(CGPM)));
+    MPM.addPass(PB.buildModuleOptimizationPipeline(opt, ThinOrFullLTOPhase::FullLTOPreLink));
+    MPM.addPass(llvm::CoroCleanupPass());
     MPM.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(FPM)));
     MPM.addPass(llvm::GlobalDCEPass());
 
@@ -370,6 +611,7 @@ void Codegen::WriteToObjectFile(const std::string &output) {
 #endif
 
     // Run the LLD linker
+    std::lock_guard<std::mutex> guard(lldLock);
     bool success = false;
 #ifdef __APPLE__
     success = lld::macho::link(args, llvm::outs(), llvm::errs(), false, true);
@@ -403,11 +645,20 @@ void Codegen::WriteToObjectFile(const std::string &output) {
         args.push_back(obj.c_str());
     }
 
+    // Lesma runtime library, installed next to the standard library, it goes before the system libraries it uses
+    std::string runtimeDir = "-L" + getRuntimeDir();
+    args.push_back(runtimeDir.c_str());
+    args.push_back("-llesmart");
+
     // Add the standard library path for Apple
 #ifdef __APPLE__
     args.push_back("-L");
     args.push_back("/Library/Developer/CommandLineTools/SDKs/MacOSX.sdk/usr/lib");
     args.push_back("-lSystem");
+#else
+    // The math module and the runtime bind to libm and pthreads, which the JIT resolves from the process but the linker doesn't add by default
+    args.push_back("-lm");
+    args.push_back("-lpthread");
 #endif
 
     // Set up the diagnostic engine
@@ -452,31 +703,69 @@ void Codegen::PrepareJIT() {
     mainFuncAddress = jitTargetAddressToFunction<MainFnTy *>(main_func->getValue());
 }
 
+std::vector<Codegen::ExportedFunction> Codegen::getExportedFunctions() {
+    std::vector<ExportedFunction> functions;
+    for (const auto &[name, symbol]: Scope->getSymbols()) {
+        // Imported functions are only declared here, methods need an instance
+        auto *F = llvm::dyn_cast_or_null<Function>(symbol->getLLVMValue());
+        if (!symbol->getType()->is(TY_FUNCTION) || !symbol->isExported() || F == nullptr || F->isDeclaration() || isMethod(symbol->getMangledName()))
+            continue;
+
+        ExportedFunction function{name, symbol->getMangledName(), {}, getTypeMangledName({}, symbol->getType()->getReturnType())};
+        for (auto field: symbol->getType()->getFields())
+            function.paramTypes.push_back(getTypeMangledName({}, field->type));
+        functions.push_back(std::move(function));
+    }
+
+    return functions;
+}
+
+void *Codegen::getSymbolAddress(const std::string &symbol) {
+    auto address = TheJIT->lookup(symbol);
+    if (!address) {
+        llvm::consumeError(address.takeError());
+        return nullptr;
+    }
+
+    return jitTargetAddressToPointer<void *>(address->getValue());
+}
+
 int Codegen::ExecuteJIT() {
     if (mainFuncAddress == nullptr) {
         throw CodegenError({}, "Main function address not found, did you prepare JIT?\n");
     }
 
-    return mainFuncAddress();
+    // The program's output is buffered by the runtime, which lives as long as the compiler does
+    int ret = mainFuncAddress();
+    lesma_flush();
+    return ret;
 }
 
 void Codegen::Run() {
+    CreateSubprogram(TopLevelFunc, Parser_->getAST());
+
     deferStack.emplace();
     Parser_->getAST()->accept(*this);
 
-    auto instrs = deferStack.top();
-    deferStack.pop();
-
     // Visit all statements
-    for (auto inst: instrs)
-        inst->accept(*this);
+    genDeferred();
+    deferStack.pop();
 
-    // Define the function bodies
-    for (auto prot: Prototypes)
-        defineFunction(std::get<0>(prot), std::get<1>(prot), std::get<2>(prot));
+    // Define the function bodies, unless the compiled module is cached
+    if (!declarationsOnly)
+        for (auto prot: Prototypes)
+            defineFunction(std::get<0>(prot), std::get<1>(prot), std::get<2>(prot));
+
+    // Return 0 for top-level function, wherever it doesn't return an exit code already
+    for (BasicBlock &BB: *TopLevelFunc) {
+        if (BB.getTerminator() != nullptr)
+            continue;
+        Builder->SetInsertPoint(&BB);
+        Builder->CreateRet(ConstantInt::getSigned(Builder->getInt64Ty(), 0));
+    }
 
-    // Return 0 for top-level function
-    Builder->CreateRet(ConstantInt::getSigned(Builder->getInt64Ty(), 0));
+    if (DBuilder != nullptr)
+        DBuilder->finalize();
 }
 
 void Codegen::Dump() {
@@ -513,6 +802,24 @@ void Codegen::visit(const TypeExpr *node) {
     else if (node->getType() == TokenType::PTR_TYPE) {
         node->getElementType()->accept(*this);
         result = new lesma::Value(new lesma::Type(TY_PTR, Builder->getPtrTy(), result->getType()));
+    } else if (node->getType() == TokenType::CHAN_TYPE) {
+        node->getElementType()->accept(*this);
+        auto elementType = result->getType();
+        if (elementType->is(TY_VOID))
+            throw CodegenError(node->getSpan(), "Channels cannot carry void");
+
+        // Like variables, channels of class instances carry pointers to them
+        if (elementType->is(TY_CLASS))
+            elementType = new lesma::Type(TY_PTR, Builder->getPtrTy(), elementType);
+        result = new lesma::Value(new lesma::Type(TY_CHANNEL, Builder->getPtrTy(), elementType));
+    } else if (node->getType() == TokenType::ATOMIC_TYPE) {
+        node->getElementType()->accept(*this);
+        auto elementType = result->getType();
+        if (elementType->is(TY_CLASS))
+            elementType = new lesma::Type(TY_PTR, Builder->getPtrTy(), elementType);
+        if (!elementType->isOneOf({TY_INT, TY_BOOL, TY_PTR}))
+            throw CodegenError(node->getSpan(), "Atomics can only hold integers, booleans, pointers or class instances, found {}", elementType->toString());
+        result = new lesma::Value(new lesma::Type(TY_ATOMIC, Builder->getPtrTy(), elementType));
     } else if (node->getType() == TokenType::FUNC_TYPE) {
         node->getReturnType()->accept(*this);
         auto ret_type = result;
@@ -541,8 +848,23 @@ void Codegen::visit(const TypeExpr *node) {
 }
 
 void Codegen::visit(const Compound *node) {
-    for (auto elem: node->getChildren())
+    lifetimeScopes.emplace();
+    auto deferred = deferStack.empty() ? 0 : deferStack.top().size();
+
+    for (auto elem: node->getChildren()) {
+        EmitLocation(elem);
         elem->accept(*this);
+    }
+
+    // Variables of nested blocks die with the block, so their stack slots can be shared by disjoint blocks.
+    // The outermost block of a function is skipped, and so are blocks that deferred statements, which can still
+    // use their variables when the function returns.
+    auto slots = lifetimeScopes.top();
+    lifetimeScopes.pop();
+    bool deferring = !deferStack.empty() && deferStack.top().size() != deferred;
+    if (!lifetimeScopes.empty() && !deferring && Builder->GetInsertBlock()->getTerminator() == nullptr)
+        for (auto it = slots.rbegin(); it != slots.rend(); ++it)
+            Builder->CreateLifetimeEnd(*it);
 }
 
 void Codegen::visit(const VarDecl *node) {
@@ -563,12 +885,16 @@ void Codegen::visit(const VarDecl *node) {
         type = result->getType();
     }
 
-    auto ptr = Builder->CreateAlloca(type->getLLVMType(), nullptr, node->getIdentifier()->getValue());
-
+    // Class variables hold a pointer to the instance
     if (type->is(TY_CLASS)) {
         type = new Type(TY_PTR, Builder->getPtrTy(), type);
         isClass = true;
     }
+
+    auto ptr = CreateEntryBlockAlloca(type->getLLVMType(), node->getIdentifier()->getValue());
+    Builder->CreateLifetimeStart(ptr);
+    if (!lifetimeScopes.empty())
+        lifetimeScopes.top().push_back(ptr);
     auto symbol = new Value(node->getIdentifier()->getValue(), type, node->getType().has_value() ? INITIALIZED : DECLARED);
     symbol->setLLVMValue(ptr);
     symbol->setMutable(node->getMutability());
@@ -598,6 +924,7 @@ void Codegen::visit(const If *node) {
             bIfFalse->insertInto(parentFct);
         }
 
+        EmitLocation(node->getConds().at(i));
         node->getConds().at(i)->accept(*this);
         Builder->CreateCondBr(result->getLLVMValue(), bIfTrue, bIfFalse);
         Builder->SetInsertPoint(bIfTrue);
@@ -638,6 +965,7 @@ void Codegen::visit(const While *node) {
 
     breakBlocks.push(bEnd);
     continueBlocks.push(bCond);
+    loopRegionDepths.push(regionDepth);
 
     // Jump into condition block
     Builder->CreateBr(bCond);
@@ -645,6 +973,7 @@ void Codegen::visit(const While *node) {
     // Fill condition block
     bCond->insertInto(parentFct);
     Builder->SetInsertPoint(bCond);
+    EmitLocation(node->getCond());
     node->getCond()->accept(*this);
     Builder->CreateCondBr(result->getLLVMValue(), bLoop, bEnd);
 
@@ -665,6 +994,552 @@ void Codegen::visit(const While *node) {
     Scope = Scope->getParent();
     breakBlocks.pop();
     continueBlocks.pop();
+    loopRegionDepths.pop();
+}
+
+void Codegen::visit(const For *node) {
+    if (node->getRangeEnd() == nullptr) {
+        genChannelFor(node);
+        return;
+    }
+
+    // The bounds and the step are evaluated once, before entering the loop
+    node->getRangeStart()->accept(*this);
+    auto start = result;
+    node->getRangeEnd()->accept(*this);
+    auto end = result;
+    lesma::Value *step = new Value("", new Type(TY_INT, Builder->getInt64Ty()), Builder->getInt64(1));
+    if (node->getStep().has_value()) {
+        node->getStep().value()->accept(*this);
+        step = result;
+    }
+
+    if (!start->getType()->is(TY_INT) || !end->getType()->is(TY_INT) || !step->getType()->is(TY_INT))
+        throw CodegenError(node->getSpan(), "Range bounds and step must be integers");
+
+    auto type = GetExtendedType(GetExtendedType(start->getType(), end->getType()), step->getType());
+    auto startVal = Cast(node->getSpan(), start, type)->getLLVMValue();
+    auto endVal = Cast(node->getSpan(), end, type)->getLLVMValue();
+    auto stepVal = Cast(node->getSpan(), step, type)->getLLVMValue();
+
+    auto constStep = llvm::dyn_cast<llvm::ConstantInt>(stepVal);
+    if (constStep != nullptr && constStep->isZero())
+        throw CodegenError(node->getStep().value()->getSpan(), "Range step cannot be zero");
+
+    llvm::Function *parentFct = Builder->GetInsertBlock()->getParent();
+    EmitLocation(node);
+
+    // A step only known at runtime is checked there, a zero step would never reach the end
+    if (constStep == nullptr) {
+        auto bZeroStep = llvm::BasicBlock::Create(*TheContext->getContext(), "for.zerostep", parentFct);
+        auto bStep = llvm::BasicBlock::Create(*TheContext->getContext(), "for.step", parentFct);
+        Builder->CreateCondBr(Builder->CreateICmpEQ(stepVal, ConstantInt::get(stepVal->getType(), 0)), bZeroStep, bStep);
+        Builder->SetInsertPoint(bZeroStep);
+        genRuntimeError("Range step cannot be zero");
+        Builder->SetInsertPoint(bStep);
+    }
+
+    if (node->isParallel()) {
+        genParallelFor(node, type, startVal, endVal, stepVal);
+        return;
+    }
+
+    Scope = Scope->createChildBlock("for");
+
+    // Constant steps know their direction, others pick it at runtime
+    llvm::Value *ascending = constStep != nullptr ? Builder->getInt1(!constStep->isNegative()) : Builder->CreateICmpSGT(stepVal, ConstantInt::get(stepVal->getType(), 0));
+    auto inRange = [&](llvm::Value *val) -> llvm::Value * {
+        auto up = node->isInclusive() ? Builder->CreateICmpSLE(val, endVal) : Builder->CreateICmpSLT(val, endVal);
+        auto down = node->isInclusive() ? Builder->CreateICmpSGE(val, endVal) : Builder->CreateICmpSGT(val, endVal);
+        return Builder->CreateSelect(ascending, up, down);
+    };
+
+    // The iterations left after the first are counted up front, in unsigned arithmetic, so ranges ending within a
+    // step of the limits of the type don't step past them
+    auto span = Builder->CreateSelect(ascending, Builder->CreateSub(endVal, startVal), Builder->CreateSub(startVal, endVal));
+    if (!node->isInclusive())
+        span = Builder->CreateSub(span, ConstantInt::get(span->getType(), 1));
+    auto stride = Builder->CreateSelect(ascending, stepVal, Builder->CreateNeg(stepVal));
+    auto iterations = Builder->CreateUDiv(span, stride, "for.iterations");
+
+    // Create blocks, the loop is rotated so the only exit test is in the latch
+    llvm::BasicBlock *bLoop = llvm::BasicBlock::Create(*TheContext->getContext(), "for");
+    llvm::BasicBlock *bLatch = llvm::BasicBlock::Create(*TheContext->getContext(), "for.latch");
+    llvm::BasicBlock *bEnd = llvm::BasicBlock::Create(*TheContext->getContext(), "for.end");
+
+    breakBlocks.push(bEnd);
+    continueBlocks.push(bLatch);
+    loopRegionDepths.push(regionDepth);
+
+    // Skip empty ranges
+    auto bPreheader = Builder->GetInsertBlock();
+    Builder->CreateCondBr(inRange(startVal), bLoop, bEnd);
+
+    // Fill loop body block, the induction variable is an immutable SSA value
+    bLoop->insertInto(parentFct);
+    Builder->SetInsertPoint(bLoop);
+    auto name = node->getIdentifier()->getValue();
+    auto induction = Builder->CreatePHI(type->getLLVMType(), 2, name);
+    induction->addIncoming(startVal, bPreheader);
+    auto remaining = Builder->CreatePHI(iterations->getType(), 2, "for.remaining");
+    remaining->addIncoming(iterations, bPreheader);
+
+    auto symbol = new Value(name, type, INITIALIZED);
+    symbol->setLLVMValue(induction);
+    symbol->setMutable(false);
+    Scope->insertSymbol(symbol);
+
+    node->getBlock()->accept(*this);
+
+    if (!isBreak)
+        Builder->CreateBr(bLatch);
+    else
+        isBreak = false;
+
+    // Fill latch block, the next value is only used while iterations are left, so it never wraps
+    bLatch->insertInto(parentFct);
+    Builder->SetInsertPoint(bLatch);
+    EmitLocation(node);
+    auto next = Builder->CreateNSWAdd(induction, stepVal, name + ".next");
+    induction->addIncoming(next, bLatch);
+    remaining->addIncoming(Builder->CreateSub(remaining, ConstantInt::get(remaining->getType(), 1)), bLatch);
+    Builder->CreateCondBr(Builder->CreateICmpEQ(remaining, ConstantInt::get(remaining->getType(), 0)), bEnd, bLoop);
+
+    // Fill loop end block
+    bEnd->insertInto(parentFct);
+    Builder->SetInsertPoint(bEnd);
+
+    Scope = Scope->getParent();
+    breakBlocks.pop();
+    continueBlocks.pop();
+    loopRegionDepths.pop();
+}
+
+void Codegen::genChannelFor(const For *node) {
+    node->getRangeStart()->accept(*this);
+    auto channel = result;
+    if (!channel->getType()->is(TY_CHANNEL))
+        throw CodegenError(node->getRangeStart()->getSpan(), "Expected a range or a channel to loop over, found {}", channel->getType()->toString());
+
+    Scope = Scope->createChildBlock("for");
+
+    llvm::Function *parentFct = Builder->GetInsertBlock()->getParent();
+    auto elementType = channel->getType()->getElementType();
+    auto name = node->getIdentifier()->getValue();
+    auto slot = CreateEntryBlockAlloca(elementType->getLLVMType(), name);
+
+    // Create blocks, every iteration starts by receiving the next value
+    llvm::BasicBlock *bRecv = llvm::BasicBlock::Create(*TheContext->getContext(), "for.recv");
+    llvm::BasicBlock *bLoop = llvm::BasicBlock::Create(*TheContext->getContext(), "for");
+    llvm::BasicBlock *bEnd = llvm::BasicBlock::Create(*TheContext->getContext(), "for.end");
+
+    breakBlocks.push(bEnd);
+    continueBlocks.push(bRecv);
+    loopRegionDepths.push(regionDepth);
+
+    Builder->CreateBr(bRecv);
+
+    // Fill receive block, the loop ends once the channel is closed and empty
+    bRecv->insertInto(parentFct);
+    Builder->SetInsertPoint(bRecv);
+    EmitLocation(node);
+    auto received = Builder->CreateCall(getChannelFunction("lesma_channel_recv", Builder->getInt1Ty(), {Builder->getPtrTy(), Builder->getPtrTy()}), {channel->getLLVMValue(), slot});
+    Builder->CreateCondBr(received, bLoop, bEnd);
+
+    // Fill loop body block, the variable is the received value and can't be assigned
+    bLoop->insertInto(parentFct);
+    Builder->SetInsertPoint(bLoop);
+    auto symbol = new Value(name, elementType, INITIALIZED);
+    symbol->setLLVMValue(slot);
+    symbol->setMutable(false);
+    Scope->insertSymbol(symbol);
+
+    node->getBlock()->accept(*this);
+
+    if (!isBreak)
+        Builder->CreateBr(bRecv);
+    else
+        isBreak = false;
+
+    // Fill loop end block
+    bEnd->insertInto(parentFct);
+    Builder->SetInsertPoint(bEnd);
+
+    Scope = Scope->getParent();
+    breakBlocks.pop();
+    continueBlocks.pop();
+    loopRegionDepths.pop();
+}
+
+void Codegen::visit(const Select *node) {
+    auto cases = node->getCases();
+    auto *ptrTy = Builder->getPtrTy();
+    auto count = static_cast<uint64_t>(cases.size());
+
+    // The channels are evaluated once, in order, the received value goes to a buffer large enough for any of them
+    auto channelsType = ArrayType::get(ptrTy, count);
+    auto channels = CreateEntryBlockAlloca(channelsType, "select.channels");
+    std::vector<lesma::Type *> elementTypes;
+    uint64_t size = 1;
+    for (uint64_t i = 0; i < count; i++) {
+        cases[i]->channel->accept(*this);
+        if (!result->getType()->is(TY_CHANNEL))
+            throw CodegenError(cases[i]->channel->getSpan(), "Can only select on channels, found {}", result->getType()->toString());
+
+        elementTypes.push_back(result->getType()->getElementType());
+        size = std::max(size, TheModule->getDataLayout().getTypeAllocSize(elementTypes.back()->getLLVMType()).getFixedValue());
+        Builder->CreateStore(result->getLLVMValue(), Builder->CreateConstInBoundsGEP2_64(channelsType, channels, 0, i));
+    }
+    auto value = CreateEntryBlockAlloca(ArrayType::get(Builder->getInt8Ty(), size), "select.value");
+    value->setAlignment(Align(8));
+
+    EmitLocation(node);
+    auto select = getRuntimeFunction("lesma_channel_select", Builder->getInt64Ty(), {ptrTy, Builder->getInt64Ty(), ptrTy});
+    auto index = Builder->CreateCall(select, {channels, Builder->getInt64(count), value}, "selected");
+
+    llvm::Function *parentFct = Builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock *bEnd = llvm::BasicBlock::Create(*TheContext->getContext(), "select.end");
+    llvm::BasicBlock *bElse = bEnd;
+    if (node->getElseBlock().has_value())
+        bElse = llvm::BasicBlock::Create(*TheContext->getContext(), "select.else");
+
+    // -1 means every channel is closed and empty
+    auto switchInst = Builder->CreateSwitch(index, bElse, static_cast<unsigned int>(count));
+    for (uint64_t i = 0; i < count; i++) {
+        auto bCase = llvm::BasicBlock::Create(*TheContext->getContext(), "select.case", parentFct);
+        switchInst->addCase(Builder->getInt64(i), bCase);
+        Builder->SetInsertPoint(bCase);
+
+        Scope = Scope->createChildBlock("select");
+        auto symbol = new Value(cases[i]->var->getValue(), elementTypes[i], INITIALIZED);
+        symbol->setLLVMValue(value);
+        symbol->setMutable(false);
+        Scope->insertSymbol(symbol);
+
+        cases[i]->block->accept(*this);
+        if (Builder->GetInsertBlock()->getTerminator() == nullptr)
+            Builder->CreateBr(bEnd);
+        isBreak = false;
+        Scope = Scope->getParent();
+    }
+
+    if (node->getElseBlock().has_value()) {
+        bElse->insertInto(parentFct);
+        Builder->SetInsertPoint(bElse);
+
+        Scope = Scope->createChildBlock("select");
+        node->getElseBlock().value()->accept(*this);
+        if (Builder->GetInsertBlock()->getTerminator() == nullptr)
+            Builder->CreateBr(bEnd);
+        isBreak = false;
+        Scope = Scope->getParent();
+    }
+
+    bEnd->insertInto(parentFct);
+    Builder->SetInsertPoint(bEnd);
+}
+
+namespace {
+    // Collects the identifiers a parallel loop body uses, the local variables among them are passed to the outlined body
+    class ReferencedNames : public RecursiveASTVisitor {
+    public:
+        std::set<std::string> names;
+
+        void visitNode(const char * /*kind*/, const AST *node) override {
+            auto literal = dynamic_cast<const Literal *>(node);
+            if (literal != nullptr && literal->getType() == TokenType::IDENTIFIER)
+                names.insert(literal->getValue());
+        }
+    };
+}// namespace
+
+void Codegen::genParallelFor(const For *node, lesma::Type *type, llvm::Value *startVal, llvm::Value *endVal, llvm::Value *stepVal) {
+    auto *context = TheContext->getContext();
+    auto *i64 = Builder->getInt64Ty();
+    llvm::Function *parentFct = Builder->GetInsertBlock()->getParent();
+
+    // Iterations are numbered from zero, the outlined body turns their number back into the loop variable
+    EmitLocation(node);
+    auto start = Builder->CreateSExtOrTrunc(startVal, i64);
+    auto end = Builder->CreateSExtOrTrunc(endVal, i64);
+    auto step = Builder->CreateSExtOrTrunc(stepVal, i64);
+    auto ascending = Builder->CreateICmpSGT(step, Builder->getInt64(0));
+    auto up = node->isInclusive() ? Builder->CreateICmpSLE(start, end) : Builder->CreateICmpSLT(start, end);
+    auto down = node->isInclusive() ? Builder->CreateICmpSGE(start, end) : Builder->CreateICmpSGT(start, end);
+    auto empty = Builder->CreateNot(Builder->CreateSelect(ascending, up, down));
+
+    // The distance between the bounds can be larger than the largest int, so it's unsigned, and so is the count
+    auto span = Builder->CreateSelect(ascending, Builder->CreateSub(end, start), Builder->CreateSub(start, end));
+    auto stride = Builder->CreateSelect(ascending, step, Builder->CreateNeg(step));
+    if (!node->isInclusive())
+        span = Builder->CreateSub(span, Builder->getInt64(1));
+    auto last = Builder->CreateUDiv(span, stride);
+
+    // The runtime counts iterations in an int64_t, only ranges of more than 2^63 iterations don't fit
+    auto bHuge = llvm::BasicBlock::Create(*context, "parallel.huge", parentFct);
+    auto bCount = llvm::BasicBlock::Create(*context, "parallel.count", parentFct);
+    Builder->CreateCondBr(Builder->CreateAnd(Builder->CreateNot(empty), Builder->CreateICmpUGE(last, Builder->getInt64(INT64_MAX))), bHuge, bCount);
+    Builder->SetInsertPoint(bHuge);
+    genRuntimeError("Parallel range has too many iterations");
+    Builder->SetInsertPoint(bCount);
+    auto count = Builder->CreateSelect(empty, Builder->getInt64(0), Builder->CreateAdd(last, Builder->getInt64(1)), "count");
+
+    // Without a chunk size every thread gets an equal share of the range
+    llvm::Value *chunk = Builder->getInt64(0);
+    if (node->getChunk().has_value()) {
+        node->getChunk().value()->accept(*this);
+        if (!result->getType()->is(TY_INT))
+            throw CodegenError(node->getChunk().value()->getSpan(), "Chunk size must be an integer");
+        chunk = Builder->CreateSExtOrTrunc(result->getLLVMValue(), i64);
+    }
+
+    std::vector<lesma::Value *> reduced;
+    std::vector<llvm::Type *> partialFields;
+    for (auto reduction: node->getReductions()) {
+        auto name = reduction->var->getValue();
+        auto symbol = Scope->lookup(name);
+        if (symbol == nullptr)
+            throw CodegenError(reduction->var->getSpan(), "Unknown variable name {}", name);
+        if (!symbol->getMutability() || !symbol->getType()->isOneOf({TY_INT, TY_FLOAT}) || symbol->getLLVMValue() == nullptr || !symbol->getLLVMValue()->getType()->isPointerTy())
+            throw CodegenError(reduction->var->getSpan(), "Only numeric variables declared with var can be reduced, found {}", name);
+        if (std::find(reduced.begin(), reduced.end(), symbol) != reduced.end())
+            throw CodegenError(reduction->var->getSpan(), "Variable {} is reduced more than once", name);
+
+        reduced.push_back(symbol);
+        partialFields.push_back(symbol->getType()->getLLVMType());
+    }
+
+    // Local variables of this function are captured, variables by the pointer to their stack slot, SSA values as is
+    ReferencedNames referenced;
+    referenced.walk(node->getBlock());
+    std::vector<lesma::Value *> captured;
+    for (const auto &name: referenced.names) {
+        auto symbol = Scope->lookup(name);
+        if (name == node->getIdentifier()->getValue() || symbol == nullptr || std::find(reduced.begin(), reduced.end(), symbol) != reduced.end())
+            continue;
+
+        auto inst = llvm::dyn_cast_or_null<llvm::Instruction>(symbol->getLLVMValue());
+        auto arg = llvm::dyn_cast_or_null<llvm::Argument>(symbol->getLLVMValue());
+        if ((inst != nullptr && inst->getFunction() == parentFct) || (arg != nullptr && arg->getParent() == parentFct))
+            captured.push_back(symbol);
+    }
+
+    std::vector<llvm::Type *> envFields = {type->getLLVMType(), type->getLLVMType(), Builder->getPtrTy()};
+    for (auto symbol: captured)
+        envFields.push_back(symbol->getLLVMValue()->getType());
+    auto envType = StructType::get(*context, envFields);
+    auto partialType = StructType::get(*context, partialFields);
+    auto body = genParallelBody(node, type, envType, partialType, captured, reduced);
+
+    // Every thread of the pool gets a slot with the partial results of the reductions, starting from their identity
+    llvm::Value *partials = llvm::ConstantPointerNull::get(Builder->getPtrTy());
+    llvm::Value *slots = nullptr;
+    llvm::Value *stack = nullptr;
+    if (!reduced.empty()) {
+        std::vector<llvm::Constant *> identities;
+        for (unsigned int i = 0; i < reduced.size(); i++)
+            identities.push_back(genReductionIdentity(node->getReductions()[i]->op, partialFields[i]));
+        auto identity = new GlobalVariable(*TheModule, partialType, true, GlobalValue::PrivateLinkage, ConstantStruct::get(partialType, identities), "parallel.identity");
+        auto size = TheModule->getDataLayout().getTypeAllocSize(partialType);
+
+        slots = Builder->CreateCall(getRuntimeFunction("lesma_parallel_slots", i64, {}), {}, "slots");
+        stack = Builder->CreateCall(Intrinsic::getDeclaration(TheModule.get(), Intrinsic::stacksave));
+        partials = Builder->CreateAlloca(partialType, slots, "partials");
+        Builder->CreateCall(getRuntimeFunction("lesma_parallel_fill", Builder->getVoidTy(), {Builder->getPtrTy(), Builder->getPtrTy(), i64}),
+                            {partials, identity, Builder->getInt64(size)});
+    }
+
+    auto env = CreateEntryBlockAlloca(envType, "parallel.env");
+    Builder->CreateStore(startVal, Builder->CreateStructGEP(envType, env, 0));
+    Builder->CreateStore(stepVal, Builder->CreateStructGEP(envType, env, 1));
+    Builder->CreateStore(partials, Builder->CreateStructGEP(envType, env, 2));
+    for (unsigned int i = 0; i < captured.size(); i++)
+        Builder->CreateStore(captured[i]->getLLVMValue(), Builder->CreateStructGEP(envType, env, 3 + i));
+
+    Builder->CreateCall(getRuntimeFunction("lesma_parallel_for", Builder->getVoidTy(), {Builder->getPtrTy(), Builder->getPtrTy(), i64, i64}),
+                        {body, env, count, chunk});
+
+    if (reduced.empty())
+        return;
+
+    // Partial results are combined in slot order, so equal shares give the same result every time
+    auto bPreheader = Builder->GetInsertBlock();
+    auto bSlot = llvm::BasicBlock::Create(*context, "slot", parentFct);
+    auto bDone = llvm::BasicBlock::Create(*context, "slot.end", parentFct);
+    std::vector<llvm::Value *> initial;
+    for (unsigned int i = 0; i < reduced.size(); i++)
+        initial.push_back(Builder->CreateLoad(partialFields[i], reduced[i]->getLLVMValue()));
+    Builder->CreateBr(bSlot);
+
+    Builder->SetInsertPoint(bSlot);
+    auto slot = Builder->CreatePHI(i64, 2, "slot");
+    slot->addIncoming(Builder->getInt64(0), bPreheader);
+    std::vector<llvm::PHINode *> current;
+    for (unsigned int i = 0; i < reduced.size(); i++) {
+        current.push_back(Builder->CreatePHI(partialFields[i], 2, reduced[i]->getName()));
+        current[i]->addIncoming(initial[i], bPreheader);
+    }
+
+    auto partial = Builder->CreateGEP(partialType, partials, slot);
+    std::vector<llvm::Value *> combined;
+    for (unsigned int i = 0; i < reduced.size(); i++) {
+        auto value = Builder->CreateLoad(partialFields[i], Builder->CreateStructGEP(partialType, partial, i));
+        combined.push_back(genReduction(node->getReductions()[i]->op, current[i], value));
+        current[i]->addIncoming(combined.back(), bSlot);
+    }
+    auto nextSlot = Builder->CreateNUWAdd(slot, Builder->getInt64(1));
+    slot->addIncoming(nextSlot, bSlot);
+    Builder->CreateCondBr(Builder->CreateICmpULT(nextSlot, slots), bSlot, bDone);
+
+    Builder->SetInsertPoint(bDone);
+    for (unsigned int i = 0; i < reduced.size(); i++)
+        Builder->CreateStore(combined[i], reduced[i]->getLLVMValue());
+    Builder->CreateCall(Intrinsic::getDeclaration(TheModule.get(), Intrinsic::stackrestore), {stack});
+}
+
+llvm::Function *Codegen::genParallelBody(const For *node, lesma::Type *type, llvm::StructType *envType, llvm::StructType *partialType,
+                                          const std::vector<lesma::Value *> &captured, const std::vector<lesma::Value *> &reduced) {
+    auto *context = TheContext->getContext();
+    auto *i64 = Builder->getInt64Ty();
+    auto parentFct = Builder->GetInsertBlock()->getParent();
+
+    // Runs iterations [begin, end) on some thread, see lesma_loop_function
+    auto funcType = FunctionType::get(Builder->getVoidTy(), {Builder->getPtrTy(), i64, i64, i64}, false);
+    auto F = Function::Create(funcType, Function::PrivateLinkage, parentFct->getName() + ".parallel", *TheModule);
+    F->addFnAttr(Attribute::NoUnwind);
+    auto env = F->getArg(0);
+    auto begin = F->getArg(1);
+    auto end = F->getArg(2);
+    auto slot = F->getArg(3);
+    env->setName("env");
+    begin->setName("begin");
+    end->setName("end");
+    slot->setName("slot");
+
+    IRBuilderBase::InsertPointGuard guard(*Builder);
+    Builder->SetCurrentDebugLocation(DebugLoc());
+    auto bEntry = llvm::BasicBlock::Create(*context, "entry", F);
+    Builder->SetInsertPoint(bEntry);
+    CreateSubprogram(F, node);
+    EmitLocation(node);
+
+    // The body sees the captured variables under their names, and its own copy of the reduced ones
+    Scope = Scope->createChildBlock("parallel for");
+    auto start = Builder->CreateLoad(type->getLLVMType(), Builder->CreateStructGEP(envType, env, 0), "start");
+    auto step = Builder->CreateLoad(type->getLLVMType(), Builder->CreateStructGEP(envType, env, 1), "step");
+    auto partials = Builder->CreateLoad(Builder->getPtrTy(), Builder->CreateStructGEP(envType, env, 2), "partials");
+    for (unsigned int i = 0; i < captured.size(); i++) {
+        auto value = Builder->CreateLoad(envType->getElementType(3 + i), Builder->CreateStructGEP(envType, env, 3 + i), captured[i]->getName());
+        auto symbol = new Value(captured[i]->getName(), captured[i]->getType(), value);
+        symbol->setMutable(captured[i]->getMutability());
+        Scope->insertSymbol(symbol);
+    }
+
+    std::vector<llvm::AllocaInst *> privates;
+    for (unsigned int i = 0; i < reduced.size(); i++) {
+        auto ptr = CreateEntryBlockAlloca(partialType->getElementType(i), reduced[i]->getName());
+        Builder->CreateStore(genReductionIdentity(node->getReductions()[i]->op, partialType->getElementType(i)), ptr);
+        auto symbol = new Value(reduced[i]->getName(), reduced[i]->getType(), ptr);
+        symbol->setMutable(true);
+        Scope->insertSymbol(symbol);
+        privates.push_back(ptr);
+    }
+
+    llvm::BasicBlock *bLoop = llvm::BasicBlock::Create(*context, "for", F);
+    llvm::BasicBlock *bLatch = llvm::BasicBlock::Create(*context, "for.latch");
+    llvm::BasicBlock *bEnd = llvm::BasicBlock::Create(*context, "for.end");
+    Builder->CreateBr(bLoop);
+
+    // The runtime never hands out empty ranges, so the loop is entered right away
+    Builder->SetInsertPoint(bLoop);
+    auto iteration = Builder->CreatePHI(i64, 2, "iteration");
+    iteration->addIncoming(begin, bEntry);
+    auto name = node->getIdentifier()->getValue();
+    // Wraps on the way to values near the limits of the type, like start + iteration * step in unsigned arithmetic
+    auto induction = Builder->CreateAdd(start, Builder->CreateMul(Builder->CreateSExtOrTrunc(iteration, type->getLLVMType()), step), name);
+
+    auto symbol = new Value(name, type, INITIALIZED);
+    symbol->setLLVMValue(induction);
+    symbol->setMutable(false);
+    Scope->insertSymbol(symbol);
+
+    // Iterations can be skipped with continue, but not the rest of the loop since other threads are running it
+    auto outerFunction = currentFunction;
+    auto outerCoroutine = coroutine;
+    auto outerRegionDepth = regionDepth;
+    currentFunction = nullptr;
+    coroutine = {};
+    regionDepth = 0;
+    breakBlocks.push(nullptr);
+    continueBlocks.push(bLatch);
+    loopRegionDepths.push(0);
+    deferStack.emplace();
+
+    node->getBlock()->accept(*this);
+
+    if (!isBreak)
+        Builder->CreateBr(bLatch);
+    else
+        isBreak = false;
+
+    if (!deferStack.top().empty())
+        throw CodegenError(node->getSpan(), "Cannot defer inside a parallel loop");
+
+    deferStack.pop();
+    breakBlocks.pop();
+    continueBlocks.pop();
+    loopRegionDepths.pop();
+    currentFunction = outerFunction;
+    coroutine = outerCoroutine;
+    regionDepth = outerRegionDepth;
+
+    bLatch->insertInto(F);
+    Builder->SetInsertPoint(bLatch);
+    EmitLocation(node);
+    auto next = Builder->CreateNSWAdd(iteration, Builder->getInt64(1), "iteration.next");
+    iteration->addIncoming(next, bLatch);
+    Builder->CreateCondBr(Builder->CreateICmpSLT(next, end), bLoop, bEnd);
+
+    // Adds what this chunk found to the partial results of the slot
+    bEnd->insertInto(F);
+    Builder->SetInsertPoint(bEnd);
+    auto partial = Builder->CreateGEP(partialType, partials, slot);
+    for (unsigned int i = 0; i < reduced.size(); i++) {
+        auto fieldType = partialType->getElementType(i);
+        auto ptr = Builder->CreateStructGEP(partialType, partial, i);
+        auto value = genReduction(node->getReductions()[i]->op, Builder->CreateLoad(fieldType, ptr), Builder->CreateLoad(fieldType, privates[i]));
+        Builder->CreateStore(value, ptr);
+    }
+    Builder->CreateRetVoid();
+
+    Scope = Scope->getParent();
+    return F;
+}
+
+llvm::Constant *Codegen::genReductionIdentity(const std::string &op, llvm::Type *type) {
+    if (type->isFloatingPointTy()) {
+        if (op == "+")
+            return ConstantFP::get(type, 0.0);
+        return ConstantFP::getInfinity(type, op == "max");
+    }
+
+    auto bits = type->getIntegerBitWidth();
+    if (op == "+")
+        return ConstantInt::get(type, 0);
+    return ConstantInt::get(type, op == "min" ? APInt::getSignedMaxValue(bits) : APInt::getSignedMinValue(bits));
+}
+
+llvm::Value *Codegen::genReduction(const std::string &op, llvm::Value *left, llvm::Value *right) {
+    if (left->getType()->isFloatingPointTy()) {
+        if (op == "+")
+            return Builder->CreateFAdd(left, right);
+        return op == "min" ? Builder->CreateMinNum(left, right) : Builder->CreateMaxNum(left, right);
+    }
+
+    if (op == "+")
+        return Builder->CreateAdd(left, right);
+    auto cmp = op == "min" ? Builder->CreateICmpSLT(left, right) : Builder->CreateICmpSGT(left, right);
+    return Builder->CreateSelect(cmp, left, right);
 }
 
 void Codegen::visit(const FuncDecl *node) {
@@ -719,8 +1594,22 @@ void Codegen::visit(const FuncDecl *node) {
 
     node->getReturnType()->accept(*this);
 
+    // Same for returning a class, instances are returned by pointer
+    if (result->getType()->is(TY_CLASS)) {
+        result = new Value("", new Type(TY_PTR, Builder->getPtrTy(), result->getType()));
+    }
+
+    // Calling an async function returns its coroutine, once it first suspends
+    if (node->isAsync())
+        result = new Value("", new Type(TY_FUTURE, Builder->getPtrTy(), result->getType()));
+
     llvm::FunctionType *funcType = FunctionType::get(result->getType()->getLLVMType(), paramLLVMTypes, node->getVarArgs());
     Function *F = Function::Create(funcType, linkage, mangledName, *TheModule);
+    if (node->isAsync())
+        F->addFnAttr(Attribute::PresplitCoroutine);
+    // Exported functions can be called from C and C++, which expect booleans to fill the whole register
+    if (shouldExport && funcType->getReturnType()->isIntegerTy(1))
+        F->addRetAttr(Attribute::ZExt);
 
     auto func_symbol = new Value(node->getName(), new Type(BaseType::TY_FUNCTION, funcType, std::move(fields)), F);
     func_symbol->getType()->setReturnType(result->getType());
@@ -772,13 +1661,23 @@ void Codegen::visit(const ExternFuncDecl *node) {
     node->getReturnType()->accept(*this);
     auto ret_type = result->getType();
 
+    // Async extern functions are given the awaiting coroutine to queue once they're done, and where to put the result
+    auto llvmReturnType = ret_type->getLLVMType();
+    if (node->isAsync()) {
+        if (!ret_type->is(TY_VOID))
+            paramLLVMTypes.insert(paramLLVMTypes.begin(), Builder->getPtrTy());
+        paramLLVMTypes.insert(paramLLVMTypes.begin(), Builder->getPtrTy());
+        llvmReturnType = Builder->getVoidTy();
+        ret_type = new Type(TY_FUTURE, Builder->getPtrTy(), ret_type);
+    }
+
     Function *F;
     if (TheModule->getFunction(node->getName()) != nullptr && Scope->lookupFunction(node->getName(), paramTypes) != nullptr)
         return;
     else if (TheModule->getFunction(node->getName()) != nullptr) {
         F = TheModule->getFunction(node->getName());
     } else {
-        FunctionType *FT = FunctionType::get(ret_type->getLLVMType(), paramLLVMTypes, node->getVarArgs());
+        FunctionType *FT = FunctionType::get(llvmReturnType, paramLLVMTypes, node->getVarArgs());
         F = llvm::cast<Function>(TheModule->getOrInsertFunction(node->getName(), FT).getCallee());
         if (node->isExported()) {
             F->setLinkage(llvm::GlobalValue::ExternalLinkage);
@@ -788,6 +1687,8 @@ void Codegen::visit(const ExternFuncDecl *node) {
     auto func_symbol = new Value(node->getName(), new Type(BaseType::TY_FUNCTION, F->getFunctionType(), fields), F);
     func_symbol->getType()->setReturnType(ret_type);
     func_symbol->setExported(node->isExported());
+    func_symbol->setExtern(true);
+    func_symbol->setRuntime(isStd);
     func_symbol->setMangledName(node->getName());
     Scope->insertSymbol(func_symbol);
 }
@@ -816,7 +1717,8 @@ void Codegen::visit(const Assignment *node) {
     isAssignment = false;
 
     node->getRightHandSide()->accept(*this);
-    auto value = Cast(node->getSpan(), result, isPtr ? lhs->getType()->getElementType() : lhs->getType());
+    auto rhs = result;
+    auto value = Cast(node->getSpan(), rhs, isPtr ? lhs->getType()->getElementType() : lhs->getType());
     llvm::Value *var_val;
 
     switch (node->getOperator()) {
@@ -826,10 +1728,10 @@ void Codegen::visit(const Assignment *node) {
         case TokenType::PLUS_EQUAL:
             var_val = Builder->CreateLoad(lhs->getType()->getLLVMType(), lhs->getLLVMValue());
             if (lhs->getType()->is(TY_FLOAT)) {
-                auto new_val = Builder->CreateFAdd(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateFAdd(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else if (lhs->getType()->is(TY_INT)) {
-                auto new_val = Builder->CreateAdd(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateAdd(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else
                 throw CodegenError(node->getSpan(), "Invalid operator: {}", NAMEOF_ENUM(node->getOperator()));
@@ -837,10 +1739,10 @@ void Codegen::visit(const Assignment *node) {
         case TokenType::MINUS_EQUAL:
             var_val = Builder->CreateLoad(lhs->getType()->getLLVMType(), lhs->getLLVMValue());
             if (lhs->getType()->is(TY_FLOAT)) {
-                auto new_val = Builder->CreateFSub(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateFSub(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else if (lhs->getType()->is(TY_INT)) {
-                auto new_val = Builder->CreateSub(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateSub(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else
                 throw CodegenError(node->getSpan(), "Invalid operator: {}", NAMEOF_ENUM(node->getOperator()));
@@ -848,10 +1750,10 @@ void Codegen::visit(const Assignment *node) {
         case TokenType::SLASH_EQUAL:
             var_val = Builder->CreateLoad(lhs->getType()->getLLVMType(), lhs->getLLVMValue());
             if (lhs->getType()->is(TY_FLOAT)) {
-                auto new_val = Builder->CreateFDiv(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateFDiv(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else if (lhs->getType()->is(TY_INT)) {
-                auto new_val = Builder->CreateSDiv(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateSDiv(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else
                 throw CodegenError(node->getSpan(), "Invalid operator: {}", NAMEOF_ENUM(node->getOperator()));
@@ -859,10 +1761,10 @@ void Codegen::visit(const Assignment *node) {
         case TokenType::STAR_EQUAL:
             var_val = Builder->CreateLoad(lhs->getType()->getLLVMType(), lhs->getLLVMValue());
             if (lhs->getType()->is(TY_FLOAT)) {
-                auto new_val = Builder->CreateFMul(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateFMul(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else if (lhs->getType()->is(TY_INT)) {
-                auto new_val = Builder->CreateMul(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateMul(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else
                 throw CodegenError(node->getSpan(), "Invalid operator: {}", NAMEOF_ENUM(node->getOperator()));
@@ -870,17 +1772,24 @@ void Codegen::visit(const Assignment *node) {
         case TokenType::MOD_EQUAL:
             var_val = Builder->CreateLoad(lhs->getType()->getLLVMType(), lhs->getLLVMValue());
             if (lhs->getType()->is(TY_FLOAT)) {
-                auto new_val = Builder->CreateFRem(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateFRem(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else if (lhs->getType()->is(TY_INT)) {
-                auto new_val = Builder->CreateSRem(value->getLLVMValue(), var_val);
+                auto new_val = Builder->CreateSRem(var_val, value->getLLVMValue());
                 Builder->CreateStore(new_val, lhs->getLLVMValue());
             } else {
                 throw CodegenError(node->getSpan(), "Invalid operator: {}", NAMEOF_ENUM(node->getOperator()));
             }
             break;
         case TokenType::POWER_EQUAL:
-            throw CodegenError(node->getSpan(), "Power operator not implemented yet.");
+            var_val = Builder->CreateLoad(lhs->getType()->getLLVMType(), lhs->getLLVMValue());
+            if (lhs->getType()->isOneOf({TY_INT, TY_FLOAT}) && rhs->getType()->isOneOf({TY_INT, TY_FLOAT})) {
+                // The exponent keeps its own type, so x ^= 2 stays a multiplication even for floats
+                auto new_val = Cast(node->getSpan(), genPower(new Value("", lhs->getType(), var_val), rhs), lhs->getType());
+                Builder->CreateStore(new_val->getLLVMValue(), lhs->getLLVMValue());
+            } else
+                throw CodegenError(node->getSpan(), "Invalid operator: {}", NAMEOF_ENUM(node->getOperator()));
+            break;
         default:
             throw CodegenError(node->getSpan(), "Invalid operator: {}", NAMEOF_ENUM(node->getOperator()));
     }
@@ -891,9 +1800,11 @@ void Codegen::visit(const Break *node) {
         throw CodegenError(node->getSpan(), "Cannot break without being in a loop");
 
     auto block = breakBlocks.top();
-    breakBlocks.pop();
+    if (block == nullptr)
+        throw CodegenError(node->getSpan(), "Cannot break out of a parallel loop");
     isBreak = true;
 
+    exitRegions(regionDepth - loopRegionDepths.top());
     Builder->CreateBr(block);
 }
 
@@ -902,47 +1813,150 @@ void Codegen::visit(const Continue *node) {
         throw CodegenError(node->getSpan(), "Cannot continue without being in a loop");
 
     auto block = continueBlocks.top();
-    continueBlocks.pop();
     isBreak = true;
 
+    exitRegions(regionDepth - loopRegionDepths.top());
     Builder->CreateBr(block);
 }
 
 void Codegen::visit(const Return *node) {
-    // Check if it's top-level
-    if (Builder->GetInsertBlock()->getParent() == TopLevelFunc)
-        throw CodegenError(node->getSpan(), "Return statements are not allowed at top-level");
+    // The main program can end early with an exit code, imported modules have nobody to return it to
+    if (Builder->GetInsertBlock()->getParent() == TopLevelFunc) {
+        if (!isMain || node->getValue() == nullptr)
+            throw CodegenError(node->getSpan(), "Return statements at top-level are only allowed in the main program, with an exit code");
+
+        genDeferred();
+        EmitLocation(node);
+        node->getValue()->accept(*this);
+        if (!result->getType()->is(TY_INT))
+            throw CodegenError(node->getSpan(), "Exit code must be an int, actual {}", result->getType()->toString());
+
+        exitRegions(regionDepth);
+        Builder->CreateRet(result->getLLVMValue());
+        return;
+    }
+    if (currentFunction == nullptr)
+        throw CodegenError(node->getSpan(), "Cannot return from a parallel loop");
 
     // Execute all deferred statements
-    for (auto inst: deferStack.top())
-        inst->accept(*this);
+    genDeferred();
+
+    EmitLocation(node);
 
     isReturn = true;
 
+    // Async functions return by storing the result in their promise and finishing the coroutine
+    auto expectedType = currentFunction->getType()->getReturnType();
+    if (coroutine.handle != nullptr)
+        expectedType = expectedType->getElementType();
+
     if (node->getValue() == nullptr) {
-        if (currentFunction->getType()->getReturnType()->is(TY_VOID)) {
-            Builder->CreateRetVoid();
+        if (expectedType->is(TY_VOID)) {
+            exitRegions(regionDepth);
+            if (coroutine.handle != nullptr)
+                Builder->CreateBr(coroutine.finalBlock);
+            else
+                Builder->CreateRetVoid();
         } else {
             throw CodegenError(node->getSpan(), "Return type does not match the function return type, expected {}, actual void",
-                               currentFunction->getType()->getReturnType()->toString());
+                               expectedType->toString());
         }
     } else {
         node->getValue()->accept(*this);
-        if (Builder->getCurrentFunctionReturnType() == result->getType()->getLLVMType()) {
+        // A constructed instance is returned through its pointer
+        auto returnType = result->getType()->is(TY_CLASS) ? Builder->getPtrTy() : result->getType()->getLLVMType();
+        auto expectedLLVMType = expectedType->is(TY_CLASS) ? Builder->getPtrTy() : expectedType->getLLVMType();
+        if (coroutine.handle != nullptr && expectedLLVMType == returnType) {
+            auto promiseType = cast<StructType>(coroutine.promise->getAllocatedType());
+            Builder->CreateStore(result->getLLVMValue(), Builder->CreateStructGEP(promiseType, coroutine.promise, 3));
+            exitRegions(regionDepth);
+            Builder->CreateBr(coroutine.finalBlock);
+        } else if (coroutine.handle == nullptr && Builder->getCurrentFunctionReturnType() == returnType) {
+            exitRegions(regionDepth);
             Builder->CreateRet(result->getLLVMValue());
         } else {
             throw CodegenError(node->getSpan(), "Return type does not match the function return type, expected {}, actual {}",
-                               currentFunction->getType()->getReturnType()->toString(), result->getType()->toString());
+                               expectedType->toString(), result->getType()->toString());
         }
     }
 }
 
 void Codegen::visit(const Defer *node) {
-    deferStack.top().push_back(node->getStatement());
+    // Nested blocks may be skipped, so it's recorded whether the statement was reached. The flag starts cleared
+    // where the function begins, after the frame of a coroutine.
+    llvm::AllocaInst *reached = nullptr;
+    if (lifetimeScopes.size() > 1) {
+        reached = CreateEntryBlockAlloca(Builder->getInt1Ty(), "defer.reached");
+        auto start = coroutine.handle != nullptr ? cast<Instruction>(coroutine.handle)->getNextNode() : reached->getNextNode();
+        IRBuilder<>(start).CreateStore(Builder->getFalse(), reached);
+        Builder->CreateStore(Builder->getTrue(), reached);
+    }
+    deferStack.top().push_back({node->getStatement(), Scope, reached});
+}
+
+// Runs the statements deferred in the current function, before it returns
+void Codegen::genDeferred() {
+    auto scope = Scope;
+    auto F = Builder->GetInsertBlock()->getParent();
+    for (const auto &deferred: deferStack.top()) {
+        Scope = deferred.scope;
+        EmitLocation(deferred.statement);
+        if (deferred.reached == nullptr) {
+            deferred.statement->accept(*this);
+            continue;
+        }
+
+        auto bRun = llvm::BasicBlock::Create(*TheContext->getContext(), "defer", F);
+        auto bNext = llvm::BasicBlock::Create(*TheContext->getContext(), "defer.next", F);
+        Builder->CreateCondBr(Builder->CreateLoad(Builder->getInt1Ty(), deferred.reached), bRun, bNext);
+        Builder->SetInsertPoint(bRun);
+        deferred.statement->accept(*this);
+        Builder->CreateBr(bNext);
+        Builder->SetInsertPoint(bNext);
+    }
+    Scope = scope;
+}
+
+void Codegen::visit(const Region *node) {
+    // Allocations of called functions are made in the region too, the runtime tracks the innermost one per thread
+    Builder->CreateCall(getRuntimeFunction("lesma_region_enter", Builder->getVoidTy(), {}));
+    regionDepth++;
+
+    node->getBlock()->accept(*this);
+
+    regionDepth--;
+    if (Builder->GetInsertBlock()->getTerminator() == nullptr)
+        exitRegions(1);
+}
+
+void Codegen::visit(const Delete *node) {
+    node->getValue()->accept(*this);
+
+    if (result->getType()->is(TY_CHANNEL)) {
+        Builder->CreateCall(getRuntimeFunction("lesma_channel_free", Builder->getVoidTy(), {Builder->getPtrTy()}), {result->getLLVMValue()});
+        return;
+    }
+
+    if (!result->getType()->isOneOf({TY_CLASS, TY_ATOMIC}) && !(result->getType()->is(TY_PTR) && result->getType()->getElementType()->is(TY_CLASS)))
+        throw CodegenError(node->getSpan(), "Only class instances, channels and atomics can be deleted, found {}", result->getType()->toString());
+
+    Builder->CreateCall(getFreeFunction(), {result->getLLVMValue()});
+}
+
+void Codegen::exitRegions(unsigned int count) {
+    for (unsigned int i = 0; i < count; i++)
+        Builder->CreateCall(getRuntimeFunction("lesma_region_exit", Builder->getVoidTy(), {}));
 }
 
 void Codegen::visit(const ExpressionStatement *node) {
+    result = nullptr;
     node->getExpression()->accept(*this);
+
+    // Calling an async function without keeping its future detaches the coroutine
+    auto dotOp = dynamic_cast<DotOp *>(node->getExpression());
+    bool call = dynamic_cast<FuncCall *>(node->getExpression()) != nullptr || (dotOp != nullptr && dynamic_cast<FuncCall *>(dotOp->getRight()) != nullptr);
+    if (call && result != nullptr && result->getType() != nullptr && result->getType()->is(TY_FUTURE))
+        genDetach(result);
 }
 
 void Codegen::visit(const Import *node) {
@@ -953,6 +1967,16 @@ void Codegen::visit(const Class *node) {
     std::vector<Field *> fields;
     std::vector<llvm::Type *> elementLLVMTypes;
 
+    // The class is declared before its fields, so they can refer to it
+    llvm::StructType *structType = llvm::StructType::create(*TheContext->getContext(), node->getIdentifier());
+
+    auto *type = new Type(TY_CLASS, structType);
+    auto *structSymbol = new Value(node->getIdentifier(), type);
+    structSymbol->setExported(node->isExported());
+
+    Scope->insertType(node->getIdentifier(), type);
+    Scope->insertSymbol(structSymbol);
+
     for (auto field: node->getFields()) {
         if (field->getType().has_value()) {
             field->getType().value()->accept(*this);
@@ -960,18 +1984,17 @@ void Codegen::visit(const Class *node) {
             field->getValue().value()->accept(*this);
         }
 
-        elementLLVMTypes.push_back(result->getType()->getLLVMType());
-        fields.push_back(new Field{field->getIdentifier()->getValue(), result->getType(), field->getValue().has_value() ? result : nullptr});
-    }
-
-    llvm::StructType *structType = llvm::StructType::create(*TheContext->getContext(), elementLLVMTypes, node->getIdentifier());
+        // Fields holding a class point to the instance, like class variables
+        auto fieldType = result->getType();
+        if (fieldType->is(TY_CLASS))
+            fieldType = new Type(TY_PTR, Builder->getPtrTy(), fieldType);
 
-    auto *type = new Type(TY_CLASS, structType, std::move(fields));
-    auto *structSymbol = new Value(node->getIdentifier(), type);
-    structSymbol->setExported(node->isExported());
+        elementLLVMTypes.push_back(fieldType->getLLVMType());
+        fields.push_back(new Field{field->getIdentifier()->getValue(), fieldType, field->getValue().has_value() ? result : nullptr});
+    }
 
-    Scope->insertType(node->getIdentifier(), type);
-    Scope->insertSymbol(structSymbol);
+    structType->setBody(elementLLVMTypes);
+    type->setFields(std::move(fields));
 
     selfSymbol = new Value(node->getIdentifier(), new Type(TY_PTR, structType->getPointerTo(), type));
     selfSymbol->setExported(node->isExported());
@@ -1006,16 +2029,67 @@ void Codegen::visit(const Enum *node) {
     Scope->insertSymbol(structSymbol);
 }
 
+namespace {
+    // Memory orders are written as bare names, and only where an atomic operation expects one
+    std::optional<llvm::AtomicOrdering> parseAtomicOrdering(Expression *expr) {
+        static const std::map<std::string, llvm::AtomicOrdering> orderings = {
+                {"relaxed", llvm::AtomicOrdering::Monotonic},
+                {"acquire", llvm::AtomicOrdering::Acquire},
+                {"release", llvm::AtomicOrdering::Release},
+                {"acq_rel", llvm::AtomicOrdering::AcquireRelease},
+                {"seq_cst", llvm::AtomicOrdering::SequentiallyConsistent}};
+
+        auto literal = dynamic_cast<Literal *>(expr);
+        if (literal == nullptr || literal->getType() != TokenType::IDENTIFIER || orderings.count(literal->getValue()) == 0)
+            return std::nullopt;
+        return orderings.at(literal->getValue());
+    }
+}// namespace
+
 void Codegen::visit(const FuncCall *node) {
+    EmitLocation(node);
+
+    // fence(order) orders the memory accesses of this thread around it
+    auto args = node->getArguments();
+    if (node->getName() == "fence" && args.size() == 1 && parseAtomicOrdering(args[0]).has_value()) {
+        auto order = parseAtomicOrdering(args[0]).value();
+        if (order == AtomicOrdering::Monotonic)
+            throw CodegenError(node->getSpan(), "Fences can't be relaxed");
+
+        result = new Value("", new Type(TY_VOID, Builder->getVoidTy()), Builder->CreateFence(order));
+        return;
+    }
+
     result = genFuncCall(node, {});
 }
 
 void Codegen::visit(const BinaryOp *node) {
+    if (node->getOperator() == TokenType::AND || node->getOperator() == TokenType::OR) {
+        result = genLogicalOp(node);
+        return;
+    }
+
     node->getLeft()->accept(*this);
     lesma::Value *left = result;
     node->getRight()->accept(*this);
     lesma::Value *right = result;
     lesma::Type *finalType = GetExtendedType(left->getType(), right->getType());
+    EmitLocation(node);
+
+    if (left->getType()->is(TY_STRING) && right->getType()->is(TY_STRING)) {
+        result = genStringOp(node, left, right);
+        return;
+    }
+
+    // Pointers and class instances compare against null by address
+    auto isNull = [](lesma::Value *val) { return val->getType()->is(TY_VOID) && isa<ConstantPointerNull>(val->getLLVMValue()); };
+    auto isAddress = [](lesma::Value *val) { return val->getType()->isOneOf({TY_PTR, TY_CLASS}); };
+    if ((node->getOperator() == TokenType::EQUAL_EQUAL || node->getOperator() == TokenType::BANG_EQUAL) &&
+        ((isNull(left) && (isAddress(right) || isNull(right))) || (isNull(right) && isAddress(left)))) {
+        auto val = node->getOperator() == TokenType::EQUAL_EQUAL ? Builder->CreateICmpEQ(left->getLLVMValue(), right->getLLVMValue()) : Builder->CreateICmpNE(left->getLLVMValue(), right->getLLVMValue());
+        result = new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), val);
+        return;
+    }
 
     switch (node->getOperator()) {
         case TokenType::MINUS:
@@ -1091,10 +2165,15 @@ void Codegen::visit(const BinaryOp *node) {
         case TokenType::POWER:
             if (finalType == nullptr)
                 break;
+            else if (!left->getType()->isOneOf({TY_INT, TY_FLOAT}))
+                throw CodegenError(node->getSpan(), "Cannot use non-numbers for power base: {}",
+                                   node->getLeft()->toString(SourceManager.get(), "", true));
             else if (!right->getType()->isOneOf({TY_INT, TY_FLOAT}))
                 throw CodegenError(node->getSpan(), "Cannot use non-numbers for power coefficient: {}",
                                    node->getRight()->toString(SourceManager.get(), "", true));
-            throw CodegenError(node->getSpan(), "Power operator not implemented yet.");
+
+            result = genPower(left, right);
+            return;
         case TokenType::EQUAL_EQUAL:
             left = Cast(node->getSpan(), left, finalType);
             right = Cast(node->getSpan(), right, finalType);
@@ -1211,20 +2290,6 @@ void Codegen::visit(const BinaryOp *node) {
                 return;
             }
             break;
-        case TokenType::AND:
-            if (!left->getType()->is(TY_BOOL) && !right->getType()->is(TY_BOOL))
-                throw CodegenError(node->getSpan(), "Cannot use non-booleans for and: {} - {}",
-                                   node->getLeft()->toString(SourceManager.get(), "", true), node->getRight()->toString(SourceManager.get(), "", true));
-
-            result = new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), Builder->CreateLogicalAnd(left->getLLVMValue(), right->getLLVMValue()));
-            return;
-        case TokenType::OR:
-            if (!left->getType()->is(TY_BOOL) && !right->getType()->is(TY_BOOL))
-                throw CodegenError(node->getSpan(), "Cannot use non-booleans for or: {} - {}",
-                                   node->getLeft()->toString(SourceManager.get(), "", true), node->getRight()->toString(SourceManager.get(), "", true));
-
-            result = new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), Builder->CreateLogicalOr(left->getLLVMValue(), right->getLLVMValue()));
-            return;
         default:
             throw CodegenError(node->getSpan(), "Unimplemented binary operator: {}", NAMEOF_ENUM(node->getOperator()));
     }
@@ -1236,6 +2301,807 @@ void Codegen::visit(const BinaryOp *node) {
                        node->getRight()->toString(SourceManager.get(), "", true));
 }
 
+lesma::Value *Codegen::genPower(lesma::Value *base, lesma::Value *exponent) {
+    // Largest constant exponent expanded inline, needs at most 8 multiplications
+    const uint64_t maxChainExponent = 16;
+
+    if (base->getType()->is(TY_INT) && exponent->getType()->is(TY_INT)) {
+        auto type = GetExtendedType(base->getType(), exponent->getType());
+        base = Cast({}, base, type);
+        exponent = Cast({}, exponent, type);
+    }
+
+    // Small constant exponents are cheaper as a chain of multiplications by squaring
+    auto constant = llvm::dyn_cast<llvm::ConstantInt>(exponent->getLLVMValue());
+    if (constant != nullptr && !constant->isNegative() && constant->getZExtValue() <= maxChainExponent) {
+        bool isFloat = base->getType()->is(TY_FLOAT);
+        llvm::Value *square = base->getLLVMValue();
+        llvm::Value *chain = nullptr;
+        for (uint64_t n = constant->getZExtValue(); n > 0; n >>= 1) {
+            if (n & 1)
+                chain = chain == nullptr ? square : isFloat ? Builder->CreateFMul(chain, square) : Builder->CreateMul(chain, square);
+            if (n > 1)
+                square = isFloat ? Builder->CreateFMul(square, square) : Builder->CreateMul(square, square);
+        }
+
+        if (chain == nullptr)
+            chain = isFloat ? ConstantFP::get(base->getType()->getLLVMType(), 1.0) : ConstantInt::get(base->getType()->getLLVMType(), 1);
+        return new Value("", base->getType(), chain);
+    }
+
+    if (base->getType()->is(TY_INT) && exponent->getType()->is(TY_INT)) {
+        auto call = Builder->CreateCall(getIntegerPowerFunction(base->getType()->getLLVMType()), {base->getLLVMValue(), exponent->getLLVMValue()});
+        return new Value("", base->getType(), call);
+    }
+
+    base = Cast({}, base, base->getType()->is(TY_FLOAT) ? base->getType() : new Type(TY_FLOAT, Builder->getDoubleTy()));
+    if (exponent->getType()->is(TY_INT)) {
+        // powi takes an i32 exponent, wider exponents only use it when they fit and fall back to pow otherwise
+        auto genPowi = [&](llvm::Value *exp) -> llvm::Value * {
+            exp = Builder->CreateIntCast(exp, Builder->getInt32Ty(), true);
+            return Builder->CreateIntrinsic(Intrinsic::powi, {base->getType()->getLLVMType(), Builder->getInt32Ty()}, {base->getLLVMValue(), exp});
+        };
+        auto genPow = [&](llvm::Value *exp) -> llvm::Value * {
+            exp = Builder->CreateSIToFP(exp, base->getType()->getLLVMType());
+            return Builder->CreateBinaryIntrinsic(Intrinsic::pow, base->getLLVMValue(), exp);
+        };
+
+        auto exp = exponent->getLLVMValue();
+        if (exp->getType()->getIntegerBitWidth() <= 32 || (constant != nullptr && constant->getValue().isSignedIntN(32)))
+            return new Value("", base->getType(), genPowi(exp));
+        if (constant != nullptr)
+            return new Value("", base->getType(), genPow(exp));
+
+        auto parentFct = Builder->GetInsertBlock()->getParent();
+        auto bNarrow = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.narrow", parentFct);
+        auto bWide = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.wide", parentFct);
+        auto bEnd = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.end", parentFct);
+
+        auto narrow = Builder->CreateSExt(Builder->CreateTrunc(exp, Builder->getInt32Ty()), exp->getType());
+        Builder->CreateCondBr(Builder->CreateICmpEQ(narrow, exp), bNarrow, bWide);
+
+        Builder->SetInsertPoint(bNarrow);
+        auto narrowResult = genPowi(exp);
+        Builder->CreateBr(bEnd);
+
+        Builder->SetInsertPoint(bWide);
+        auto wideResult = genPow(exp);
+        Builder->CreateBr(bEnd);
+
+        Builder->SetInsertPoint(bEnd);
+        auto result = Builder->CreatePHI(base->getType()->getLLVMType(), 2);
+        result->addIncoming(narrowResult, bNarrow);
+        result->addIncoming(wideResult, bWide);
+        return new Value("", base->getType(), result);
+    }
+
+    exponent = Cast({}, exponent, base->getType());
+    return new Value("", base->getType(), Builder->CreateBinaryIntrinsic(Intrinsic::pow, base->getLLVMValue(), exponent->getLLVMValue()));
+}
+
+llvm::Function *Codegen::getIntegerPowerFunction(llvm::Type *type) {
+    auto name = fmt::format("lesma.ipow.i{}", type->getIntegerBitWidth());
+    if (auto F = TheModule->getFunction(name))
+        return F;
+
+    auto F = Function::Create(FunctionType::get(type, {type, type}, false), Function::PrivateLinkage, name, *TheModule);
+    F->addFnAttr(Attribute::NoUnwind);
+
+    // Built on the side, the caller's insertion point and debug location are restored afterwards
+    IRBuilderBase::InsertPointGuard guard(*Builder);
+    Builder->SetCurrentDebugLocation(DebugLoc());
+
+    auto bEntry = llvm::BasicBlock::Create(*TheContext->getContext(), "entry", F);
+    auto bCond = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.cond", F);
+    auto bLoop = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.loop", F);
+    auto bEnd = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.end", F);
+    auto bNegative = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.negative", F);
+    auto bZero = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.zero", F);
+
+    auto base = F->getArg(0);
+    auto exponent = F->getArg(1);
+    auto zero = ConstantInt::get(type, 0);
+    auto one = ConstantInt::get(type, 1);
+
+    Builder->SetInsertPoint(bEntry);
+    Builder->CreateCondBr(Builder->CreateICmpSLT(exponent, zero), bNegative, bCond);
+
+    Builder->SetInsertPoint(bCond);
+    auto acc = Builder->CreatePHI(type, 2, "acc");
+    auto square = Builder->CreatePHI(type, 2, "square");
+    auto remaining = Builder->CreatePHI(type, 2, "n");
+    Builder->CreateCondBr(Builder->CreateICmpNE(remaining, zero), bLoop, bEnd);
+
+    Builder->SetInsertPoint(bLoop);
+    auto isOdd = Builder->CreateICmpNE(Builder->CreateAnd(remaining, one), zero);
+    auto nextAcc = Builder->CreateSelect(isOdd, Builder->CreateMul(acc, square), acc);
+    auto nextSquare = Builder->CreateMul(square, square);
+    auto nextRemaining = Builder->CreateLShr(remaining, one);
+    Builder->CreateBr(bCond);
+
+    acc->addIncoming(one, bEntry);
+    acc->addIncoming(nextAcc, bLoop);
+    square->addIncoming(base, bEntry);
+    square->addIncoming(nextSquare, bLoop);
+    remaining->addIncoming(exponent, bEntry);
+    remaining->addIncoming(nextRemaining, bLoop);
+
+    Builder->SetInsertPoint(bEnd);
+    Builder->CreateRet(acc);
+
+    // Negative exponents truncate like integer division of 1 by base^-exponent, which is only non-zero for 1 and -1.
+    // It's worked out without dividing, base^-exponent can wrap around to zero.
+    Builder->SetInsertPoint(bNegative);
+    auto bNonZero = llvm::BasicBlock::Create(*TheContext->getContext(), "pow.nonzero", F);
+    Builder->CreateCondBr(Builder->CreateICmpEQ(base, zero), bZero, bNonZero);
+
+    Builder->SetInsertPoint(bNonZero);
+    auto isMinusOne = Builder->CreateICmpEQ(base, ConstantInt::getSigned(type, -1));
+    auto isOddExponent = Builder->CreateICmpNE(Builder->CreateAnd(exponent, one), zero);
+    auto minusOnePower = Builder->CreateSelect(isOddExponent, ConstantInt::getSigned(type, -1), one);
+    Builder->CreateRet(Builder->CreateSelect(Builder->CreateICmpEQ(base, one), one,
+                                             Builder->CreateSelect(isMinusOne, minusOnePower, zero)));
+
+    Builder->SetInsertPoint(bZero);
+    genRuntimeError("zero cannot be raised to a negative power");
+
+    return F;
+}
+
+lesma::Value *Codegen::genLogicalOp(const BinaryOp *node) {
+    bool isAnd = node->getOperator() == TokenType::AND;
+    auto parentFct = Builder->GetInsertBlock()->getParent();
+    auto bRight = llvm::BasicBlock::Create(*TheContext->getContext(), isAnd ? "and.rhs" : "or.rhs");
+    auto bEnd = llvm::BasicBlock::Create(*TheContext->getContext(), isAnd ? "and.end" : "or.end");
+
+    node->getLeft()->accept(*this);
+    lesma::Value *left = result;
+    if (!left->getType()->is(TY_BOOL))
+        throw CodegenError(node->getSpan(), "Cannot use non-booleans for {}: {}", isAnd ? "and" : "or",
+                           node->getLeft()->toString(SourceManager.get(), "", true));
+
+    // The right-hand side only runs if the left-hand side doesn't already decide the result
+    EmitLocation(node);
+    auto bLeftEnd = Builder->GetInsertBlock();
+    if (isAnd)
+        Builder->CreateCondBr(left->getLLVMValue(), bRight, bEnd);
+    else
+        Builder->CreateCondBr(left->getLLVMValue(), bEnd, bRight);
+
+    bRight->insertInto(parentFct);
+    Builder->SetInsertPoint(bRight);
+    node->getRight()->accept(*this);
+    lesma::Value *right = result;
+    if (!right->getType()->is(TY_BOOL))
+        throw CodegenError(node->getSpan(), "Cannot use non-booleans for {}: {}", isAnd ? "and" : "or",
+                           node->getRight()->toString(SourceManager.get(), "", true));
+
+    // Nested logical operators leave us in their own end block
+    auto bRightEnd = Builder->GetInsertBlock();
+    Builder->CreateBr(bEnd);
+
+    bEnd->insertInto(parentFct);
+    Builder->SetInsertPoint(bEnd);
+    auto phi = Builder->CreatePHI(Builder->getInt1Ty(), 2, isAnd ? "and" : "or");
+    phi->addIncoming(Builder->getInt1(!isAnd), bLeftEnd);
+    phi->addIncoming(right->getLLVMValue(), bRightEnd);
+
+    return new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), phi);
+}
+
+lesma::Value *Codegen::genStringOp(const BinaryOp *node, lesma::Value *left, lesma::Value *right) {
+    auto ptrTy = Builder->getPtrTy();
+    auto boolType = new Type(TY_BOOL, Builder->getInt1Ty());
+
+    switch (node->getOperator()) {
+        case TokenType::PLUS:
+            return new Value("", left->getType(), Builder->CreateCall(getStringFunction("lesma_string_concat", ptrTy, {ptrTy, ptrTy}, false), {left->getLLVMValue(), right->getLLVMValue()}));
+        case TokenType::EQUAL_EQUAL:
+        case TokenType::BANG_EQUAL: {
+            llvm::Value *equal = Builder->CreateCall(getStringFunction("lesma_string_equal", Builder->getInt1Ty(), {ptrTy, ptrTy}, true), {left->getLLVMValue(), right->getLLVMValue()});
+            return new Value("", boolType, node->getOperator() == TokenType::EQUAL_EQUAL ? equal : Builder->CreateNot(equal));
+        }
+        case TokenType::LESS:
+        case TokenType::LESS_EQUAL:
+        case TokenType::GREATER:
+        case TokenType::GREATER_EQUAL: {
+            llvm::Value *order = Builder->CreateCall(getStringFunction("lesma_string_compare", Builder->getInt64Ty(), {ptrTy, ptrTy}, true), {left->getLLVMValue(), right->getLLVMValue()});
+            auto predicate = node->getOperator() == TokenType::LESS         ? CmpInst::ICMP_SLT
+                             : node->getOperator() == TokenType::LESS_EQUAL ? CmpInst::ICMP_SLE
+                             : node->getOperator() == TokenType::GREATER    ? CmpInst::ICMP_SGT
+                                                                            : CmpInst::ICMP_SGE;
+            return new Value("", boolType, Builder->CreateICmp(predicate, order, Builder->getInt64(0)));
+        }
+        default:
+            throw CodegenError(node->getSpan(), "Unimplemented binary operator {} for strings", NAMEOF_ENUM(node->getOperator()));
+    }
+}
+
+void Codegen::visit(const Slice *node) {
+    node->getExpression()->accept(*this);
+    auto str = result;
+    if (!str->getType()->is(TY_STRING))
+        throw CodegenError(node->getSpan(), "Only strings can be sliced, found {}", str->getType()->toString());
+
+    auto intType = new Type(TY_INT, Builder->getInt64Ty());
+    llvm::Value *start = Builder->getInt64(0);
+    llvm::Value *end = Builder->getInt64(INT64_MAX);
+    if (node->getStartIndex() != nullptr) {
+        node->getStartIndex()->accept(*this);
+        if (!result->getType()->is(TY_INT))
+            throw CodegenError(node->getStartIndex()->getSpan(), "Slice indices must be integers, found {}", result->getType()->toString());
+        start = Cast(node->getSpan(), result, intType)->getLLVMValue();
+    }
+    if (node->getEndIndex() != nullptr) {
+        node->getEndIndex()->accept(*this);
+        if (!result->getType()->is(TY_INT))
+            throw CodegenError(node->getEndIndex()->getSpan(), "Slice indices must be integers, found {}", result->getType()->toString());
+        end = Cast(node->getSpan(), result, intType)->getLLVMValue();
+    }
+
+    auto ptrTy = Builder->getPtrTy();
+    auto slice = getStringFunction("lesma_string_slice", ptrTy, {ptrTy, Builder->getInt64Ty(), Builder->getInt64Ty()}, false);
+    result = new Value("", str->getType(), Builder->CreateCall(slice, {str->getLLVMValue(), start, end}));
+}
+
+void Codegen::visit(const Interpolation *node) {
+    // Every part has an upper bound on its size, so the string is allocated once and each part is written in place
+    std::vector<std::pair<lesma::Value *, llvm::Value *>> parts;
+    llvm::Value *capacity = Builder->getInt64(0);
+    for (auto expr: node->getParts()) {
+        auto literal = dynamic_cast<Literal *>(expr);
+        if (literal != nullptr && literal->getType() == TokenType::STRING && literal->getValue().empty())
+            continue;
+
+        expr->accept(*this);
+        llvm::Value *size;
+        if (result->getType()->is(TY_BOOL))
+            result = new Value("", new Type(TY_STRING, Builder->getPtrTy()), Builder->CreateSelect(result->getLLVMValue(), genStringLiteral("true"), genStringLiteral("false")));
+
+        if (result->getType()->is(TY_STRING))
+            size = genStringLength(result->getLLVMValue());
+        else if (result->getType()->is(TY_INT))
+            size = Builder->getInt64(LESMA_FORMAT_INT_SIZE);
+        else if (result->getType()->is(TY_FLOAT))
+            size = Builder->getInt64(LESMA_FORMAT_FLOAT_SIZE);
+        else
+            throw CodegenError(expr->getSpan(), "Cannot interpolate a value of type {}", result->getType()->toString());
+
+        parts.emplace_back(result, size);
+        capacity = Builder->CreateAdd(capacity, size);
+    }
+
+    auto header = Builder->CreateCall(getAllocFunction(), {Builder->CreateAdd(capacity, Builder->getInt64(sizeof(lesma_string_header) + 1))}, "str");
+    auto data = Builder->CreateConstInBoundsGEP1_64(Builder->getInt8Ty(), header, sizeof(lesma_string_header));
+
+    llvm::Value *cursor = data;
+    for (auto [part, size]: parts) {
+        llvm::Value *written = size;
+        if (part->getType()->is(TY_STRING)) {
+            Builder->CreateMemCpy(cursor, MaybeAlign(1), part->getLLVMValue(), MaybeAlign(1), size);
+        } else if (part->getType()->is(TY_INT)) {
+            auto format = getRuntimeFunction("lesma_format_int", Builder->getInt64Ty(), {Builder->getPtrTy(), Builder->getInt64Ty()});
+            format->setOnlyAccessesArgMemory();
+            format->addParamAttr(0, Attribute::NoCapture);
+            written = Builder->CreateCall(format, {cursor, Builder->CreateIntCast(part->getLLVMValue(), Builder->getInt64Ty(), part->getType()->isSigned())});
+        } else {
+            auto format = getRuntimeFunction("lesma_format_float", Builder->getInt64Ty(), {Builder->getPtrTy(), Builder->getDoubleTy()});
+            format->addParamAttr(0, Attribute::NoCapture);
+            written = Builder->CreateCall(format, {cursor, Builder->CreateFPCast(part->getLLVMValue(), Builder->getDoubleTy())});
+        }
+        cursor = Builder->CreateInBoundsGEP(Builder->getInt8Ty(), cursor, written);
+    }
+
+    // Fill in the header, the capacity is what was reserved and the length what was actually written
+    Builder->CreateStore(Builder->getInt8(0), cursor);
+    Builder->CreateStore(Builder->CreatePtrDiff(Builder->getInt8Ty(), cursor, data), header);
+    Builder->CreateStore(capacity, Builder->CreateConstInBoundsGEP1_64(Builder->getInt8Ty(), header, offsetof(lesma_string_header, capacity)));
+
+    result = new Value("", new Type(TY_STRING, Builder->getPtrTy()), data);
+}
+
+llvm::Value *Codegen::genStringLength(llvm::Value *str) {
+    // The header sits right before the bytes, see lesma_string_header
+    auto header = Builder->CreateConstGEP1_64(Builder->getInt8Ty(), str, -static_cast<int64_t>(sizeof(lesma_string_header)));
+    return Builder->CreateLoad(Builder->getInt64Ty(), header, "len");
+}
+
+void Codegen::visit(const Spawn *node) {
+    auto call = node->getCall();
+
+    // Arguments are evaluated right away on the spawning thread, and copied into the task
+    std::vector<lesma::Type *> paramTypes;
+    std::vector<llvm::Value *> args;
+    for (auto arg: call->getArguments()) {
+        arg->accept(*this);
+        paramTypes.push_back(result->getType());
+        args.push_back(result->getLLVMValue());
+    }
+
+    auto class_sym = Scope->lookupStruct(call->getName());
+    if (class_sym != nullptr && class_sym->getType()->is(TY_CLASS))
+        throw CodegenError(call->getSpan(), "Cannot spawn constructor for {}, only functions can be spawned", call->getName());
+
+    auto symbol = Scope->lookupFunction(call->getName(), paramTypes);
+    if (symbol == nullptr)
+        throw CodegenError(call->getSpan(), "Function {} not in current scope.", call->getName());
+
+    auto fields = symbol->getType()->getFields();
+    for (auto it = fields.begin() + static_cast<long>(args.size()); it < fields.end(); ++it)
+        args.push_back((*it)->defaultValue->getLLVMValue());
+
+    auto *func = cast<Function>(symbol->getLLVMValue());
+    if (func->isVarArg())
+        throw CodegenError(call->getSpan(), "Cannot spawn variadic function {}", call->getName());
+    if (symbol->getType()->getReturnType()->is(TY_FUTURE))
+        throw CodegenError(call->getSpan(), "Cannot spawn async function {}, coroutines run on the thread awaiting them", call->getName());
+
+    // The result comes first, so joining finds it at the start of the task whatever the arguments are
+    std::vector<llvm::Type *> envFields;
+    if (!func->getReturnType()->isVoidTy())
+        envFields.push_back(func->getReturnType());
+    for (auto param: func->getFunctionType()->params())
+        envFields.push_back(param);
+    auto envType = StructType::get(*TheContext->getContext(), envFields);
+    auto size = TheModule->getDataLayout().getTypeAllocSize(envType);
+
+    auto taskNew = getRuntimeFunction("lesma_task_new", Builder->getPtrTy(), {Builder->getPtrTy(), Builder->getInt64Ty()});
+    auto env = Builder->CreateCall(taskNew, {genTaskFunction(symbol, envType), Builder->getInt64(size)}, "task");
+    auto first = static_cast<unsigned int>(envFields.size() - args.size());
+    for (unsigned int i = 0; i < args.size(); i++)
+        Builder->CreateStore(args[i], Builder->CreateStructGEP(envType, env, first + i));
+    Builder->CreateCall(getRuntimeFunction("lesma_task_spawn", Builder->getVoidTy(), {Builder->getPtrTy()}), {env});
+
+    result = new Value("", new Type(TY_TASK, Builder->getPtrTy(), symbol->getType()->getReturnType()), env);
+}
+
+void Codegen::visit(const Join *node) {
+    node->getTask()->accept(*this);
+    if (!result->getType()->is(TY_TASK))
+        throw CodegenError(node->getTask()->getSpan(), "Cannot join a value of type {}", result->getType()->toString());
+
+    auto env = result->getLLVMValue();
+    auto type = result->getType()->getElementType();
+    llvm::Value *value = Builder->CreateCall(getRuntimeFunction("lesma_task_join", Builder->getVoidTy(), {Builder->getPtrTy()}), {env});
+    if (!type->is(TY_VOID))
+        value = Builder->CreateLoad(type->is(TY_CLASS) ? Builder->getPtrTy() : type->getLLVMType(), env, "joined");
+    Builder->CreateCall(getRuntimeFunction("lesma_task_free", Builder->getVoidTy(), {Builder->getPtrTy()}), {env});
+
+    result = new Value("", type, value);
+}
+
+llvm::Function *Codegen::genTaskFunction(lesma::Value *symbol, llvm::StructType *envType) {
+    auto *func = cast<Function>(symbol->getLLVMValue());
+    auto name = fmt::format("{}.task", func->getName().str());
+    if (auto task = TheModule->getFunction(name))
+        return task;
+
+    // Runs on a worker: unpacks the arguments stored by the spawn, makes the call and stores the result over them
+    auto task = Function::Create(FunctionType::get(Builder->getVoidTy(), {Builder->getPtrTy()}, false), Function::PrivateLinkage, name, *TheModule);
+    task->addFnAttr(Attribute::NoUnwind);
+
+    IRBuilderBase::InsertPointGuard guard(*Builder);
+    Builder->SetCurrentDebugLocation(DebugLoc());
+    Builder->SetInsertPoint(llvm::BasicBlock::Create(*TheContext->getContext(), "entry", task));
+
+    auto env = task->getArg(0);
+    bool hasResult = !func->getReturnType()->isVoidTy();
+    std::vector<llvm::Value *> args;
+    for (unsigned int i = hasResult ? 1 : 0; i < envType->getNumElements(); i++)
+        args.push_back(Builder->CreateLoad(envType->getElementType(i), Builder->CreateStructGEP(envType, env, i)));
+
+    llvm::Value *ret = Builder->CreateCall(func, args);
+    if (symbol->isExtern() && !symbol->isRuntime() && symbol->getType()->getReturnType()->is(TY_STRING))
+        ret = Builder->CreateCall(getStringFunction("lesma_string_from_c", Builder->getPtrTy(), {Builder->getPtrTy()}, false), {ret});
+    if (hasResult)
+        Builder->CreateStore(ret, Builder->CreateStructGEP(envType, env, 0));
+    Builder->CreateRetVoid();
+
+    return task;
+}
+
+void Codegen::visit(const Await *node) {
+    EmitLocation(node);
+
+    // Calls of async extern functions are awaited by genFuncCall, which clears awaitedCall once it did
+    auto outerCall = awaitedCall;
+    auto call = dynamic_cast<FuncCall *>(node->getValue());
+    awaitedCall = call;
+    node->getValue()->accept(*this);
+    bool awaited = call != nullptr && awaitedCall == nullptr;
+    awaitedCall = outerCall;
+    if (awaited)
+        return;
+
+    if (!result->getType()->is(TY_FUTURE))
+        throw CodegenError(node->getValue()->getSpan(), "Cannot await a value of type {}", result->getType()->toString());
+
+    auto F = Builder->GetInsertBlock()->getParent();
+    auto child = result->getLLVMValue();
+    auto type = result->getType()->getElementType();
+    auto promiseType = getPromiseType(type);
+    auto align = Builder->getInt32(TheModule->getDataLayout().getPrefTypeAlign(promiseType).value());
+    auto ready = BasicBlock::Create(*TheContext->getContext(), "await.ready");
+
+    if (coroutine.handle != nullptr) {
+        if (regionDepth > 0)
+            throw CodegenError(node->getSpan(), "Cannot await inside a region");
+
+        // Suspends until the awaited coroutine finishes and queues this one, unless it's done already
+        auto wait = BasicBlock::Create(*TheContext->getContext(), "await.wait", F);
+        Builder->CreateCondBr(Builder->CreateIntrinsic(Intrinsic::coro_done, {}, {child}), ready, wait);
+
+        Builder->SetInsertPoint(wait);
+        auto save = Builder->CreateIntrinsic(Intrinsic::coro_save, {}, {coroutine.handle});
+        auto promise = Builder->CreateIntrinsic(Intrinsic::coro_promise, {}, {child, align, Builder->getFalse()});
+        Builder->CreateStore(coroutine.promise, Builder->CreateStructGEP(promiseType, promise, 2));
+        genSuspend(save, ready);
+    } else {
+        // Outside of async functions there is nothing to suspend, ready coroutines run until the awaited one is done
+        auto check = BasicBlock::Create(*TheContext->getContext(), "await.check", F);
+        auto step = BasicBlock::Create(*TheContext->getContext(), "await.step", F);
+        Builder->CreateBr(check);
+
+        Builder->SetInsertPoint(check);
+        Builder->CreateCondBr(Builder->CreateIntrinsic(Intrinsic::coro_done, {}, {child}), ready, step);
+
+        // The awaited coroutine is passed along, its frame may have been elided into this function, and is only
+        // reachable through the ready queue, which LLVM doesn't know the runtime looks at
+        Builder->SetInsertPoint(step);
+        Builder->CreateCall(getRuntimeFunction("lesma_async_step", Builder->getVoidTy(), {Builder->getPtrTy()}), {child});
+        Builder->CreateBr(check);
+    }
+
+    ready->insertInto(F);
+    Builder->SetInsertPoint(ready);
+    llvm::Value *value = nullptr;
+    if (!type->is(TY_VOID)) {
+        auto promise = Builder->CreateIntrinsic(Intrinsic::coro_promise, {}, {child, align, Builder->getFalse()});
+        value = Builder->CreateLoad(promiseType->getElementType(3), Builder->CreateStructGEP(promiseType, promise, 3), "awaited");
+    }
+
+    // Awaiting releases the coroutine, the frame is freed unless CoroElide put it on the stack of this function
+    auto destroy = Builder->CreateIntrinsic(Intrinsic::coro_destroy, {}, {child});
+    result = new Value("", type, value == nullptr ? destroy : value);
+}
+
+lesma::Value *Codegen::genAwaitExtern(const FuncCall *node, lesma::Value *symbol, llvm::Function *func, const std::vector<llvm::Value *> &args) {
+    if (node != awaitedCall)
+        throw CodegenError(node->getSpan(), "Async extern function {} can only be called with await", node->getName());
+    if (coroutine.handle == nullptr)
+        throw CodegenError(node->getSpan(), "Cannot await {} outside of an async function", node->getName());
+    if (regionDepth > 0)
+        throw CodegenError(node->getSpan(), "Cannot await inside a region");
+    awaitedCall = nullptr;
+
+    auto type = symbol->getType()->getReturnType()->getElementType();
+    std::vector<llvm::Value *> externArgs = {coroutine.promise};
+    llvm::AllocaInst *slot = nullptr;
+    if (!type->is(TY_VOID)) {
+        slot = CreateEntryBlockAlloca(type->getLLVMType(), "awaited.slot");
+        externArgs.push_back(slot);
+    }
+    externArgs.insert(externArgs.end(), args.begin(), args.end());
+
+    // Saved before the call, the coroutine may be queued to resume from here before the call even returns
+    auto save = Builder->CreateIntrinsic(Intrinsic::coro_save, {}, {coroutine.handle});
+    llvm::Value *value = Builder->CreateCall(func, externArgs);
+    auto resume = BasicBlock::Create(*TheContext->getContext(), "await.resume", Builder->GetInsertBlock()->getParent());
+    genSuspend(save, resume);
+
+    Builder->SetInsertPoint(resume);
+    if (slot != nullptr)
+        value = Builder->CreateLoad(type->getLLVMType(), slot, "awaited");
+
+    return new Value("", type, value);
+}
+
+llvm::StructType *Codegen::getPromiseType(lesma::Type *type) {
+    // lesma_coroutine, the promise of the coroutine awaiting this one, then the result if there is one
+    std::vector<llvm::Type *> fields = {Builder->getPtrTy(), Builder->getPtrTy(), Builder->getPtrTy()};
+    if (!type->is(TY_VOID))
+        fields.push_back(type->is(TY_CLASS) ? Builder->getPtrTy() : type->getLLVMType());
+
+    return StructType::get(*TheContext->getContext(), fields);
+}
+
+llvm::Function *Codegen::getResumeFunction() {
+    if (auto func = TheModule->getFunction("lesma.resume"))
+        return func;
+
+    // Resume parts of coroutines use their own calling convention, the runtime calls them through this
+    auto func = Function::Create(FunctionType::get(Builder->getVoidTy(), {Builder->getPtrTy()}, false), Function::PrivateLinkage, "lesma.resume", *TheModule);
+    func->addFnAttr(Attribute::NoUnwind);
+
+    IRBuilderBase::InsertPointGuard guard(*Builder);
+    Builder->SetCurrentDebugLocation(DebugLoc());
+    Builder->SetInsertPoint(llvm::BasicBlock::Create(*TheContext->getContext(), "entry", func));
+    Builder->CreateIntrinsic(Intrinsic::coro_resume, {}, {func->getArg(0)});
+    Builder->CreateRetVoid();
+
+    return func;
+}
+
+void Codegen::genCoroutineBegin(llvm::Function *F, lesma::Type *type) {
+    auto promiseType = getPromiseType(type);
+    auto null = ConstantPointerNull::get(Builder->getPtrTy());
+
+    coroutine.promise = CreateEntryBlockAlloca(promiseType, "promise");
+    coroutine.promise->setAlignment(TheModule->getDataLayout().getPrefTypeAlign(promiseType));
+    // Frames come from lesma_alloc_frame, which aligns to 16 bytes
+    coroutine.id = Builder->CreateIntrinsic(Intrinsic::coro_id, {}, {Builder->getInt32(16), coroutine.promise, null, null}, nullptr, "id");
+
+    // The frame is only allocated if CoroElide couldn't place it in the caller
+    auto entry = Builder->GetInsertBlock();
+    auto allocate = BasicBlock::Create(*TheContext->getContext(), "coro.alloc", F);
+    auto begin = BasicBlock::Create(*TheContext->getContext(), "coro.begin", F);
+    Builder->CreateCondBr(Builder->CreateIntrinsic(Intrinsic::coro_alloc, {}, {coroutine.id}), allocate, begin);
+
+    Builder->SetInsertPoint(allocate);
+    auto size = Builder->CreateIntrinsic(Intrinsic::coro_size, {Builder->getInt64Ty()}, {});
+    auto memory = Builder->CreateCall(getRuntimeFunction("lesma_alloc_frame", Builder->getPtrTy(), {Builder->getInt64Ty()}), {size}, "frame");
+    Builder->CreateBr(begin);
+
+    Builder->SetInsertPoint(begin);
+    auto frame = Builder->CreatePHI(Builder->getPtrTy(), 2);
+    frame->addIncoming(null, entry);
+    frame->addIncoming(memory, allocate);
+    coroutine.handle = Builder->CreateIntrinsic(Intrinsic::coro_begin, {}, {coroutine.id, frame}, nullptr, "handle");
+    Builder->CreateStore(getResumeFunction(), Builder->CreateStructGEP(promiseType, coroutine.promise, 0));
+    Builder->CreateStore(coroutine.handle, Builder->CreateStructGEP(promiseType, coroutine.promise, 1));
+    Builder->CreateStore(null, Builder->CreateStructGEP(promiseType, coroutine.promise, 2));
+
+    IRBuilderBase::InsertPointGuard guard(*Builder);
+    coroutine.finalBlock = BasicBlock::Create(*TheContext->getContext(), "coro.final", F);
+    coroutine.cleanupBlock = BasicBlock::Create(*TheContext->getContext(), "coro.cleanup", F);
+    coroutine.suspendBlock = BasicBlock::Create(*TheContext->getContext(), "coro.suspend", F);
+    auto wake = BasicBlock::Create(*TheContext->getContext(), "coro.wake", F);
+    auto done = BasicBlock::Create(*TheContext->getContext(), "coro.done", F);
+    auto resumed = BasicBlock::Create(*TheContext->getContext(), "coro.resumed", F);
+    auto release = BasicBlock::Create(*TheContext->getContext(), "coro.release", F);
+
+    // Finishing queues the coroutine awaiting this one, which reads the result and destroys this one
+    Builder->SetInsertPoint(coroutine.finalBlock);
+    auto waiter = Builder->CreateLoad(Builder->getPtrTy(), Builder->CreateStructGEP(promiseType, coroutine.promise, 2), "waiter");
+    auto awaited = BasicBlock::Create(*TheContext->getContext(), "coro.awaited", F);
+    // Detached coroutines are their own waiter, nobody reads their result so they release themselves
+    Builder->CreateCondBr(Builder->CreateICmpEQ(waiter, coroutine.promise), coroutine.cleanupBlock, awaited);
+
+    Builder->SetInsertPoint(awaited);
+    Builder->CreateCondBr(Builder->CreateIsNotNull(waiter), wake, done);
+
+    Builder->SetInsertPoint(wake);
+    Builder->CreateCall(getRuntimeFunction("lesma_async_ready", Builder->getVoidTy(), {Builder->getPtrTy()}), {waiter});
+    Builder->CreateBr(done);
+
+    Builder->SetInsertPoint(done);
+    auto state = Builder->CreateIntrinsic(Intrinsic::coro_suspend, {}, {ConstantTokenNone::get(*TheContext->getContext()), Builder->getTrue()});
+    auto cases = Builder->CreateSwitch(state, coroutine.suspendBlock, 2);
+    cases->addCase(Builder->getInt8(0), resumed);
+    cases->addCase(Builder->getInt8(1), coroutine.cleanupBlock);
+
+    Builder->SetInsertPoint(resumed);
+    Builder->CreateUnreachable();
+
+    Builder->SetInsertPoint(coroutine.cleanupBlock);
+    auto allocated = Builder->CreateIntrinsic(Intrinsic::coro_free, {}, {coroutine.id, coroutine.handle});
+    Builder->CreateCondBr(Builder->CreateIsNotNull(allocated), release, coroutine.suspendBlock);
+
+    Builder->SetInsertPoint(release);
+    Builder->CreateCall(getFreeFunction(), {allocated});
+    Builder->CreateBr(coroutine.suspendBlock);
+
+    // Suspending returns to whoever started or resumed the coroutine, the start of it returns the handle
+    Builder->SetInsertPoint(coroutine.suspendBlock);
+    Builder->CreateIntrinsic(Intrinsic::coro_end, {}, {coroutine.handle, Builder->getFalse()});
+    Builder->CreateRet(coroutine.handle);
+}
+
+void Codegen::genDetach(lesma::Value *future) {
+    auto F = Builder->GetInsertBlock()->getParent();
+    auto child = future->getLLVMValue();
+    auto promiseType = getPromiseType(future->getType()->getElementType());
+    auto align = Builder->getInt32(TheModule->getDataLayout().getPrefTypeAlign(promiseType).value());
+    auto finished = BasicBlock::Create(*TheContext->getContext(), "detach.finished", F);
+    auto running = BasicBlock::Create(*TheContext->getContext(), "detach.running", F);
+    auto end = BasicBlock::Create(*TheContext->getContext(), "detach.end", F);
+    Builder->CreateCondBr(Builder->CreateIntrinsic(Intrinsic::coro_done, {}, {child}), finished, running);
+
+    // A coroutine that is already done is released right away, otherwise it becomes its own waiter
+    Builder->SetInsertPoint(finished);
+    Builder->CreateIntrinsic(Intrinsic::coro_destroy, {}, {child});
+    Builder->CreateBr(end);
+
+    Builder->SetInsertPoint(running);
+    auto promise = Builder->CreateIntrinsic(Intrinsic::coro_promise, {}, {child, align, Builder->getFalse()});
+    Builder->CreateStore(promise, Builder->CreateStructGEP(promiseType, promise, 2));
+    Builder->CreateBr(end);
+
+    Builder->SetInsertPoint(end);
+}
+
+void Codegen::genSuspend(llvm::Value *save, llvm::BasicBlock *resume) {
+    auto state = Builder->CreateIntrinsic(Intrinsic::coro_suspend, {}, {save, Builder->getFalse()}, nullptr, "state");
+    auto cases = Builder->CreateSwitch(state, coroutine.suspendBlock, 2);
+    cases->addCase(Builder->getInt8(0), resume);
+    cases->addCase(Builder->getInt8(1), coroutine.cleanupBlock);
+}
+
+void Codegen::visit(const NewChannel *node) {
+    node->getType()->accept(*this);
+    auto type = result->getType();
+    auto args = node->getArguments();
+    if (args.size() > 2)
+        throw CodegenError(node->getSpan(), "Channels take a capacity and whether they have a single producer and consumer, found {} arguments", args.size());
+
+    // Without a capacity the channel is unbounded
+    llvm::Value *kind = Builder->getInt64(LESMA_CHANNEL_UNBOUNDED);
+    llvm::Value *capacity = Builder->getInt64(0);
+    if (!args.empty()) {
+        args[0]->accept(*this);
+        if (!result->getType()->is(TY_INT))
+            throw CodegenError(args[0]->getSpan(), "Channel capacity must be an integer, found {}", result->getType()->toString());
+        capacity = Cast(args[0]->getSpan(), result, new Type(TY_INT, Builder->getInt64Ty()))->getLLVMValue();
+        kind = Builder->getInt64(LESMA_CHANNEL_MPMC);
+    }
+    if (args.size() == 2) {
+        args[1]->accept(*this);
+        if (!result->getType()->is(TY_BOOL))
+            throw CodegenError(args[1]->getSpan(), "Expected whether the channel has a single producer and consumer, found {}", result->getType()->toString());
+        kind = Builder->CreateSelect(result->getLLVMValue(), Builder->getInt64(LESMA_CHANNEL_SPSC), Builder->getInt64(LESMA_CHANNEL_MPMC));
+    }
+
+    // Values are copied in and out of the channel by the runtime, which only needs their size
+    auto size = TheModule->getDataLayout().getTypeAllocSize(type->getElementType()->getLLVMType()).getFixedValue();
+    auto channelNew = getRuntimeFunction("lesma_channel_new", Builder->getPtrTy(), {Builder->getInt64Ty(), Builder->getInt64Ty(), Builder->getInt64Ty()});
+    result = new Value("", type, Builder->CreateCall(channelNew, {kind, capacity, Builder->getInt64(size)}, "channel"));
+}
+
+lesma::Value *Codegen::genChannelMethod(const FuncCall *method, lesma::Value *channel) {
+    auto *ptrTy = Builder->getPtrTy();
+    auto elementType = channel->getType()->getElementType();
+    auto name = method->getName();
+    auto args = method->getArguments();
+
+    if (name == "send" && args.size() == 1) {
+        args[0]->accept(*this);
+        auto value = result;
+        // Class instances are sent as the pointer to them
+        if (!(value->getType()->is(TY_CLASS) && elementType->is(TY_PTR) && elementType->getElementType()->isEqual(value->getType())))
+            value = Cast(args[0]->getSpan(), value, elementType);
+
+        auto slot = CreateEntryBlockAlloca(elementType->getLLVMType(), "sent");
+        Builder->CreateStore(value->getLLVMValue(), slot);
+        auto sent = Builder->CreateCall(getChannelFunction("lesma_channel_send", Builder->getInt1Ty(), {ptrTy, ptrTy}), {channel->getLLVMValue(), slot});
+        return new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), sent);
+    } else if (name == "recv" && args.empty()) {
+        // Once the channel is closed and empty, what's received is the zero value
+        auto slot = CreateEntryBlockAlloca(elementType->getLLVMType(), "received");
+        if (elementType->is(TY_STRING))
+            Builder->CreateStore(genStringLiteral(""), slot);
+        else
+            Builder->CreateStore(Constant::getNullValue(elementType->getLLVMType()), slot);
+        Builder->CreateCall(getChannelFunction("lesma_channel_recv", Builder->getInt1Ty(), {ptrTy, ptrTy}), {channel->getLLVMValue(), slot});
+        return new Value("", elementType, Builder->CreateLoad(elementType->getLLVMType(), slot));
+    } else if (name == "close" && args.empty()) {
+        auto close = Builder->CreateCall(getRuntimeFunction("lesma_channel_close", Builder->getVoidTy(), {ptrTy}), {channel->getLLVMValue()});
+        return new Value("", new Type(TY_VOID, Builder->getVoidTy()), close);
+    } else if (name == "closed" && args.empty()) {
+        auto closed = Builder->CreateCall(getChannelFunction("lesma_channel_closed", Builder->getInt1Ty(), {ptrTy}), {channel->getLLVMValue()});
+        return new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), closed);
+    }
+
+    throw CodegenError(method->getSpan(), "Channels have no method {} taking {} arguments, only send(value), recv(), close() and closed()", name, args.size());
+}
+
+void Codegen::visit(const NewAtomic *node) {
+    node->getType()->accept(*this);
+    auto type = result->getType();
+    auto elementType = type->getElementType();
+
+    // Booleans are kept in a byte, LLVM has no atomics narrower than that
+    auto storageType = elementType->is(TY_BOOL) ? Builder->getInt8Ty() : elementType->getLLVMType();
+    llvm::Value *value = Constant::getNullValue(storageType);
+    if (node->getValue().has_value())
+        value = genAtomicOperand(node->getValue().value(), elementType);
+
+    // Other threads only see the atomic once it's passed to them, so it's initialized with a plain store
+    auto size = TheModule->getDataLayout().getTypeAllocSize(storageType).getFixedValue();
+    auto cell = Builder->CreateCall(getAllocFunction(), {Builder->getInt64(size)}, "atomic");
+    Builder->CreateStore(value, cell);
+    result = new Value("", type, cell);
+}
+
+llvm::Value *Codegen::genAtomicOperand(Expression *expr, lesma::Type *type) {
+    expr->accept(*this);
+    auto value = result;
+
+    // Class instances are held as the pointer to them, and null fits any pointer
+    bool instance = value->getType()->is(TY_CLASS) && type->is(TY_PTR) && type->getElementType()->isEqual(value->getType());
+    bool null = value->getType()->is(TY_VOID) && type->is(TY_PTR) && isa<ConstantPointerNull>(value->getLLVMValue());
+    if (!instance && !null)
+        value = Cast(expr->getSpan(), value, type);
+
+    if (type->is(TY_BOOL))
+        return Builder->CreateZExt(value->getLLVMValue(), Builder->getInt8Ty());
+    return value->getLLVMValue();
+}
+
+llvm::AtomicOrdering Codegen::getAtomicOrdering(const std::vector<Expression *> &args, unsigned int index, llvm::AtomicOrdering fallback) {
+    if (index >= args.size())
+        return fallback;
+
+    auto order = parseAtomicOrdering(args[index]);
+    if (!order.has_value())
+        throw CodegenError(args[index]->getSpan(), "Expected a memory order, one of relaxed, acquire, release, acq_rel or seq_cst");
+    return order.value();
+}
+
+lesma::Value *Codegen::genAtomicMethod(const FuncCall *method, lesma::Value *atomic) {
+    auto cell = atomic->getLLVMValue();
+    auto elementType = atomic->getType()->getElementType();
+    auto storageType = elementType->is(TY_BOOL) ? Builder->getInt8Ty() : elementType->getLLVMType();
+    auto align = Align(TheModule->getDataLayout().getTypeStoreSize(storageType).getFixedValue());
+    auto name = method->getName();
+    auto args = method->getArguments();
+    auto span = method->getSpan();
+
+    // Booleans come back out of their byte
+    auto fromStorage = [&](llvm::Value *value) {
+        if (elementType->is(TY_BOOL))
+            value = Builder->CreateICmpNE(value, Builder->getInt8(0));
+        return new Value("", elementType, value);
+    };
+
+    if (name == "load" && args.size() <= 1) {
+        auto order = getAtomicOrdering(args, 0, AtomicOrdering::SequentiallyConsistent);
+        if (order == AtomicOrdering::Release || order == AtomicOrdering::AcquireRelease)
+            throw CodegenError(span, "Loads can't have release ordering");
+
+        auto load = Builder->CreateAlignedLoad(storageType, cell, align);
+        load->setAtomic(order);
+        return fromStorage(load);
+    } else if (name == "store" && (args.size() == 1 || args.size() == 2)) {
+        auto value = genAtomicOperand(args[0], elementType);
+        auto order = getAtomicOrdering(args, 1, AtomicOrdering::SequentiallyConsistent);
+        if (order == AtomicOrdering::Acquire || order == AtomicOrdering::AcquireRelease)
+            throw CodegenError(span, "Stores can't have acquire ordering");
+
+        auto store = Builder->CreateAlignedStore(value, cell, align);
+        store->setAtomic(order);
+        return new Value("", new Type(TY_VOID, Builder->getVoidTy()), store);
+    } else if ((name == "exchange" || name == "fetch_add" || name == "fetch_sub") && (args.size() == 1 || args.size() == 2)) {
+        auto operation = AtomicRMWInst::Xchg;
+        if (name != "exchange") {
+            if (!elementType->is(TY_INT))
+                throw CodegenError(span, "Only atomic integers have {}, found {}", name, elementType->toString());
+            operation = name == "fetch_add" ? AtomicRMWInst::Add : AtomicRMWInst::Sub;
+        }
+
+        auto value = genAtomicOperand(args[0], elementType);
+        auto order = getAtomicOrdering(args, 1, AtomicOrdering::SequentiallyConsistent);
+        if (!elementType->is(TY_PTR))
+            return fromStorage(Builder->CreateAtomicRMW(operation, cell, value, align, order));
+
+        // Pointers are exchanged as integers of the same size
+        auto intType = Builder->getIntNTy(TheModule->getDataLayout().getPointerSizeInBits());
+        auto previous = Builder->CreateAtomicRMW(operation, cell, Builder->CreatePtrToInt(value, intType), align, order);
+        return fromStorage(Builder->CreateIntToPtr(previous, storageType));
+    } else if (name == "compare_exchange" && args.size() >= 2 && args.size() <= 4) {
+        auto expected = genAtomicOperand(args[0], elementType);
+        auto desired = genAtomicOperand(args[1], elementType);
+        auto success = getAtomicOrdering(args, 2, AtomicOrdering::SequentiallyConsistent);
+        auto failure = getAtomicOrdering(args, 3, AtomicCmpXchgInst::getStrongestFailureOrdering(success));
+        if (failure == AtomicOrdering::Release || failure == AtomicOrdering::AcquireRelease)
+            throw CodegenError(span, "The failure order of compare_exchange can't have release ordering");
+
+        auto exchange = Builder->CreateAtomicCmpXchg(cell, expected, desired, align, success, failure);
+        return new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), Builder->CreateExtractValue(exchange, 1));
+    }
+
+    throw CodegenError(span, "Atomics have no method {} taking {} arguments, only load, store, exchange, fetch_add, fetch_sub and compare_exchange", name, args.size());
+}
+
 void Codegen::visit(const DotOp *node) {
     if (auto left = dynamic_cast<Literal *>(node->getLeft())) {
         if (left->getType() != TokenType::IDENTIFIER)
@@ -1263,11 +3129,7 @@ void Codegen::visit(const DotOp *node) {
                     throw CodegenError(node->getLeft()->getSpan(), "Identifier {} not in {}", right->getValue(), left->getValue());
 
                 auto struct_val = Scope->lookupStruct(left->getValue());
-                auto enum_ptr = Builder->CreateAlloca(struct_val->getType()->getLLVMType());
-                auto field = Builder->CreateStructGEP(struct_val->getType()->getLLVMType(), enum_ptr, 0);
-                Builder->CreateStore(Builder->getInt8(val), field);
-                // TODO: Returning the enum directly or a ptr to it? We used to return a pointer
-                auto enum_val = Builder->CreateLoad(struct_val->getType()->getLLVMType(), enum_ptr);
+                auto enum_val = ConstantStruct::get(cast<StructType>(struct_val->getType()->getLLVMType()), Builder->getInt8(val));
 
                 result = new Value("", struct_val->getType(), enum_val);
                 return;
@@ -1293,8 +3155,17 @@ void Codegen::visit(const DotOp *node) {
                 }
             }
         } else {
-            // Assuming it's a class instance
+            // Assuming it's a class instance, a channel or an atomic
             left->accept(*this);
+            if (result->getType()->isOneOf({TY_CHANNEL, TY_ATOMIC})) {
+                auto method = dynamic_cast<FuncCall *>(node->getRight());
+                if (method == nullptr)
+                    throw CodegenError(node->getRight()->getSpan(), "Expected method call right-hand of dot operator on {}, found {}", result->getType()->toString(), node->getRight()->toString(SourceManager.get(), "", true));
+
+                result = result->getType()->is(TY_CHANNEL) ? genChannelMethod(method, result) : genAtomicMethod(method, result);
+                return;
+            }
+
             // We refer to the class type, if it's a pointer, we get the result
             lesma::Type *lesma_type = result->getType();
             if (result->getType()->is(TY_PTR) && result->getType()->getElementType()->is(TY_CLASS)) {
@@ -1404,7 +3275,7 @@ void Codegen::visit(const UnaryOp *node) {
             throw CodegenError(node->getSpan(), "Cannot apply {} to {}", NAMEOF_ENUM(node->getOperator()), node->getExpression()->toString(SourceManager.get(), "", true));
         }
     } else if (node->getOperator() == TokenType::AMPERSAND) {
-        val = Builder->CreateAlloca(result->getType()->getLLVMType());
+        val = CreateEntryBlockAlloca(result->getType()->getLLVMType());
         type = new Type(TY_PTR, Builder->getPtrTy(), result->getType());
         Builder->CreateStore(result->getLLVMValue(), val);
     } else {
@@ -1418,11 +3289,11 @@ void Codegen::visit(const Literal *node) {
     if (node->getType() == TokenType::DOUBLE)
         result = new Value("", new Type(TY_FLOAT, Builder->getDoubleTy()), ConstantFP::get(*TheContext->getContext(), APFloat(std::stod(node->getValue()))));
     else if (node->getType() == TokenType::INTEGER)
-        result = new Value("", new Type(TY_INT, Builder->getInt64Ty()), ConstantInt::getSigned(Builder->getInt64Ty(), std::stoi(node->getValue())));
+        result = new Value("", new Type(TY_INT, Builder->getInt64Ty()), ConstantInt::getSigned(Builder->getInt64Ty(), std::stoll(node->getValue())));
     else if (node->getType() == TokenType::BOOL)
         result = new Value("", new Type(TY_BOOL, Builder->getInt1Ty()), node->getValue() == "true" ? Builder->getTrue() : Builder->getFalse());
     else if (node->getType() == TokenType::STRING)
-        result = new Value("", new Type(TY_STRING, Builder->getInt8PtrTy()), Builder->CreateGlobalStringPtr(node->getValue()));
+        result = new Value("", new Type(TY_STRING, Builder->getInt8PtrTy()), genStringLiteral(node->getValue()));
     else if (node->getType() == TokenType::NIL)
         result = new Value("", new Type(TY_VOID, Builder->getVoidTy()), ConstantPointerNull::getNullValue(Builder->getInt8PtrTy(0)));
     else if (node->getType() == TokenType::IDENTIFIER) {
@@ -1434,6 +3305,9 @@ void Codegen::visit(const Literal *node) {
         if (val->getType()->isOneOf({TY_CLASS})) {
             // If it's a class, don't load the value
             result = val;
+        } else if (!val->getLLVMValue()->getType()->isPointerTy()) {
+            // Bound directly to an SSA value, like loop induction variables
+            result = new Value("", val->getType(), val->getLLVMValue());
         } else {
             // Load the value.
             llvm::Value *llvmVal = Builder->CreateLoad(val->getType()->getLLVMType(), val->getLLVMValue());
@@ -1472,6 +3346,10 @@ std::string Codegen::getTypeMangledName(llvm::SMRange span, lesma::Type *type) {
         return "(arr_" + getTypeMangledName(span, type->getElementType()) + ")";
     else if (type->is(TY_PTR))
         return "(ptr_" + getTypeMangledName(span, type->getElementType()) + ")";
+    else if (type->is(TY_CHANNEL))
+        return "(chan_" + getTypeMangledName(span, type->getElementType()) + ")";
+    else if (type->is(TY_ATOMIC))
+        return "(atomic_" + getTypeMangledName(span, type->getElementType()) + ")";
     else if (type->is(TY_FUNCTION)) {
         std::string param_str;
         for (auto &field: type->getFields()) {
@@ -1479,10 +3357,7 @@ std::string Codegen::getTypeMangledName(llvm::SMRange span, lesma::Type *type) {
         }
         return "(func_" + param_str + ")";
     } else if (type->isOneOf({TY_CLASS, TY_ENUM})) {
-        std::string param_str;
-        for (auto &field: type->getFields()) {
-            param_str += getTypeMangledName(span, field->type) + "_";
-        }
+        // Named by the struct alone, the fields of a class can refer back to it
         return "(struct_" + type->getLLVMType()->getStructName().str() + ")";
     }
 
@@ -1588,8 +3463,13 @@ lesma::Value *Codegen::Cast(llvm::SMRange span, lesma::Value *val, lesma::Type *
             return new Value("", type, Builder->CreateFPCast(val->getLLVMValue(), type->getLLVMType()));
         }
     } else if (type->is(TY_STRING)) {
+        // Copies the C string, so it gets the length every Lesma string has
         if (val->getType()->is(TY_PTR) && (val->getType()->getElementType()->is(TY_INT) || val->getType()->getElementType()->is(TY_VOID)))
-            return new Value("", type, Builder->CreateBitCast(val->getLLVMValue(), type->getLLVMType()));
+            return new Value("", type, Builder->CreateCall(getStringFunction("lesma_string_from_c", Builder->getPtrTy(), {Builder->getPtrTy()}, false), {val->getLLVMValue()}));
+    } else if (type->is(TY_PTR)) {
+        // Lesma strings are null terminated, so they can be used as C strings in place
+        if (val->getType()->is(TY_STRING) && type->getElementType()->is(TY_INT))
+            return new Value("", type, val->getLLVMValue());
     }
 
     throw CodegenError(span, "Unsupported Cast between {} and {}", getTypeMangledName(span, val->getType()), getTypeMangledName(span, type));
@@ -1617,7 +3497,9 @@ lesma::Value *Codegen::genFuncCall(const FuncCall *node, const std::vector<lesma
     llvm::Value *class_ptr = nullptr;
     if (class_sym != nullptr && class_sym->getType()->is(TY_CLASS)) {
         // It's a class constructor, allocate and add self param
-        class_ptr = Builder->CreateAlloca(class_sym->getType()->getLLVMType());
+        // Instances start on the heap, HeapToStackPass moves the ones that don't escape back to the stack
+        auto size = TheModule->getDataLayout().getTypeAllocSize(class_sym->getType()->getLLVMType());
+        class_ptr = Builder->CreateCall(getAllocFunction(), {Builder->getInt64(size)}, "obj");
         paramsLLVM.insert(paramsLLVM.begin(), class_ptr);
         paramTypes.insert(paramTypes.begin(), new Type(TY_PTR, Builder->getPtrTy(), class_sym->getType()));
 
@@ -1646,6 +3528,9 @@ lesma::Value *Codegen::genFuncCall(const FuncCall *node, const std::vector<lesma
         }
     }
     auto *func = cast<Function>(symbol->getType()->is(TY_CLASS) ? symbol->getConstructor()->getLLVMValue() : symbol->getLLVMValue());
+    if (symbol->isExtern() && symbol->getType()->getReturnType()->is(TY_FUTURE))
+        return genAwaitExtern(node, symbol, func, paramsLLVM);
+
     if (class_sym != nullptr && class_sym->getType()->is(TY_CLASS)) {
         Builder->CreateCall(func, paramsLLVM);
         selfSymbol = selfSymbolTmp;
@@ -1653,7 +3538,109 @@ lesma::Value *Codegen::genFuncCall(const FuncCall *node, const std::vector<lesma
         return new Value("", class_sym->getType(), class_ptr);
     }
 
-    return new Value("", symbol->getType()->getReturnType(), Builder->CreateCall(func, paramsLLVM));
+    llvm::Value *ret = Builder->CreateCall(func, paramsLLVM);
+    // Strings go to C functions as they are, but the ones coming back don't have a length yet, unless the runtime made them
+    if (symbol->isExtern() && !symbol->isRuntime() && symbol->getType()->getReturnType()->is(TY_STRING))
+        ret = Builder->CreateCall(getStringFunction("lesma_string_from_c", Builder->getPtrTy(), {Builder->getPtrTy()}, false), {ret});
+
+    return new Value("", symbol->getType()->getReturnType(), ret);
+}
+
+llvm::Function *Codegen::getRuntimeFunction(const std::string &name, llvm::Type *returnType, llvm::ArrayRef<llvm::Type *> paramTypes) {
+    if (auto func = TheModule->getFunction(name))
+        return func;
+
+    auto func = Function::Create(FunctionType::get(returnType, paramTypes, false), Function::ExternalLinkage, name, *TheModule);
+    func->addFnAttr(Attribute::NoUnwind);
+    return func;
+}
+
+llvm::Function *Codegen::getChannelFunction(const std::string &name, llvm::Type *returnType, llvm::ArrayRef<llvm::Type *> paramTypes) {
+    auto func = getRuntimeFunction(name, returnType, paramTypes);
+    if (returnType->isIntegerTy(1))
+        func->addRetAttr(Attribute::ZExt);
+
+    return func;
+}
+
+llvm::Function *Codegen::getStringFunction(const std::string &name, llvm::Type *returnType, llvm::ArrayRef<llvm::Type *> paramTypes, bool readOnly) {
+    auto func = getRuntimeFunction(name, returnType, paramTypes);
+    func->addFnAttr(Attribute::WillReturn);
+    if (readOnly) {
+        // Only reads the strings it's given, so calls can be merged or hoisted out of loops
+        func->setOnlyReadsMemory();
+        func->setOnlyAccessesArgMemory();
+        for (unsigned int i = 0; i < paramTypes.size(); i++)
+            if (paramTypes[i]->isPointerTy())
+                func->addParamAttr(i, Attribute::NoCapture);
+    }
+    if (returnType->isIntegerTy(1))
+        func->addRetAttr(Attribute::ZExt);
+    if (returnType->isPointerTy())
+        func->addRetAttr(Attribute::NonNull);
+
+    return func;
+}
+
+llvm::Constant *Codegen::genStringLiteral(const std::string &value) {
+    // Laid out like a runtime string, the header is followed by the null terminated bytes
+    auto length = Builder->getInt64(static_cast<int64_t>(value.size()));
+    auto init = ConstantStruct::getAnon({length, length, ConstantDataArray::getString(*TheContext->getContext(), value)});
+    auto global = new GlobalVariable(*TheModule, init->getType(), true, GlobalValue::PrivateLinkage, init, ".str");
+    global->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+    global->setAlignment(Align(16));
+
+    return ConstantExpr::getInBoundsGetElementPtr(init->getType(), global, ArrayRef<llvm::Constant *>{Builder->getInt32(0), Builder->getInt32(2), Builder->getInt32(0)});
+}
+
+// Ends the current block with a call that stops the program, for errors only found at runtime
+void Codegen::genRuntimeError(const std::string &message) {
+    auto panic = getRuntimeFunction("lesma_panic", Builder->getVoidTy(), {Builder->getPtrTy()});
+    panic->addFnAttr(Attribute::NoReturn);
+    panic->addFnAttr(Attribute::Cold);
+    Builder->CreateCall(panic, {genStringLiteral(message)});
+    Builder->CreateUnreachable();
+}
+
+llvm::Function *Codegen::getAllocFunction() {
+    if (auto func = TheModule->getFunction("lesma_alloc"))
+        return func;
+
+    // Describe the runtime allocator like malloc, so LLVM can remove unused objects and reason about aliasing
+    auto func = Function::Create(FunctionType::get(Builder->getPtrTy(), {Builder->getInt64Ty()}, false), Function::ExternalLinkage, "lesma_alloc", *TheModule);
+    func->addFnAttr(Attribute::NoUnwind);
+    func->addFnAttr(Attribute::WillReturn);
+    func->addFnAttr(Attribute::InaccessibleMemOnly);
+    func->addFnAttr(Attribute::getWithAllocSizeArgs(*TheContext->getContext(), 0, None));
+    func->addFnAttr(Attribute::getWithAllocKind(*TheContext->getContext(), AllocFnKind::Alloc | AllocFnKind::Uninitialized));
+    func->addFnAttr("alloc-family", "lesma_alloc");
+    func->addRetAttr(Attribute::NoAlias);
+    func->addRetAttr(Attribute::NonNull);
+    func->addRetAttr(Attribute::getWithAlignment(*TheContext->getContext(), Align(16)));
+
+    return func;
+}
+
+llvm::Function *Codegen::getFreeFunction() {
+    if (auto func = TheModule->getFunction("lesma_free"))
+        return func;
+
+    // Paired with lesma_alloc, the pointer is deliberately not nocapture so deleting a parameter counts as an escape
+    auto func = Function::Create(FunctionType::get(Builder->getVoidTy(), {Builder->getPtrTy()}, false), Function::ExternalLinkage, "lesma_free", *TheModule);
+    func->addFnAttr(Attribute::NoUnwind);
+    func->addFnAttr(Attribute::WillReturn);
+    func->addFnAttr(Attribute::getWithAllocKind(*TheContext->getContext(), AllocFnKind::Free));
+    func->addFnAttr("alloc-family", "lesma_alloc");
+    func->addParamAttr(0, Attribute::AllocatedPointer);
+
+    return func;
+}
+
+llvm::AllocaInst *Codegen::CreateEntryBlockAlloca(llvm::Type *type, const std::string &name) {
+    // Static allocas in the entry block are allocated once per call and can be promoted by SROA
+    auto &entry = Builder->GetInsertBlock()->getParent()->getEntryBlock();
+    IRBuilder<> TmpBuilder(&entry, entry.begin());
+    return TmpBuilder.CreateAlloca(type, nullptr, name);
 }
 
 int Codegen::FindIndexInFields(Type *_struct, const std::string &field) {
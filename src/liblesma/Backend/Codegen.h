@@ -1,6 +1,8 @@
 #pragma once
 
 #include "liblesma/AST/ASTVisitor.h"
+#include "liblesma/Backend/HeapToStack.h"
+#include "liblesma/Backend/RemarkHandler.h"
 #include "liblesma/Frontend/Parser.h"
 #include "liblesma/Symbol/SymbolTable.h"
 #include <clang/Basic/Diagnostic.h>
@@ -20,30 +22,44 @@
 #include <llvm/Analysis/CGSCCPassManager.h>
 #include <llvm/Analysis/LoopAnalysisManager.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/PassManager.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Linker/Linker.h>
+#include <llvm/MC/SubtargetFeature.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/Program.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Transforms/Coroutines/CoroCleanup.h>
+#include <llvm/Transforms/Coroutines/CoroEarly.h>
+#include <llvm/Transforms/Coroutines/CoroElide.h>
+#include <llvm/Transforms/Coroutines/CoroSplit.h>
 #include <llvm/Transforms/IPO/FunctionAttrs.h>
 #include <llvm/Transforms/IPO/GlobalDCE.h>
 #include <llvm/Transforms/IPO/Inliner.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Scalar/ADCE.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
 #include <llvm/Transforms/Scalar/DeadStoreElimination.h>
+#include <llvm/Transforms/Scalar/EarlyCSE.h>
 #include <llvm/Transforms/Scalar/GVN.h>
 #include <llvm/Transforms/Scalar/LoopUnrollPass.h>
+#include <llvm/Transforms/Scalar/SROA.h>
+#include <llvm/Transforms/Scalar/SimplifyCFG.h>
 #include <llvm/Transforms/Vectorize/LoopVectorize.h>
 #include <regex>
+#include <runtime/Runtime.h>
 #include <utility>
 
 using namespace llvm;
@@ -57,10 +73,36 @@ namespace lesma {
 
     using MainFnTy = int();
 
+    /**
+     * Frame of the async function being defined. The promise starts like lesma_coroutine and is followed by the
+     * promise of the coroutine awaiting this one and the result, returning branches to the final block.
+     */
+    struct Coroutine {
+        llvm::Value *id = nullptr;
+        llvm::Value *handle = nullptr;
+        llvm::AllocaInst *promise = nullptr;
+        llvm::BasicBlock *finalBlock = nullptr;
+        llvm::BasicBlock *cleanupBlock = nullptr;
+        llvm::BasicBlock *suspendBlock = nullptr;
+    };
+
+    /**
+     * Statement deferred until the function returns, it's evaluated in the scope it was deferred in. Statements
+     * deferred in nested blocks only run if the block was reached, which is recorded in a flag.
+     */
+    struct Deferred {
+        Statement *statement;
+        SymbolTable *scope;
+        llvm::AllocaInst *reached = nullptr;
+    };
+
     class Codegen final : public ASTVisitor {
         std::shared_ptr<ThreadSafeContext> TheContext;
         std::unique_ptr<Module> TheModule;
         std::unique_ptr<IRBuilder<>> Builder;
+        std::unique_ptr<DIBuilder> DBuilder;
+        DIFile *DebugFile = nullptr;
+        std::unique_ptr<ToolOutputFile> RemarksFile;
 
         std::unique_ptr<LLJIT> TheJIT;
         std::unique_ptr<llvm::TargetMachine> TargetMachine;
@@ -69,12 +111,18 @@ namespace lesma {
         SymbolTable *Scope;
         std::string filename;
         std::string alias;
+        unsigned int bufferId;
         lesma::Value *result = nullptr;
 
         std::stack<llvm::BasicBlock *> breakBlocks;
         std::stack<llvm::BasicBlock *> continueBlocks;
-        std::stack<std::vector<Statement *>> deferStack;
+        std::stack<std::vector<Deferred>> deferStack;
+        std::stack<std::vector<llvm::AllocaInst *>> lifetimeScopes;
+        std::stack<unsigned int> loopRegionDepths;
+        unsigned int regionDepth = 0;
         lesma::Value *currentFunction = nullptr;
+        Coroutine coroutine;
+        const FuncCall *awaitedCall = nullptr;
 
         std::vector<std::string> ObjectFiles;
         std::vector<std::string> ImportedModules;
@@ -87,6 +135,9 @@ namespace lesma {
         bool isAssignment = false;
         bool isJIT = false;
         bool isMain = true;
+        bool isStd = false;
+        // Only the prototypes are generated, for an import whose compiled module is already cached
+        bool declarationsOnly = false;
 
     public:
         Codegen(std::shared_ptr<Parser> parser, std::shared_ptr<SourceMgr> srcMgr, const std::string &filename, std::vector<std::string> imports, bool jit, bool main, std::string alias = "", const std::shared_ptr<ThreadSafeContext> & = nullptr);
@@ -96,6 +147,8 @@ namespace lesma {
         }
 
         void Dump();
+        void EnableDebugInfo();
+        void EnableRemarks(const RemarkOptions &options);
         void Run();
         void PrepareJIT();
         int ExecuteJIT();
@@ -103,10 +156,27 @@ namespace lesma {
         void LinkObjectFile(const std::string &obj_filename);
         void Optimize(OptimizationLevel opt);
 
+        [[nodiscard]] const Module *getModule() const { return TheModule.get(); }
+
+        // Function the main module exports, its signature given as mangled type names
+        struct ExportedFunction {
+            std::string name;
+            std::string symbol;
+            std::vector<std::string> paramTypes;
+            std::string returnType;
+        };
+
+        // Has to be called after Run and before PrepareJIT hands the module to the JIT
+        std::vector<ExportedFunction> getExportedFunctions();
+        // Address of a symbol once the module was added to the JIT, nullptr if it doesn't exist
+        void *getSymbolAddress(const std::string &symbol);
+
     protected:
         std::unique_ptr<llvm::TargetMachine> InitializeTargetMachine();
         std::unique_ptr<Module> InitializeModule();
         std::unique_ptr<LLJIT> InitializeJIT();
+        llvm::orc::JITTargetMachineBuilder InitializeJITTargetMachineBuilder();
+        std::unique_ptr<llvm::MemoryBuffer> CompileForJIT();
         llvm::Function *InitializeTopLevel();
 
         [[maybe_unused]] void LinkObjectFileWithClang(const std::string &obj_filename);
@@ -119,6 +189,8 @@ namespace lesma {
         void visit(const VarDecl *node) override;
         void visit(const If *node) override;
         void visit(const While *node) override;
+        void visit(const For *node) override;
+        void visit(const Select *node) override;
         void visit(const Import *node) override;
         void visit(const Enum *node) override;
         void visit(const Class *node) override;
@@ -129,6 +201,8 @@ namespace lesma {
         void visit(const Continue *node) override;
         void visit(const Return *node) override;
         void visit(const Defer *node) override;
+        void visit(const Region *node) override;
+        void visit(const Delete *node) override;
         void visit(const ExpressionStatement *node) override;
 
         void visit(const Expression *node) override;
@@ -136,6 +210,13 @@ namespace lesma {
         void visit(const BinaryOp *node) override;
         void visit(const DotOp *node) override;
         void visit(const CastOp *node) override;
+        void visit(const Slice *node) override;
+        void visit(const Interpolation *node) override;
+        void visit(const Spawn *node) override;
+        void visit(const Join *node) override;
+        void visit(const Await *node) override;
+        void visit(const NewChannel *node) override;
+        void visit(const NewAtomic *node) override;
         void visit(const IsOp *node) override;
         void visit(const UnaryOp *node) override;
         void visit(const Literal *node) override;
@@ -157,8 +238,44 @@ namespace lesma {
 
         // Other
         lesma::Value *genFuncCall(const FuncCall *node, const std::vector<lesma::Value *> &extra_params);
+        llvm::Function *getRuntimeFunction(const std::string &name, llvm::Type *returnType, llvm::ArrayRef<llvm::Type *> paramTypes);
+        llvm::Function *getChannelFunction(const std::string &name, llvm::Type *returnType, llvm::ArrayRef<llvm::Type *> paramTypes);
+        llvm::Function *getStringFunction(const std::string &name, llvm::Type *returnType, llvm::ArrayRef<llvm::Type *> paramTypes, bool readOnly);
+        llvm::Constant *genStringLiteral(const std::string &value);
+        void genRuntimeError(const std::string &message);
+        void genDeferred();
+        llvm::Value *genStringLength(llvm::Value *str);
+        llvm::Function *genTaskFunction(lesma::Value *symbol, llvm::StructType *envType);
+        void genChannelFor(const For *node);
+        lesma::Value *genChannelMethod(const FuncCall *method, lesma::Value *channel);
+        lesma::Value *genAtomicMethod(const FuncCall *method, lesma::Value *atomic);
+        llvm::Value *genAtomicOperand(Expression *expr, lesma::Type *type);
+        llvm::AtomicOrdering getAtomicOrdering(const std::vector<Expression *> &args, unsigned int index, llvm::AtomicOrdering fallback);
+        void genParallelFor(const For *node, lesma::Type *type, llvm::Value *startVal, llvm::Value *endVal, llvm::Value *stepVal);
+        llvm::Function *genParallelBody(const For *node, lesma::Type *type, llvm::StructType *envType, llvm::StructType *partialType,
+                                        const std::vector<lesma::Value *> &captured, const std::vector<lesma::Value *> &reduced);
+        llvm::Constant *genReductionIdentity(const std::string &op, llvm::Type *type);
+        llvm::Value *genReduction(const std::string &op, llvm::Value *left, llvm::Value *right);
+        llvm::StructType *getPromiseType(lesma::Type *type);
+        llvm::Function *getResumeFunction();
+        void genCoroutineBegin(llvm::Function *F, lesma::Type *type);
+        void genSuspend(llvm::Value *save, llvm::BasicBlock *resume);
+        void genDetach(lesma::Value *future);
+        lesma::Value *genAwaitExtern(const FuncCall *node, lesma::Value *symbol, llvm::Function *func, const std::vector<llvm::Value *> &args);
+        llvm::Function *getAllocFunction();
+        llvm::Function *getFreeFunction();
+        void exitRegions(unsigned int count);
+        llvm::AllocaInst *CreateEntryBlockAlloca(llvm::Type *type, const std::string &name = "");
+        lesma::Value *genLogicalOp(const BinaryOp *node);
+        lesma::Value *genStringOp(const BinaryOp *node, lesma::Value *left, lesma::Value *right);
+        lesma::Value *genPower(lesma::Value *base, lesma::Value *exponent);
+        llvm::Function *getIntegerPowerFunction(llvm::Type *type);
         static int FindIndexInFields(Type *_struct, const std::string &field);
         static lesma::Type *FindTypeInFields(Type *_struct, const std::string &field);
         void defineFunction(lesma::Value *value, const FuncDecl *node, Value *clsSymbol);
+
+        // Debug information
+        DISubprogram *CreateSubprogram(llvm::Function *F, const AST *node);
+        void EmitLocation(const AST *node);
     };
 }// namespace lesma
\ No newline at end of file
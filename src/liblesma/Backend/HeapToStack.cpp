@@ -0,0 +1,127 @@
+#include "HeapToStack.h"
+
+#include <llvm/Analysis/OptimizationRemarkEmitter.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+
+using namespace lesma;
+using namespace llvm;
+
+static const char *PassName = "heap-to-stack";
+
+/**
+ * Walks every use of the allocation, returns the first instruction that lets the pointer escape or nullptr.
+ * Besides the usual captures, phis and selects are rejected, they could carry the object of a previous loop
+ * iteration into the next one while both would share the same stack slot. Deletes of the object are collected
+ * in frees, they have to go away with the allocation.
+ */
+static const Instruction *findEscape(const CallInst *alloc, const Function *deallocator, SmallVectorImpl<CallInst *> &frees) {
+    SmallVector<const Value *, 8> worklist = {alloc};
+    SmallPtrSet<const Value *, 8> visited;
+
+    while (!worklist.empty()) {
+        auto value = worklist.pop_back_val();
+        if (!visited.insert(value).second)
+            continue;
+
+        for (const Use &use: value->uses()) {
+            auto user = cast<Instruction>(use.getUser());
+
+            if (isa<LoadInst>(user))
+                continue;
+            if (auto store = dyn_cast<StoreInst>(user)) {
+                if (store->getValueOperand() == value)
+                    return user;
+                continue;
+            }
+            if (isa<GetElementPtrInst>(user)) {
+                worklist.push_back(user);
+                continue;
+            }
+            if (auto intrinsic = dyn_cast<IntrinsicInst>(user); intrinsic != nullptr && intrinsic->isLifetimeStartOrEnd())
+                continue;
+            if (auto call = dyn_cast<CallBase>(user)) {
+                if (deallocator != nullptr && call->getCalledFunction() == deallocator && value == alloc && isa<CallInst>(call)) {
+                    frees.push_back(cast<CallInst>(call));
+                    continue;
+                }
+                if (call->isArgOperand(&use) && call->doesNotCapture(call->getArgOperandNo(&use)))
+                    continue;
+                return user;
+            }
+
+            return user;
+        }
+    }
+
+    return nullptr;
+}
+
+PreservedAnalyses HeapToStackPass::run(Function &F, FunctionAnalysisManager &FAM) {
+    auto allocator = F.getParent()->getFunction("lesma_alloc");
+    auto deallocator = F.getParent()->getFunction("lesma_free");
+    if (allocator == nullptr || F.isDeclaration())
+        return PreservedAnalyses::all();
+
+    SmallVector<CallInst *, 8> allocations;
+    for (auto user: allocator->users())
+        if (auto call = dyn_cast<CallInst>(user); call != nullptr && call->getFunction() == &F && call->getCalledFunction() == allocator)
+            allocations.push_back(call);
+
+    if (allocations.empty())
+        return PreservedAnalyses::all();
+
+    auto &ORE = FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+    auto &entry = F.getEntryBlock();
+    bool changed = false;
+
+    for (auto call: allocations) {
+        auto size = dyn_cast<ConstantInt>(call->getArgOperand(0));
+        if (size == nullptr || size->getZExtValue() > MaxObjectSize) {
+            ORE.emit([&]() {
+                return OptimizationRemarkMissed(PassName, "TooLarge", call)
+                       << "object is too large or has an unknown size, it stays on the heap";
+            });
+            continue;
+        }
+
+        SmallVector<CallInst *, 2> frees;
+        if (auto escape = findEscape(call, deallocator, frees)) {
+            ORE.emit([&]() {
+                return OptimizationRemarkMissed(PassName, "Escapes", call)
+                       << "object escapes through " << ore::NV("Instruction", escape->getOpcodeName()) << ", it stays on the heap";
+            });
+            continue;
+        }
+
+        // Same alignment as the runtime allocator, the slot lives once per call in the entry block
+        IRBuilder<> EntryBuilder(&entry, entry.begin());
+        auto slot = EntryBuilder.CreateAlloca(ArrayType::get(EntryBuilder.getInt8Ty(), size->getZExtValue()), nullptr, call->getName() + ".stack");
+        slot->setAlignment(Align(16));
+
+        IRBuilder<> Builder(call);
+        Builder.CreateLifetimeStart(slot, size);
+
+        ORE.emit([&]() {
+            return OptimizationRemark(PassName, "Demoted", call)
+                   << "object of " << ore::NV("Size", size->getZExtValue()) << " bytes moved to the stack";
+        });
+
+        for (auto free: frees) {
+            IRBuilder<>(free).CreateLifetimeEnd(slot, size);
+            free->eraseFromParent();
+        }
+
+        call->replaceAllUsesWith(slot);
+        call->eraseFromParent();
+        changed = true;
+    }
+
+    if (!changed)
+        return PreservedAnalyses::all();
+
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    return PA;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <llvm/IR/PassManager.h>
+
+namespace lesma {
+    /**
+     * Moves class instances allocated with `lesma_alloc` to the stack of the function creating them when they
+     * never escape it. Every allocation site is reported as an optimization remark under `heap-to-stack`.
+     */
+    class HeapToStackPass : public llvm::PassInfoMixin<HeapToStackPass> {
+    public:
+        // Larger objects stay on the heap so deep recursion doesn't overflow the stack
+        static constexpr uint64_t MaxObjectSize = 4096;
+
+        llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+        static llvm::StringRef name() { return "heap-to-stack"; }
+    };
+}// namespace lesma
@@ -0,0 +1,67 @@
+#include "RemarkHandler.h"
+
+#include "liblesma/Common/LesmaError.h"
+#include "liblesma/Common/Utils.h"
+
+using namespace lesma;
+
+static std::unique_ptr<llvm::Regex> compileFilter(const std::string &pattern) {
+    if (pattern.empty())
+        return nullptr;
+
+    auto regex = std::make_unique<llvm::Regex>(pattern);
+    std::string error;
+    if (!regex->isValid(error))
+        throw LesmaError(llvm::SMRange(), "Invalid optimization remark filter {}: {}", pattern, error);
+
+    return regex;
+}
+
+RemarkHandler::RemarkHandler(llvm::SourceMgr *srcMgr, unsigned int bufferId, std::string file, const RemarkOptions &options)
+    : srcMgr(srcMgr), bufferId(bufferId), file(std::move(file)),
+      passed(compileFilter(options.passed)), missed(compileFilter(options.missed)), analysis(compileFilter(options.analysis)) {}
+
+bool RemarkHandler::handleDiagnostics(const llvm::DiagnosticInfo &DI) {
+    auto *remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&DI);
+    if (remark == nullptr)
+        return false;
+
+    std::string kind;
+    if (llvm::isa<llvm::OptimizationRemark>(remark) && isPassedOptRemarkEnabled(remark->getPassName()))
+        kind = "pass";
+    else if (llvm::isa<llvm::OptimizationRemarkMissed>(remark) && isMissedOptRemarkEnabled(remark->getPassName()))
+        kind = "pass-missed";
+    else if (llvm::isa<llvm::OptimizationRemarkAnalysis>(remark) && isAnalysisRemarkEnabled(remark->getPassName()))
+        kind = "pass-analysis";
+    else
+        return true;
+
+    // Only code compiled with debug info can be mapped back to the source, i.e. the main module
+    if (!remark->isLocationAvailable())
+        return true;
+
+    auto location = remark->getLocation();
+    auto loc = srcMgr->FindLocForLineAndColumn(bufferId, location.getLine(), location.getColumn());
+    if (!loc.isValid())
+        return true;
+
+    auto reason = fmt::format("{} [-R{}={}]", remark->getMsg(), kind, remark->getPassName().str());
+    showInline(srcMgr, bufferId, llvm::SMRange(loc, llvm::SMLoc::getFromPointer(loc.getPointer() + 1)), reason, file, false);
+    return true;
+}
+
+bool RemarkHandler::isAnalysisRemarkEnabled(llvm::StringRef PassName) const {
+    return analysis != nullptr && analysis->match(PassName);
+}
+
+bool RemarkHandler::isMissedOptRemarkEnabled(llvm::StringRef PassName) const {
+    return missed != nullptr && missed->match(PassName);
+}
+
+bool RemarkHandler::isPassedOptRemarkEnabled(llvm::StringRef PassName) const {
+    return passed != nullptr && passed->match(PassName);
+}
+
+bool RemarkHandler::isAnyRemarkEnabled() const {
+    return passed != nullptr || missed != nullptr || analysis != nullptr;
+}
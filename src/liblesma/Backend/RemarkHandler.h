@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/SourceMgr.h>
+
+namespace lesma {
+    struct RemarkOptions {
+        // Regular expressions matched against the pass names, empty if the kind is disabled
+        std::string passed;
+        std::string missed;
+        std::string analysis;
+        // YAML file that receives every remark, empty if disabled
+        std::string filename;
+
+        [[nodiscard]] bool isEnabled() const { return !passed.empty() || !missed.empty() || !analysis.empty() || !filename.empty(); }
+        [[nodiscard]] bool isRendered() const { return !passed.empty() || !missed.empty() || !analysis.empty(); }
+    };
+
+    /**
+     * Diagnostic handler rendering LLVM optimization remarks with their debug location mapped back
+     * to the Lesma source, the same way compiler errors are shown.
+     */
+    class RemarkHandler : public llvm::DiagnosticHandler {
+        llvm::SourceMgr *srcMgr;
+        unsigned int bufferId;
+        std::string file;
+        std::unique_ptr<llvm::Regex> passed;
+        std::unique_ptr<llvm::Regex> missed;
+        std::unique_ptr<llvm::Regex> analysis;
+
+    public:
+        RemarkHandler(llvm::SourceMgr *srcMgr, unsigned int bufferId, std::string file, const RemarkOptions &options);
+
+        bool handleDiagnostics(const llvm::DiagnosticInfo &DI) override;
+        bool isAnalysisRemarkEnabled(llvm::StringRef PassName) const override;
+        bool isMissedOptRemarkEnabled(llvm::StringRef PassName) const override;
+        bool isPassedOptRemarkEnabled(llvm::StringRef PassName) const override;
+        bool isAnyRemarkEnabled() const override;
+    };
+}// namespace lesma
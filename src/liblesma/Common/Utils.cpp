@@ -43,14 +43,27 @@ namespace lesma {
         }
     }
 
-    std::string getStdDir() {
-        std::string homedir;
+    // Looked up once per process, getpwuid isn't reentrant and compilations can run on several threads
+    static const std::string &getLesmaDir() {
+        static const std::string lesmaDir = [] {
+            std::string homedir;
+
+            if (getenv("HOME"))
+                homedir = getenv("HOME");
+            else
+                homedir = getpwuid(getuid())->pw_dir;
 
-        if (getenv("HOME"))
-            homedir = getenv("HOME");
-        else
-            homedir = getpwuid(getuid())->pw_dir;
+            return homedir + "/.lesma/";
+        }();
+
+        return lesmaDir;
+    }
+
+    std::string getStdDir() {
+        return getLesmaDir() + "stdlib/";
+    }
 
-        return homedir + "/.lesma/stdlib/";
+    std::string getRuntimeDir() {
+        return getLesmaDir() + "lib/";
     }
 }// namespace lesma
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <pwd.h>
 #include <sstream>
 #include <unistd.h>
+#include <vector>
 
 #include "llvm/Support/SMLoc.h"
 #include "llvm/Support/SourceMgr.h"
@@ -29,6 +30,13 @@ namespace lesma {
         bool debug;
         bool timer;
         bool jit;
+        std::string stats;
+        std::string stats_file;
+        std::vector<std::string> remarks;
+        std::string remarks_file;
+        bool server;
+        bool client;
+        std::string socket;
     };
 
     template<typename S, typename... Args>
@@ -53,4 +61,5 @@ namespace lesma {
     void showInline(llvm::SourceMgr *srcMgr, unsigned int bufferId, llvm::SMRange span, const std::string &reason, const std::string &file, bool is_error);
     std::string getBasename(const std::string &file_path);
     std::string getStdDir();
+    std::string getRuntimeDir();
 }// namespace lesma
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "Server.h"
+
+#include <filesystem>
+
+#include "liblesma/Driver/Protocol.h"
+
+extern char **environ;
+
+using namespace lesma;
+using namespace lesma::protocol;
+
+std::optional<int> Client::Forward(const std::string &socketPath, const std::vector<std::string> &args) {
+    int connection = connectTo(socketPath);
+    if (connection < 0)
+        return std::nullopt;
+
+    std::string body = std::filesystem::current_path().string();
+    body.push_back('\0');
+    for (const auto &arg: args) {
+        body.append(arg);
+        body.push_back('\0');
+    }
+    for (char **variable = environ; *variable != nullptr; variable++) {
+        body.append(*variable);
+        body.push_back('\0');
+    }
+
+    RequestHeader header{static_cast<uint32_t>(body.size()), static_cast<uint32_t>(args.size())};
+    int streams[STREAMS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(streams))] = {};
+    iovec data{&header, sizeof(header)};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    auto *descriptors = CMSG_FIRSTHDR(&message);
+    descriptors->cmsg_level = SOL_SOCKET;
+    descriptors->cmsg_type = SCM_RIGHTS;
+    descriptors->cmsg_len = CMSG_LEN(sizeof(streams));
+    std::memcpy(CMSG_DATA(descriptors), streams, sizeof(streams));
+
+    ssize_t count;
+    do {
+        count = sendmsg(connection, &message, SEND_FLAGS);
+    } while (count < 0 && errno == EINTR);
+
+    int32_t code;
+    bool answered = count == sizeof(header) && writeAll(connection, body.data(), body.size()) && readAll(connection, &code, sizeof(code));
+    close(connection);
+
+    if (!answered)
+        throw LesmaError(llvm::SMRange(), "The server on {} closed the connection before the request finished", socketPath);
+    return code;
+}
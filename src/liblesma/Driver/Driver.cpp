@@ -5,10 +5,12 @@
 using namespace lesma;
 
 #define TIMEIT(debug_operation, statements)   \
+    stats.BeginStage();                       \
     timer.start();                            \
     statements                                \
             results = timer.get_elapsed_ms(); \
     total += results;                         \
+    stats.EndStage(debug_operation, results); \
     if (options->timer)                       \
         print(DEBUG, "{} -> {:.2f} ms\n", debug_operation, results);
 
@@ -18,6 +20,9 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
     plf::nanotimer timer;
     double results, total = 0;
 
+    // Configure Statistics
+    Statistics stats(options->stats);
+
     // Configure Source Manager
     std::shared_ptr<llvm::SourceMgr> srcMgr = std::make_shared<llvm::SourceMgr>(llvm::SourceMgr());
 
@@ -36,11 +41,13 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
                     auto buffer = llvm::MemoryBuffer::getMemBuffer(options->source);
                     srcMgr->AddNewSourceBuffer(std::move(buffer), llvm::SMLoc());
                 })
+        stats.Record("bytes_read", srcMgr->getMemoryBuffer(1)->getBufferSize());
 
         // Lexer
         TIMEIT("Lexer scan",
                auto lexer = std::make_unique<Lexer>(srcMgr);
                lexer->ScanAll();)
+        stats.Record("tokens", lexer->getTokens().size());
 
         if (options->debug & LEXER) {
             print(DEBUG, "TOKENS: \n");
@@ -52,6 +59,7 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
         TIMEIT("Parsing",
                auto parser = std::make_unique<Parser>(lexer->getTokens());
                parser->Parse();)
+        stats.RecordAST(parser->getAST());
 
         if (options->debug & AST)
             print(DEBUG, "AST:\n{}", parser->getAST()->toString(srcMgr.get(), "", true));
@@ -62,7 +70,9 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
                auto codegen = std::make_unique<Codegen>(std::move(parser), srcMgr,
                                                         options->sourceType == FILE ? options->source : "",
                                                         modules, jit, true);
+               codegen->EnableRemarks(options->remarks);
                codegen->Run();)
+        stats.RecordModule(codegen->getModule());
 
         if (options->debug & IR) {
             print(DEBUG, "LLVM IR: \n");
@@ -71,14 +81,21 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
 
         // Optimization
         TIMEIT("Optimizing", codegen->Optimize(OptimizationLevel::O3);)
+        stats.RecordModule(codegen->getModule());
 
         int exit_code = 0;
         if (!jit) {
             // Compile to Object File
             TIMEIT("Writing Object File", codegen->WriteToObjectFile(options->output_filename);)
+            uint64_t object_size;
+            if (!llvm::sys::fs::file_size(fmt::format("{}.o", options->output_filename), object_size))
+                stats.Record("object_bytes", object_size);
 
             // Link Object File
             TIMEIT("Linking Object File", codegen->LinkObjectFile(fmt::format("{}.o", options->output_filename));)
+            uint64_t executable_size;
+            if (!llvm::sys::fs::file_size(options->output_filename, executable_size))
+                stats.Record("executable_bytes", executable_size);
         } else {
             // Executing
             TIMEIT("JIT", codegen->PrepareJIT();)
@@ -88,6 +105,8 @@ int Driver::BaseCompile(std::unique_ptr<lesma::Options> options, bool jit) {
         if (options->timer)
             print(DEBUG, "Total -> {:.2f} ms\n", total);
 
+        stats.Report(options->source, jit, total, options->stats_filename);
+
         return exit_code;
     } catch (const LesmaError &err) {
         if (!err.getSpan().isValid())
@@ -5,6 +5,7 @@
 
 #include "liblesma/Backend/Codegen.h"
 #include "liblesma/Common/Utils.h"
+#include "liblesma/Driver/Statistics.h"
 #include "liblesma/Frontend/Lexer.h"
 #include "liblesma/Frontend/Parser.h"
 
@@ -29,8 +30,13 @@ namespace lesma {
         Debug debug = NONE;
         std::string output_filename = "output";
         bool timer = false;
+        StatsFormat stats = StatsFormat::NONE;
+        std::string stats_filename;
+        RemarkOptions remarks;
     };
 
+    // Run and Compile can be called from several threads at once, every call gets its own LLVM context and JIT.
+    // Statistic counters are shared by the process, so with --stats they also count concurrent compilations.
     class Driver {
     private:
         static int BaseCompile(std::unique_ptr<lesma::Options> options, bool jit);
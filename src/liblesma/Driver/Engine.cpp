@@ -0,0 +1,63 @@
+#include "Engine.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+using namespace lesma;
+
+std::unique_ptr<Engine> Engine::FromSource(const std::string &source) {
+    auto srcMgr = std::make_shared<llvm::SourceMgr>();
+    srcMgr->AddNewSourceBuffer(llvm::MemoryBuffer::getMemBufferCopy(source), llvm::SMLoc());
+
+    return std::unique_ptr<Engine>(new Engine(srcMgr, ""));
+}
+
+std::unique_ptr<Engine> Engine::FromFile(const std::string &path) {
+    auto buffer = llvm::MemoryBuffer::getFileAsStream(path);
+    if (!buffer)
+        throw LesmaError(llvm::SMRange(), "Could not read file: {}", path);
+
+    auto srcMgr = std::make_shared<llvm::SourceMgr>();
+    srcMgr->AddNewSourceBuffer(std::move(*buffer), llvm::SMLoc());
+
+    return std::unique_ptr<Engine>(new Engine(srcMgr, path));
+}
+
+Engine::Engine(std::shared_ptr<llvm::SourceMgr> srcMgr_, const std::string &filename) : srcMgr(std::move(srcMgr_)) {
+    try {
+        lexer = std::make_unique<Lexer>(srcMgr);
+        lexer->ScanAll();
+
+        auto parser = std::make_unique<Parser>(lexer->getTokens());
+        parser->Parse();
+
+        codegen = std::make_unique<Codegen>(std::move(parser), srcMgr, filename, std::vector<std::string>{}, true, true);
+        codegen->Run();
+        exported = codegen->getExportedFunctions();
+    } catch (const LesmaError &err) {
+        // The source goes away with the engine, so the error carries its position in the message instead
+        if (!err.getSpan().isValid() || srcMgr->FindBufferContainingLoc(err.getSpan().Start) != 1)
+            throw;
+        auto [line, column] = srcMgr->getLineAndColumn(err.getSpan().Start, 1);
+        throw LesmaError(llvm::SMRange(), "{}:{}:{}: {}", filename.empty() ? "<source>" : filename, line, column, err.what());
+    }
+
+    codegen->Optimize(OptimizationLevel::O3);
+    codegen->PrepareJIT();
+
+    // The top level runs once, so the functions find the module as it would be after an import
+    codegen->ExecuteJIT();
+}
+
+void *Engine::lookup(const std::string &name, const std::vector<std::string> &paramTypes, const std::string &returnType) {
+    for (const auto &function: exported) {
+        if (function.name != name || function.paramTypes != paramTypes || function.returnType != returnType)
+            continue;
+
+        auto address = codegen->getSymbolAddress(function.symbol);
+        if (address == nullptr)
+            throw LesmaError(llvm::SMRange(), "Function {} was exported but not compiled", name);
+        return address;
+    }
+
+    throw LesmaError(llvm::SMRange(), "No exported function {}({}) -> {}", name, llvm::join(paramTypes, ", "), returnType);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "liblesma/Backend/Codegen.h"
+#include "liblesma/Common/LesmaError.h"
+#include "liblesma/Frontend/Lexer.h"
+#include "liblesma/Frontend/Parser.h"
+
+#include "llvm/Support/SourceMgr.h"
+
+namespace lesma {
+    // Mangled name of the Lesma type a C++ type is passed as
+    template<typename T>
+    struct MangledType;
+
+    template<>
+    struct MangledType<void> {
+        static constexpr const char *name = "void";
+    };
+    template<>
+    struct MangledType<bool> {
+        static constexpr const char *name = "b";
+    };
+    template<>
+    struct MangledType<int8_t> {
+        static constexpr const char *name = "c";
+    };
+    template<>
+    struct MangledType<int16_t> {
+        static constexpr const char *name = "i16";
+    };
+    template<>
+    struct MangledType<int32_t> {
+        static constexpr const char *name = "i32";
+    };
+    template<>
+    struct MangledType<int64_t> {
+        static constexpr const char *name = "i";
+    };
+    template<>
+    struct MangledType<float> {
+        static constexpr const char *name = "f32";
+    };
+    template<>
+    struct MangledType<double> {
+        static constexpr const char *name = "f";
+    };
+
+    template<typename Signature>
+    class Function;
+
+    /**
+     * Handle to a compiled Lesma function, calling it is an indirect call through the address the JIT resolved once.
+     * It's valid as long as the Engine it came from, and can be called from any number of threads at once.
+     */
+    template<typename Ret, typename... Args>
+    class Function<Ret(Args...)> {
+    public:
+        using Pointer = Ret (*)(Args...);
+
+        Function() = default;
+        explicit Function(Pointer pointer) : pointer(pointer) {}
+
+        Ret operator()(Args... args) const { return pointer(args...); }
+
+        [[nodiscard]] Pointer get() const { return pointer; }
+        explicit operator bool() const { return pointer != nullptr; }
+
+    private:
+        Pointer pointer = nullptr;
+    };
+
+    /**
+     * Compiles a Lesma module once and hands out the functions it exports. The top level statements of the module
+     * run once, when it's loaded. Compile errors are thrown as LesmaError, like every other stage of the compiler.
+     *
+     *     auto engine = lesma::Engine::FromSource("export def add(a: int, b: int) -> int\n    return a + b\n");
+     *     auto add = engine->get<int64_t(int64_t, int64_t)>("add");
+     *     int64_t three = add(1, 2);
+     */
+    class Engine {
+    public:
+        static std::unique_ptr<Engine> FromSource(const std::string &source);
+        static std::unique_ptr<Engine> FromFile(const std::string &path);
+
+        /**
+         * Find an exported function by its name and its signature, a C++ function type whose types match the
+         * parameters and the return type of the Lesma function. Throws if there isn't one.
+         */
+        template<typename Signature>
+        Function<Signature> get(const std::string &name) {
+            return Function<Signature>(reinterpret_cast<typename Function<Signature>::Pointer>(lookup(name, static_cast<Signature *>(nullptr))));
+        }
+
+        [[nodiscard]] const std::vector<Codegen::ExportedFunction> &getExportedFunctions() const { return exported; }
+
+    private:
+        Engine(std::shared_ptr<llvm::SourceMgr> srcMgr, const std::string &filename);
+
+        template<typename Ret, typename... Args>
+        void *lookup(const std::string &name, Ret (*)(Args...)) {
+            return lookup(name, {MangledType<Args>::name...}, MangledType<Ret>::name);
+        }
+        void *lookup(const std::string &name, const std::vector<std::string> &paramTypes, const std::string &returnType);
+
+        std::shared_ptr<llvm::SourceMgr> srcMgr;
+        std::unique_ptr<Lexer> lexer;
+        std::unique_ptr<Codegen> codegen;
+        std::vector<Codegen::ExportedFunction> exported;
+    };
+}// namespace lesma
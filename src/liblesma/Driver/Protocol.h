@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <pwd.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "liblesma/Common/LesmaError.h"
+
+// Requests between lesma server and its clients, header only so the thin client doesn't link the compiler
+namespace lesma::protocol {
+    // Sent along with the standard streams of the client, followed by the working directory, the arguments and the
+    // environment as NUL terminated strings. The server answers with the exit code as an int32_t.
+    struct RequestHeader {
+        uint32_t size;
+        uint32_t arguments;
+    };
+
+    constexpr uint32_t MAX_REQUEST_SIZE = 1 << 24;
+    constexpr int STREAMS = 3;
+
+#ifdef MSG_NOSIGNAL
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+
+    // Where lesma server listens unless it's given a socket, in the .lesma directory of the user
+    inline std::string defaultSocketPath() {
+        const char *home = getenv("HOME");
+        return std::string(home != nullptr ? home : getpwuid(getuid())->pw_dir) + "/.lesma/server.sock";
+    }
+
+    inline bool readAll(int fd, void *data, size_t size) {
+        auto *bytes = static_cast<char *>(data);
+        while (size > 0) {
+            auto count = read(fd, bytes, size);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            bytes += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    inline bool writeAll(int fd, const void *data, size_t size) {
+        const auto *bytes = static_cast<const char *>(data);
+        while (size > 0) {
+            auto count = send(fd, bytes, size, SEND_FLAGS);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            bytes += count;
+            size -= count;
+        }
+        return true;
+    }
+
+    inline sockaddr_un socketAddress(const std::string &socketPath) {
+        sockaddr_un address{};
+        if (socketPath.size() >= sizeof(address.sun_path))
+            throw LesmaError(llvm::SMRange(), "Socket path is too long: {}", socketPath);
+
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        return address;
+    }
+
+    // Connected socket, or -1 if no server listens on socketPath
+    inline int connectTo(const std::string &socketPath) {
+        auto address = socketAddress(socketPath);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            throw LesmaError(llvm::SMRange(), "Could not create a socket: {}", std::strerror(errno));
+
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}// namespace lesma::protocol
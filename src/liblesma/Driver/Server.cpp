@@ -0,0 +1,371 @@
+#include "Server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <utility>
+
+#include "liblesma/Backend/Codegen.h"
+#include "liblesma/Common/Utils.h"
+#include "liblesma/Driver/Protocol.h"
+#include "liblesma/Frontend/Lexer.h"
+#include "liblesma/Frontend/Parser.h"
+
+extern char **environ;
+
+using namespace lesma;
+using namespace lesma::protocol;
+
+namespace {
+    struct Request {
+        std::string directory;
+        std::vector<std::string> args;
+        std::vector<std::string> environment;
+        int streams[STREAMS] = {-1, -1, -1};
+    };
+
+    struct Running {
+        int connection;
+        bool killed;
+    };
+
+    // Signal handlers only write the signal to this pipe, the accept loop handles it
+    int signalPipe[2] = {-1, -1};
+
+    void onSignal(int signal) {
+        auto saved = errno;
+        auto byte = static_cast<char>(signal);
+        [[maybe_unused]] auto written = write(signalPipe[1], &byte, 1);
+        errno = saved;
+    }
+
+    int listenOn(const std::string &socketPath) {
+        // A socket file nobody accepts on is left over from a server that didn't shut down
+        int existing = connectTo(socketPath);
+        if (existing >= 0) {
+            close(existing);
+            throw LesmaError(llvm::SMRange(), "A server is already listening on {}", socketPath);
+        }
+        unlink(socketPath.c_str());
+
+        // Requests run with the rights of the server, so only its user may connect. The socket is created with those
+        // permissions, changing them after bind would leave a moment where anyone can connect.
+        auto address = socketAddress(socketPath);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        auto mask = umask(0077);
+        bool bound = fd >= 0 && bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+        umask(mask);
+        if (!bound || listen(fd, SOMAXCONN) != 0) {
+            auto error = std::strerror(errno);
+            if (fd >= 0)
+                close(fd);
+            throw LesmaError(llvm::SMRange(), "Could not listen on {}: {}", socketPath, error);
+        }
+        return fd;
+    }
+
+    // Compiles a small program importing the whole standard library without running it, so the lazily initialized
+    // parts of LLVM and the compiled standard library modules are ready before the first fork. Requests only
+    // generate the declarations of what they import from it and link the objects compiled here.
+    void warmUp() {
+        auto srcMgr = std::make_shared<llvm::SourceMgr>();
+        srcMgr->AddNewSourceBuffer(llvm::MemoryBuffer::getMemBufferCopy("import aio\n"
+                                                                        "import io\n"
+                                                                        "import math\n"
+                                                                        "import net\n"
+                                                                        "import time\n"
+                                                                        "\n"
+                                                                        "def square(x: int) -> int\n"
+                                                                        "    return x * x\n"
+                                                                        "print(square(2))\n"),
+                                   llvm::SMLoc());
+
+        auto lexer = std::make_unique<Lexer>(srcMgr);
+        lexer->ScanAll();
+
+        auto parser = std::make_unique<Parser>(lexer->getTokens());
+        parser->Parse();
+
+        auto codegen = std::make_unique<Codegen>(std::move(parser), srcMgr, "", std::vector<std::string>{}, true, true);
+        codegen->Run();
+        codegen->Optimize(OptimizationLevel::O3);
+        codegen->PrepareJIT();
+    }
+
+    // Whether the client runs as the same user as the server, checked by the kernel rather than the socket permissions
+    bool fromOwner(int connection) {
+#ifdef __linux__
+        ucred credentials{};
+        socklen_t size = sizeof(credentials);
+        if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0)
+            return false;
+        return credentials.uid == geteuid();
+#else
+        uid_t user;
+        gid_t group;
+        if (getpeereid(connection, &user, &group) != 0)
+            return false;
+        return user == geteuid();
+#endif
+    }
+
+    bool receiveRequest(int connection, Request &request) {
+        if (!fromOwner(connection))
+            return false;
+
+        RequestHeader header{};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(request.streams))];
+        iovec data{&header, sizeof(header)};
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t count;
+        do {
+            count = recvmsg(connection, &message, 0);
+        } while (count < 0 && errno == EINTR);
+
+        // Descriptors that arrive in any other shape are closed, or they'd stay open in the server for good
+        for (auto *descriptors = CMSG_FIRSTHDR(&message); descriptors != nullptr; descriptors = CMSG_NXTHDR(&message, descriptors)) {
+            if (descriptors->cmsg_level != SOL_SOCKET || descriptors->cmsg_type != SCM_RIGHTS)
+                continue;
+
+            if (request.streams[0] < 0 && descriptors->cmsg_len == CMSG_LEN(sizeof(request.streams))) {
+                std::memcpy(request.streams, CMSG_DATA(descriptors), sizeof(request.streams));
+                continue;
+            }
+
+            auto received = (descriptors->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < received; i++) {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(descriptors) + i * sizeof(int), sizeof(fd));
+                close(fd);
+            }
+        }
+
+        if (count != sizeof(header) || header.size > MAX_REQUEST_SIZE || request.streams[0] < 0 || (message.msg_flags & MSG_CTRUNC))
+            return false;
+
+        std::string body(header.size, '\0');
+        if (!readAll(connection, body.data(), body.size()))
+            return false;
+
+        std::vector<std::string> strings;
+        for (size_t start = 0, end; start < body.size(); start = end + 1) {
+            end = body.find('\0', start);
+            if (end == std::string::npos)
+                return false;
+            strings.push_back(body.substr(start, end - start));
+        }
+        if (strings.size() < header.arguments + 1)
+            return false;
+
+        request.directory = strings[0];
+        request.args.assign(strings.begin() + 1, strings.begin() + 1 + header.arguments);
+        request.environment.assign(strings.begin() + 1 + header.arguments, strings.end());
+        return true;
+    }
+
+    void closeStreams(Request &request) {
+        for (auto &fd: request.streams)
+            if (fd >= 0)
+                close(std::exchange(fd, -1));
+    }
+
+    void replaceEnvironment(const std::vector<std::string> &environment) {
+        std::vector<std::string> names;
+        for (char **variable = environ; *variable != nullptr; variable++)
+            names.emplace_back(*variable, std::strcspn(*variable, "="));
+        for (const auto &name: names)
+            unsetenv(name.c_str());
+
+        for (const auto &variable: environment) {
+            auto separator = variable.find('=');
+            if (separator != std::string::npos)
+                setenv(variable.substr(0, separator).c_str(), variable.substr(separator + 1).c_str(), 1);
+        }
+    }
+
+    // Runs in the fork, as if the client had run the request itself
+    [[noreturn]] void runRequest(Request &request, const RequestHandler &handler) {
+        for (int stream = 0; stream < STREAMS; stream++)
+            dup2(request.streams[stream], stream);
+        closeStreams(request);
+
+        if (chdir(request.directory.c_str()) != 0) {
+            print(ERROR, "Could not change directory to {}: {}\n", request.directory, std::strerror(errno));
+            exit(1);
+        }
+        replaceEnvironment(request.environment);
+
+        int code;
+        try {
+            code = handler(request.args);
+        } catch (const std::exception &err) {
+            print(ERROR, "{}\n", err.what());
+            code = 1;
+        }
+
+        // The destructors of LLVM take longer than most requests, so they're skipped where quick_exit exists
+        fflush(nullptr);
+#ifdef __APPLE__
+        exit(code);
+#else
+        quick_exit(code);
+#endif
+    }
+
+    // Exit code a shell would report for the request
+    int32_t exitCode(int status) {
+        if (WIFSIGNALED(status))
+            return 128 + WTERMSIG(status);
+        return WEXITSTATUS(status);
+    }
+}// namespace
+
+int Server::Serve(const std::string &socketPath, const RequestHandler &handler) {
+    // Clients that connect while the server warms up wait in the backlog
+    int listener = listenOn(socketPath);
+    try {
+        warmUp();
+    } catch (...) {
+        close(listener);
+        unlink(socketPath.c_str());
+        throw;
+    }
+
+    if (pipe(signalPipe) != 0) {
+        close(listener);
+        unlink(socketPath.c_str());
+        throw LesmaError(llvm::SMRange(), "Could not create a pipe: {}", std::strerror(errno));
+    }
+    fcntl(signalPipe[1], F_SETFL, O_NONBLOCK);
+
+    struct sigaction action {};
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    for (auto signal: {SIGCHLD, SIGINT, SIGTERM})
+        sigaction(signal, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    print(SUCCESS, "Listening on {}\n", socketPath);
+    fflush(stdout);
+
+    std::map<pid_t, Running> running;
+    while (listener >= 0 || !running.empty()) {
+        bool accepting = listener >= 0;
+        std::vector<pollfd> fds{{signalPipe[0], POLLIN, 0}};
+        if (accepting)
+            fds.push_back({listener, POLLIN, 0});
+
+        // The client only writes its request, so a readable connection means it went away
+        std::vector<pid_t> watched;
+        for (const auto &[pid, request]: running) {
+            if (request.killed)
+                continue;
+            fds.push_back({request.connection, POLLIN, 0});
+            watched.push_back(pid);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            throw LesmaError(llvm::SMRange(), "Could not wait for requests: {}", std::strerror(errno));
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char signals[64];
+            auto count = read(signalPipe[0], signals, sizeof(signals));
+            for (ssize_t i = 0; i < count; i++) {
+                // Stop accepting, and let the requests that already started finish
+                if ((signals[i] == SIGINT || signals[i] == SIGTERM) && listener >= 0) {
+                    close(std::exchange(listener, -1));
+                    unlink(socketPath.c_str());
+                }
+            }
+
+            int status;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                auto found = running.find(pid);
+                if (found == running.end())
+                    continue;
+
+                auto code = exitCode(status);
+                writeAll(found->second.connection, &code, sizeof(code));
+                close(found->second.connection);
+                running.erase(found);
+            }
+        }
+
+        size_t first = accepting ? 2 : 1;
+        for (size_t i = 0; i < watched.size(); i++) {
+            auto found = running.find(watched[i]);
+            if (fds[first + i].revents == 0 || found == running.end())
+                continue;
+            kill(watched[i], SIGKILL);
+            found->second.killed = true;
+        }
+
+        if (!accepting || listener < 0 || !(fds[1].revents & POLLIN))
+            continue;
+
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0)
+            continue;
+
+        // Requests are read on the accept loop, a client that stops halfway through can only hold it up for a second
+        timeval timeout{1, 0};
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        // Nothing is sent back for a malformed request, servers also connect to check if another one is running
+        Request request;
+        if (!receiveRequest(connection, request)) {
+            closeStreams(request);
+            close(connection);
+            continue;
+        }
+
+        fflush(nullptr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            for (auto signal: {SIGCHLD, SIGINT, SIGTERM, SIGPIPE})
+                std::signal(signal, SIG_DFL);
+            close(signalPipe[0]);
+            close(signalPipe[1]);
+            close(listener);
+            close(connection);
+            for (const auto &[_, other]: running)
+                close(other.connection);
+
+            runRequest(request, handler);
+        }
+
+        closeStreams(request);
+        if (pid < 0) {
+            print(ERROR, "Could not start a request: {}\n", std::strerror(errno));
+            int32_t code = 1;
+            writeAll(connection, &code, sizeof(code));
+            close(connection);
+            continue;
+        }
+        running[pid] = {connection, false};
+    }
+
+    for (auto signal: {SIGCHLD, SIGINT, SIGTERM, SIGPIPE})
+        std::signal(signal, SIG_DFL);
+    close(signalPipe[0]);
+    close(signalPipe[1]);
+
+    return 0;
+}
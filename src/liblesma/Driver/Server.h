@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lesma {
+    // Runs one request, given the arguments of the lesma command line the client was started with
+    using RequestHandler = std::function<int(const std::vector<std::string> &args)>;
+
+    /**
+     * Compile server, keeps a compiler process warm so clients skip its startup. LLVM and the target are set up and
+     * the standard library compiled to objects once, then every request runs in a fork of the server with the standard
+     * streams, working directory and environment of its client, and the client exits with the exit code of the
+     * request. Requests only generate the declarations of the standard library modules they import.
+     */
+    class Server {
+    public:
+        // Serves requests on a Unix socket until interrupted, throws if the socket is taken by another server
+        static int Serve(const std::string &socketPath, const RequestHandler &handler);
+    };
+
+    // Client side of the compile server, it doesn't depend on the compiler so thin clients can link it alone
+    class Client {
+    public:
+        // Sends a request to the server on socketPath and waits for its exit code, nothing if no server listens there
+        static std::optional<int> Forward(const std::string &socketPath, const std::vector<std::string> &args);
+    };
+}// namespace lesma
@@ -0,0 +1,213 @@
+#include "Statistics.h"
+
+#include <sys/resource.h>
+
+#include "liblesma/AST/RecursiveASTVisitor.h"
+#include "liblesma/Common/LesmaError.h"
+#include "liblesma/Common/LesmaVersion.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace lesma;
+
+namespace {
+    class ASTNodeCounter : public RecursiveASTVisitor {
+    public:
+        std::map<std::string, uint64_t> counts;
+
+        void visitNode(const char *kind, [[maybe_unused]] const AST *node) override {
+            counts[kind]++;
+        }
+    };
+
+    std::map<std::string, uint64_t> getCounters() {
+        std::map<std::string, uint64_t> counters;
+        for (const auto &[name, value]: llvm::GetStatistics())
+            counters[name.str()] += value;
+        return counters;
+    }
+
+    uint64_t getPeakRSS() {
+        struct rusage usage {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    llvm::json::Object toJSON(const std::map<std::string, uint64_t> &values) {
+        llvm::json::Object obj;
+        for (const auto &[key, value]: values)
+            obj[key] = static_cast<int64_t>(value);
+        return obj;
+    }
+}// namespace
+
+Statistics::Statistics(StatsFormat format) : format(format) {
+    // Counters only register themselves while collection is enabled, so this has to happen before any stage runs
+    if (isEnabled())
+        llvm::EnableStatistics(false);
+}
+
+/**
+ * Snapshot the statistic counters at the start of a stage
+ */
+void Statistics::BeginStage() {
+    if (!isEnabled())
+        return;
+
+    snapshot = getCounters();
+}
+
+/**
+ * Close the current stage, attributing to it every counter that changed since BeginStage
+ *
+ * @param name Name of the stage
+ * @param elapsed_ms Wall time spent in the stage
+ */
+void Statistics::EndStage(const std::string &name, double elapsed_ms) {
+    if (!isEnabled())
+        return;
+
+    StageStatistics stage;
+    stage.name = name;
+    stage.time_ms = elapsed_ms;
+    stage.peak_rss = getPeakRSS();
+    for (const auto &[key, value]: getCounters()) {
+        // Max* counters are high-water marks, a delta between two snapshots means nothing for them
+        uint64_t before = snapshot.count(key) ? snapshot.at(key) : 0;
+        uint64_t delta = key.rfind("Max", 0) == 0 ? value : value - before;
+        if (delta != 0)
+            stage.counters[key] = delta;
+    }
+    stages.push_back(std::move(stage));
+}
+
+/**
+ * Attach a metric to the last finished stage
+ *
+ * @param key Name of the metric
+ * @param value Value of the metric
+ */
+void Statistics::Record(const std::string &key, uint64_t value) {
+    if (!isEnabled() || stages.empty())
+        return;
+
+    stages.back().metrics[key] = value;
+}
+
+/**
+ * Count the nodes of the tree by kind and attach them to the last finished stage
+ *
+ * @param tree Root of the AST
+ */
+void Statistics::RecordAST(const AST *tree) {
+    if (!isEnabled() || stages.empty())
+        return;
+
+    ASTNodeCounter counter;
+    counter.walk(tree);
+
+    uint64_t total = 0;
+    for (const auto &[kind, count]: counter.counts)
+        total += count;
+
+    stages.back().ast_nodes = std::move(counter.counts);
+    Record("ast_nodes", total);
+}
+
+/**
+ * Attach the size of the module to the last finished stage
+ *
+ * @param module LLVM Module of the compiled source
+ */
+void Statistics::RecordModule(const llvm::Module *module) {
+    if (!isEnabled() || stages.empty() || module == nullptr)
+        return;
+
+    uint64_t functions = 0, blocks = 0, instructions = 0;
+    for (const auto &func: *module) {
+        if (func.isDeclaration())
+            continue;
+
+        functions++;
+        blocks += func.size();
+        instructions += func.getInstructionCount();
+    }
+
+    Record("ir_functions", functions);
+    Record("ir_basic_blocks", blocks);
+    Record("ir_instructions", instructions);
+}
+
+/**
+ * Print the collected statistics in the requested format
+ *
+ * @param source Compiled source file
+ * @param jit Whether the source was run with the JIT or compiled to an executable
+ * @param total_ms Wall time of the whole compilation
+ * @param output_filename File to write the report to, standard output if empty
+ */
+void Statistics::Report(const std::string &source, bool jit, double total_ms, const std::string &output_filename) const {
+    if (!isEnabled())
+        return;
+
+    std::unique_ptr<llvm::raw_fd_ostream> file;
+    if (!output_filename.empty()) {
+        std::error_code EC;
+        file = std::make_unique<llvm::raw_fd_ostream>(output_filename, EC, llvm::sys::fs::OF_Text);
+        if (EC)
+            throw LesmaError(llvm::SMRange(), "Could not write statistics to {}: {}", output_filename, EC.message());
+    }
+    llvm::raw_ostream &OS = file ? *file : llvm::outs();
+
+    if (format == StatsFormat::TEXT) {
+        for (const auto &stage: stages) {
+            OS << llvm::format("%-20s %10.2f ms %10llu KB RSS\n", stage.name.c_str(), stage.time_ms,
+                               static_cast<unsigned long long>(stage.peak_rss / 1024));
+            for (const auto &[key, value]: stage.metrics)
+                OS << "    " << key << ": " << value << "\n";
+            for (const auto &[key, value]: stage.counters)
+                OS << "    " << key << ": " << value << "\n";
+        }
+        OS << llvm::left_justify("Total", 20) << llvm::format(" %10.2f ms\n", total_ms);
+        OS.flush();
+        return;
+    }
+
+    llvm::json::Array stages_json;
+    for (const auto &stage: stages) {
+        llvm::json::Object stage_json{
+                {"name", stage.name},
+                {"time_ms", stage.time_ms},
+                {"peak_rss_bytes", static_cast<int64_t>(stage.peak_rss)},
+        };
+        for (const auto &[key, value]: stage.metrics)
+            stage_json[key] = static_cast<int64_t>(value);
+        if (!stage.ast_nodes.empty())
+            stage_json["ast_nodes_by_kind"] = toJSON(stage.ast_nodes);
+        stage_json["counters"] = toJSON(stage.counters);
+        stages_json.push_back(std::move(stage_json));
+    }
+
+    llvm::json::Object report{
+            {"version", LESMA_VERSION},
+            {"source", source},
+            {"mode", jit ? "run" : "compile"},
+            {"total_ms", total_ms},
+            {"peak_rss_bytes", static_cast<int64_t>(getPeakRSS())},
+            {"stages", std::move(stages_json)},
+            {"counters", toJSON(getCounters())},
+    };
+
+    OS << llvm::formatv("{0:2}", llvm::json::Value(std::move(report))) << "\n";
+    OS.flush();
+}
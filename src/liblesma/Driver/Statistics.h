@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "liblesma/AST/AST.h"
+
+#include "llvm/IR/Module.h"
+
+namespace lesma {
+    enum class StatsFormat {
+        NONE,
+        TEXT,
+        JSON,
+    };
+
+    struct StageStatistics {
+        std::string name;
+        double time_ms = 0;
+        uint64_t peak_rss = 0;
+        std::map<std::string, uint64_t> metrics;
+        std::map<std::string, uint64_t> ast_nodes;
+        std::map<std::string, uint64_t> counters;
+    };
+
+    /**
+     * Collects per-stage compiler statistics: timings, sizes of the intermediate representations,
+     * peak memory and the deltas of the LLVM Statistic counters registered by liblesma and LLVM itself.
+     */
+    class Statistics {
+        StatsFormat format;
+        std::vector<StageStatistics> stages;
+        std::map<std::string, uint64_t> snapshot;
+
+    public:
+        explicit Statistics(StatsFormat format);
+
+        [[nodiscard]] bool isEnabled() const { return format != StatsFormat::NONE; }
+
+        void BeginStage();
+        void EndStage(const std::string &name, double elapsed_ms);
+        void Record(const std::string &key, uint64_t value);
+        void RecordAST(const AST *tree);
+        void RecordModule(const llvm::Module *module);
+        void Report(const std::string &source, bool jit, double total_ms, const std::string &output_filename) const;
+    };
+}// namespace lesma
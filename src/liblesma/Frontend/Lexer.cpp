@@ -31,6 +31,11 @@ Token *Lexer::ScanOne(bool continuation) {
             return AddToken(TokenType::LEFT_BRACE);
         case '}':
             level_--;
+            // Closes an interpolation, the rest is part of the string again
+            if (!interpolation_levels_.empty() && interpolation_levels_.back() == level_) {
+                interpolation_levels_.pop_back();
+                return AddStringToken(true);
+            }
             return AddToken(TokenType::RIGHT_BRACE);
         case ':':
             return AddToken(TokenType::COLON);
@@ -279,10 +284,20 @@ char Lexer::Peek(int offset) {
     return *(loc.getPointer() + offset);
 }
 
-Token *Lexer::AddStringToken() {
+Token *Lexer::AddStringToken(bool continued) {
     std::string string;
 
     while (Peek() != '"' && !IsAtEnd()) {
+        // An expression in braces is lexed as usual, until the matching closing brace
+        if (Peek() == '{') {
+            Advance();
+            interpolation_levels_.push_back(level_++);
+
+            auto ret = new Token(continued ? TokenType::STRING_MIDDLE : TokenType::STRING_HEAD, string, llvm::SMRange{begin_loc, loc});
+            ResetTokenBeg();
+            return ret;
+        }
+
         // Should we allow newlines in strings? Probably not
         if (Peek() == '\n') {
             line++;
@@ -322,6 +337,12 @@ Token *Lexer::AddStringToken() {
             case '\\':
                 string.push_back('\\');
                 break;
+            case '{':
+                string.push_back('{');
+                break;
+            case '}':
+                string.push_back('}');
+                break;
             default:
                 Error("Unknown escape sequence.");
         }
@@ -337,7 +358,7 @@ Token *Lexer::AddStringToken() {
     // Skip the closing ".
     Advance();
 
-    auto ret = new Token(TokenType::STRING, string, llvm::SMRange{begin_loc, loc});
+    auto ret = new Token(continued ? TokenType::STRING_TAIL : TokenType::STRING, string, llvm::SMRange{begin_loc, loc});
     ResetTokenBeg();
     return ret;
 }
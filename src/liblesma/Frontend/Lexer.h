@@ -35,7 +35,7 @@ namespace lesma {
 
         char Peek(int offset = 0);
 
-        Token *AddStringToken();
+        Token *AddStringToken(bool continued = false);
 
         static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
 
@@ -77,6 +77,8 @@ namespace lesma {
         int indent_ = 0;
         std::vector<int> indent_stack_ = {0};
         std::vector<int> alt_indent_stack_ = {0};
+        // Bracket levels at which the interpolations currently being lexed started
+        std::vector<int> interpolation_levels_;
 
         void ResetTokenBeg();
     };
@@ -73,6 +73,12 @@ TypeExpr *Parser::ParseType() {
                         TokenType::INT8_TYPE, TokenType::INT16_TYPE, TokenType::INT32_TYPE, TokenType::FLOAT32_TYPE, TokenType::VOID_TYPE>()) {
         Advance();
         return new TypeExpr(type->span, type->lexeme, type->type);
+    } else if (CheckAny<TokenType::CHAN_TYPE, TokenType::ATOMIC_TYPE>()) {
+        Advance();
+        Consume(TokenType::LESS, fmt::format("Expected '<' after {}", type->lexeme));
+        auto element_type = ParseType();
+        auto bracket = Consume(TokenType::GREATER, fmt::format("Expected '>' after the element type of {}", type->lexeme));
+        return new TypeExpr({type->getStart(), bracket->getEnd()}, type->lexeme + "<" + element_type->getName() + ">", type->type, element_type);
     } else if (Check(TokenType::FUNC)) {
         std::vector<TypeExpr *> params;
         TypeExpr *ret;
@@ -131,8 +137,28 @@ Expression *Parser::ParseFunctionCall() {
     return new FuncCall({token->getStart(), paren->span.End}, token->lexeme, params);
 }
 
+Expression *Parser::ParseInterpolation() {
+    auto head = Consume(TokenType::STRING_HEAD);
+    std::vector<Expression *> parts = {new Literal(head->span, head->lexeme, TokenType::STRING)};
+
+    while (true) {
+        parts.push_back(ParseExpression());
+
+        if (AdvanceIfMatchAny<TokenType::STRING_MIDDLE>()) {
+            parts.push_back(new Literal(Previous()->span, Previous()->lexeme, TokenType::STRING));
+            continue;
+        }
+
+        auto tail = Consume(TokenType::STRING_TAIL, "Expected '}' after interpolated expression");
+        parts.push_back(new Literal(tail->span, tail->lexeme, TokenType::STRING));
+        return new Interpolation({head->getStart(), tail->getEnd()}, parts);
+    }
+}
+
 Expression *Parser::ParseTerm() {
     switch (Peek()->type) {
+        case TokenType::STRING_HEAD:
+            return ParseInterpolation();
         case TokenType::STRING:
         case TokenType::INTEGER:
         case TokenType::DOUBLE:
@@ -149,6 +175,33 @@ Expression *Parser::ParseTerm() {
             Consume(token->type);
             return new Literal(token->span, token->lexeme, token->type);
         }
+        case TokenType::CHAN_TYPE: {
+            // Channels are created by calling their type, like a constructor
+            auto type = ParseType();
+            Consume(TokenType::LEFT_PAREN, "Expected '(' after channel type");
+
+            std::vector<Expression *> arguments;
+            while (!Check(TokenType::RIGHT_PAREN)) {
+                arguments.push_back(ParseExpression());
+                if (!Check(TokenType::RIGHT_PAREN))
+                    Consume(TokenType::COMMA);
+            }
+
+            auto paren = Consume(TokenType::RIGHT_PAREN);
+            return new NewChannel({type->getStart(), paren->getEnd()}, type, arguments);
+        }
+        case TokenType::ATOMIC_TYPE: {
+            // Like channels, with the initial value as the only argument
+            auto type = ParseType();
+            Consume(TokenType::LEFT_PAREN, "Expected '(' after atomic type");
+
+            std::optional<Expression *> value = std::nullopt;
+            if (!Check(TokenType::RIGHT_PAREN))
+                value = ParseExpression();
+
+            auto paren = Consume(TokenType::RIGHT_PAREN, "Expected ')' after the initial value of an atomic");
+            return new NewAtomic({type->getStart(), paren->getEnd()}, type, value);
+        }
         case TokenType::LEFT_PAREN: {
             Consume(TokenType::LEFT_PAREN);
             auto expr = ParseExpression();
@@ -180,17 +233,56 @@ Expression *Parser::ParseDot() {
     return left;
 }
 
+Expression *Parser::ParseSlice() {
+    Expression *left = ParseDot();
+
+    while (AdvanceIfMatchAny<TokenType::LEFT_SQUARE>()) {
+        Expression *start = nullptr;
+        Expression *end = nullptr;
+
+        // Either bound can be left out, `x[:]` is the whole value
+        if (!Check(TokenType::COLON))
+            start = ParseExpression();
+        Consume(TokenType::COLON, "Expected ':' in slice");
+        if (!Check(TokenType::RIGHT_SQUARE))
+            end = ParseExpression();
+
+        auto bracket = Consume(TokenType::RIGHT_SQUARE, "Expected ']' after slice");
+        left = new Slice({left->getStart(), bracket->getEnd()}, left, start, end);
+    }
+
+    return left;
+}
+
 Expression *Parser::ParseUnary() {
+    if (AdvanceIfMatchAny<TokenType::SPAWN>()) {
+        auto op = Previous();
+        auto call = dynamic_cast<FuncCall *>(ParseSlice());
+        if (call == nullptr)
+            Error(Previous(), "Expected function call after spawn");
+        return new Spawn({op->getStart(), call->getEnd()}, call);
+    }
+    if (AdvanceIfMatchAny<TokenType::JOIN>()) {
+        auto op = Previous();
+        auto task = ParseUnary();
+        return new Join({op->getStart(), task->getEnd()}, task);
+    }
+    if (AdvanceIfMatchAny<TokenType::AWAIT>()) {
+        auto op = Previous();
+        auto value = ParseUnary();
+        return new Await({op->getStart(), value->getEnd()}, value);
+    }
+
     Expression *left = nullptr;
     while (AdvanceIfMatchAny<TokenType::MINUS, TokenType::STAR, TokenType::AMPERSAND>()) {
         auto op = Previous();
-        auto expr = ParseDot();
+        auto expr = ParseSlice();
         left = new UnaryOp({op->getStart(), expr->getEnd()}, op->type, expr);
     }
 
     if (left == nullptr) {
         delete left;
-        return ParseDot();
+        return ParseSlice();
     }
 
     return left;
@@ -354,9 +446,99 @@ Statement *Parser::ParseWhile() {
 }
 
 Statement *Parser::ParseFor() {
-    Error(Peek(), "Unimplemented");
+    auto loc = Peek()->span;
 
-    return nullptr;
+    // Like `step`, `parallel` is only a keyword right before a loop
+    bool parallel = Check(TokenType::IDENTIFIER) && Peek()->lexeme == "parallel";
+    if (parallel)
+        Advance();
+    Consume(TokenType::FOR);
+
+    auto identifier = Consume(TokenType::IDENTIFIER);
+    auto var = new Literal(identifier->span, identifier->lexeme, identifier->type);
+    Consume(TokenType::IN);
+
+    // Ranges are either exclusive (a..b) or inclusive (a...b), anything else is a channel to receive from
+    auto start = ParseExpression();
+    if (!parallel && !CheckAny<TokenType::RANGE, TokenType::ELLIPSIS>()) {
+        auto block = ParseBlock();
+        return new For({loc.Start, block->getEnd()}, var, start, nullptr, std::nullopt, false, block, false, std::nullopt, {});
+    }
+
+    bool inclusive = AdvanceIfMatchAny<TokenType::ELLIPSIS>();
+    if (!inclusive)
+        Consume(TokenType::RANGE, "Expected range operator .. or ...");
+    auto end = ParseExpression();
+
+    // `step` is only a keyword after a range, so it can still be used as an identifier
+    std::optional<Expression *> step = std::nullopt;
+    if (Check(TokenType::IDENTIFIER) && Peek()->lexeme == "step") {
+        Advance();
+        step = ParseExpression();
+    }
+
+    // Parallel loops split the range in chunks of the given size, handed out as threads finish the previous ones
+    std::optional<Expression *> chunk = std::nullopt;
+    if (parallel && Check(TokenType::IDENTIFIER) && Peek()->lexeme == "chunk") {
+        Advance();
+        chunk = ParseExpression();
+    }
+
+    std::vector<Reduction *> reductions;
+    if (parallel && Check(TokenType::IDENTIFIER) && Peek()->lexeme == "reduce") {
+        Advance();
+        Consume(TokenType::LEFT_PAREN);
+        do {
+            auto op = Peek();
+            if (!Check(TokenType::PLUS) && !(Check(TokenType::IDENTIFIER) && (op->lexeme == "min" || op->lexeme == "max")))
+                Error(op, "Expected reduction operator +, min or max");
+            Advance();
+            Consume(TokenType::COLON);
+
+            auto identifier = Consume(TokenType::IDENTIFIER);
+            reductions.push_back(new Reduction(op->lexeme, new Literal(identifier->span, identifier->lexeme, identifier->type)));
+        } while (AdvanceIfMatchAny<TokenType::COMMA>());
+        Consume(TokenType::RIGHT_PAREN);
+    }
+
+    auto block = ParseBlock();
+
+    return new For({loc.Start, block->getEnd()}, var, start, end, step, inclusive, block, parallel, chunk, reductions);
+}
+
+Statement *Parser::ParseSelect() {
+    auto loc = Peek()->span;
+
+    // `select` and `case` are only keywords here, so they can still be used as identifiers
+    Consume(TokenType::IDENTIFIER);
+    Consume(TokenType::NEWLINE);
+    Consume(TokenType::INDENT);
+
+    std::vector<SelectCase *> cases;
+    std::optional<Compound *> elseBlock = std::nullopt;
+    while (!CheckAny<TokenType::DEDENT, TokenType::EOF_TOKEN>()) {
+        if (Check(TokenType::ELSE) && !elseBlock.has_value()) {
+            Advance();
+            elseBlock = ParseBlock();
+            continue;
+        }
+
+        if (!(Check(TokenType::IDENTIFIER) && Peek()->lexeme == "case") || elseBlock.has_value())
+            Error(Peek(), "Expected 'case' or 'else' in select");
+        Advance();
+
+        auto identifier = Consume(TokenType::IDENTIFIER);
+        auto var = new Literal(identifier->span, identifier->lexeme, identifier->type);
+        Consume(TokenType::FROM, "Expected 'from' after the variable of a case");
+        auto channel = ParseExpression();
+        cases.push_back(new SelectCase(var, channel, ParseBlock()));
+    }
+    AdvanceIfMatchAny<TokenType::DEDENT>();
+
+    if (cases.empty())
+        Error(Previous(), "Expected at least one case in select");
+
+    return new Select({loc.Start, elseBlock.has_value() ? elseBlock.value()->getEnd() : cases.back()->block->getEnd()}, cases, elseBlock);
 }
 
 Statement *Parser::ParseAssignment() {
@@ -412,11 +594,30 @@ Statement *Parser::ParseDefer() {
     return reinterpret_cast<Statement *>(new Defer({loc.Start, val->getEnd()}, val));
 }
 
+Statement *Parser::ParseRegion() {
+    auto loc = Peek()->span;
+    Consume(TokenType::REGION);
+
+    auto block = ParseBlock();
+
+    return new Region({loc.Start, block->getEnd()}, block);
+}
+
+Statement *Parser::ParseDelete() {
+    auto loc = Peek()->span;
+    Consume(TokenType::DELETE_);
+
+    auto value = ParseExpression();
+    ConsumeNewline();
+
+    return new Delete({loc.Start, value->getEnd()}, value);
+}
+
 Statement *Parser::ParseStatement(bool isTopLevel) {
-    if (CheckAny<TokenType::DEF, TokenType::IMPORT, TokenType::CLASS, TokenType::ENUM, TokenType::EXPORT>() && !isTopLevel)
+    if (CheckAny<TokenType::DEF, TokenType::ASYNC, TokenType::IMPORT, TokenType::CLASS, TokenType::ENUM, TokenType::EXPORT>() && !isTopLevel)
         Error(Peek(), "Statement not allowed inside a block");
 
-    if (Check(TokenType::DEF))
+    if (CheckAny<TokenType::DEF, TokenType::ASYNC>())
         return ParseFunctionDeclaration();
     else if (CheckAny<TokenType::IMPORT, TokenType::FROM>())
         return ParseImport();
@@ -432,8 +633,10 @@ Statement *Parser::ParseStatement(bool isTopLevel) {
         return ParseIf();
     else if (Check(TokenType::WHILE))
         return ParseWhile();
-    else if (Check(TokenType::FOR))
+    else if (Check(TokenType::FOR) || (Check(TokenType::IDENTIFIER) && Peek()->lexeme == "parallel" && Check(TokenType::FOR, 1)))
         return ParseFor();
+    else if (Check(TokenType::IDENTIFIER) && Peek()->lexeme == "select" && Check(TokenType::NEWLINE, 1))
+        return ParseSelect();
     else if (Check(TokenType::BREAK))
         return ParseBreak();
     else if (Check(TokenType::CONTINUE))
@@ -442,6 +645,10 @@ Statement *Parser::ParseStatement(bool isTopLevel) {
         return ParseReturn();
     else if (Check(TokenType::DEFER))
         return ParseDefer();
+    else if (Check(TokenType::REGION))
+        return ParseRegion();
+    else if (Check(TokenType::DELETE_))
+        return ParseDelete();
     else if (CheckAnyInLine<TokenType::EQUAL, TokenType::PLUS_EQUAL, TokenType::MINUS_EQUAL, TokenType::STAR_EQUAL,
                             TokenType::SLASH_EQUAL, TokenType::MOD_EQUAL, TokenType::POWER_EQUAL>())
         return ParseAssignment();
@@ -473,6 +680,7 @@ Compound *Parser::ParseBlock() {
 
 Statement *Parser::ParseFunctionDeclaration() {
     auto loc = isExported ? Previous()->span : Peek()->span;
+    bool async = AdvanceIfMatchAny<TokenType::ASYNC>();
     Consume(TokenType::DEF);
     bool extern_func = false;
 
@@ -484,6 +692,11 @@ Statement *Parser::ParseFunctionDeclaration() {
         return nullptr;
     }
 
+    if (async && inClass) {
+        Error(Previous(), "Async functions are not allowed in class definition.");
+        return nullptr;
+    }
+
     auto identifier = Consume(TokenType::IDENTIFIER);
 
     // Parse parameters
@@ -495,7 +708,7 @@ Statement *Parser::ParseFunctionDeclaration() {
         if (varargs)
             Error(Peek(), "Varargs should be the last parameter");
 
-        if (Check(TokenType::ELLIPSIS) && extern_func) {
+        if (Check(TokenType::ELLIPSIS) && extern_func && !async) {
             Consume(TokenType::ELLIPSIS);
             varargs = true;
         } else {
@@ -532,12 +745,12 @@ Statement *Parser::ParseFunctionDeclaration() {
 
     if (extern_func) {
         ConsumeNewline();
-        return new ExternFuncDecl({loc.Start, return_type->getEnd()}, identifier->lexeme, return_type, parameters, varargs, isExported);
+        return new ExternFuncDecl({loc.Start, return_type->getEnd()}, identifier->lexeme, return_type, parameters, varargs, isExported, async);
     }
 
     auto body = ParseBlock();
 
-    return new FuncDecl({loc.Start, return_type->getEnd()}, identifier->lexeme, return_type, parameters, body, false, isExported);
+    return new FuncDecl({loc.Start, return_type->getEnd()}, identifier->lexeme, return_type, parameters, body, false, isExported, async);
 }
 
 Statement *Parser::ParseExport() {
@@ -546,12 +759,12 @@ Statement *Parser::ParseExport() {
     if (inClass)
         Error(Peek(), "Cannot export class members");
 
-    if (!CheckAny<TokenType::DEF, TokenType::CLASS, TokenType::ENUM>())
+    if (!CheckAny<TokenType::DEF, TokenType::ASYNC, TokenType::CLASS, TokenType::ENUM>())
         Error(Peek(), "Can only export functions, classes and enums");
 
     isExported = true;
     Statement *statement = nullptr;
-    if (Check(TokenType::DEF))
+    if (CheckAny<TokenType::DEF, TokenType::ASYNC>())
         statement = ParseFunctionDeclaration();
     else if (Check(TokenType::IMPORT))
         statement = ParseImport();
@@ -634,7 +847,7 @@ Statement *Parser::ParseClass() {
     while (!CheckAny<TokenType::DEDENT, TokenType::EOF_TOKEN>()) {
         if (CheckAny<TokenType::LET, TokenType::VAR>())
             fields.push_back(dynamic_cast<VarDecl *>(ParseVarDecl()));
-        else if (CheckAny<TokenType::DEF>())
+        else if (CheckAny<TokenType::DEF, TokenType::ASYNC>())
             methods.push_back(dynamic_cast<FuncDecl *>(ParseFunctionDeclaration()));
         else
             Consume(TokenType::NEWLINE);
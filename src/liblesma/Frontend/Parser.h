@@ -81,18 +81,22 @@ namespace lesma {
         Statement *ParseIf();
         Statement *ParseWhile();
         Statement *ParseFor();
+        Statement *ParseSelect();
         Statement *ParseVarDecl();
         Statement *ParseAssignment();
         Statement *ParseBreak();
         Statement *ParseContinue();
         Statement *ParseReturn();
         Statement *ParseDefer();
+        Statement *ParseRegion();
+        Statement *ParseDelete();
         TypeExpr *ParseType();
         Expression *ParseExpression();
         Expression *ParseOr();
         Expression *ParseAnd();
         Expression *ParseNot();
         Expression *ParseDot();
+        Expression *ParseSlice();
         Expression *ParseCompare();
         Expression *ParseAdd();
         Expression *ParseMult();
@@ -101,5 +105,6 @@ namespace lesma {
         Expression *ParseUnary();
         Expression *ParseTerm();
         Expression *ParseFunctionCall();
+        Expression *ParseInterpolation();
     };
 }// namespace lesma
\ No newline at end of file
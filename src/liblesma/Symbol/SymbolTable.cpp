@@ -1,14 +1,35 @@
 #include "SymbolTable.h"
+#include <llvm/ADT/Statistic.h>
 #include <llvm/IR/DerivedTypes.h>
 
 using namespace lesma;
 
+#define DEBUG_TYPE "symbols"
+
+ALWAYS_ENABLED_STATISTIC(NumSymbolsInserted, "Number of symbols inserted");
+ALWAYS_ENABLED_STATISTIC(NumTypesInserted, "Number of types inserted");
+ALWAYS_ENABLED_STATISTIC(NumSymbolLookups, "Number of symbol, function, struct and type lookups");
+ALWAYS_ENABLED_STATISTIC(NumScopesSearched, "Number of scopes walked by lookups");
+ALWAYS_ENABLED_STATISTIC(MaxLookupDepth, "Deepest scope chain walked by a single lookup");
+
+/**
+ * Record a finished lookup in the symbol table statistics
+ *
+ * @param depth Number of parent scopes walked before the lookup finished
+ */
+static void recordLookup(unsigned depth) {
+    ++NumSymbolLookups;
+    NumScopesSearched += depth + 1;
+    MaxLookupDepth.updateMax(depth);
+}
+
 /**
  * Insert a new symbol into the current symbol table. If it is a parameter, append its name to the paramNames vector
  *
  * @param entry Symbol Table Entry
  */
 void SymbolTable::insertSymbol(Value *entry) {
+    ++NumSymbolsInserted;
     symbols.emplace(entry->getName(), entry);
 }
 
@@ -18,6 +39,7 @@ void SymbolTable::insertSymbol(Value *entry) {
  * @param entry Symbol Table Entry
  */
 void SymbolTable::insertType(const std::string &name, Type *type) {
+    ++NumTypesInserted;
     types.insert_or_assign(name, type);
 }
 
@@ -28,45 +50,46 @@ void SymbolTable::insertType(const std::string &name, Type *type) {
  * @return Desired symbol / nullptr if the symbol was not found
  */
 Value *SymbolTable::lookupFunction(const std::string &name, std::vector<lesma::Type *> paramTypes) {
-    auto range = symbols.equal_range(name);
-    for (auto it = range.first; it != range.second; ++it) {
-        if (!it->second->getType()->is(TY_FUNCTION))
-            continue;
-        // Check if the parameter types match
-        bool paramsMatch = true;
-        std::vector<Field *> funcParamTypes = it->second->getType()->getFields();
-        size_t numParams = std::max(funcParamTypes.size(), paramTypes.size());
-
-        for (size_t i = 0; i < numParams; ++i) {
-            if (i < funcParamTypes.size() && i < paramTypes.size()) {
-                if (!funcParamTypes[i]->type->isEqual(paramTypes[i])) {
+    unsigned depth = 0;
+    for (auto table = this; table != nullptr; table = table->parent, depth++) {
+        auto range = table->symbols.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (!it->second->getType()->is(TY_FUNCTION))
+                continue;
+            // Check if the parameter types match
+            bool paramsMatch = true;
+            std::vector<Field *> funcParamTypes = it->second->getType()->getFields();
+            size_t numParams = std::max(funcParamTypes.size(), paramTypes.size());
+
+            for (size_t i = 0; i < numParams; ++i) {
+                if (i < funcParamTypes.size() && i < paramTypes.size()) {
+                    if (!funcParamTypes[i]->type->isEqual(paramTypes[i])) {
+                        paramsMatch = false;
+                        break;
+                    }
+                } else if (i < funcParamTypes.size() && funcParamTypes[i]->defaultValue != nullptr) {
+                    // Use default value for missing parameter
+                    paramTypes.push_back(funcParamTypes[i]->type);
+                } else if (i >= funcParamTypes.size() && it->second->getType()->getLLVMType()->isFunctionVarArg()) {
+                    // Varargs
+                    break;
+                } else {
                     paramsMatch = false;
                     break;
                 }
-            } else if (i < funcParamTypes.size() && funcParamTypes[i]->defaultValue != nullptr) {
-                // Use default value for missing parameter
-                paramTypes.push_back(funcParamTypes[i]->type);
-            } else if (i >= funcParamTypes.size() && it->second->getType()->getLLVMType()->isFunctionVarArg()) {
-                // Varargs
-                break;
-            } else {
-                paramsMatch = false;
-                break;
             }
-        }
-
-        if (!paramsMatch) {
-            continue;// Parameter types don't match
-        }
 
-        return it->second;
-    }
+            if (!paramsMatch) {
+                continue;// Parameter types don't match
+            }
 
-    if (parent == nullptr) {
-        return nullptr;
+            recordLookup(depth);
+            return it->second;
+        }
     }
 
-    return parent->lookupFunction(name, paramTypes);
+    recordLookup(depth - 1);
+    return nullptr;
 }
 
 /**
@@ -76,17 +99,18 @@ Value *SymbolTable::lookupFunction(const std::string &name, std::vector<lesma::T
  * @return Desired symbol / nullptr if the symbol was not found
  */
 Value *SymbolTable::lookup(const std::string &name) {
-    for (const auto &sym: symbols) {
-        if (sym.first == name) {
-            return sym.second;
+    unsigned depth = 0;
+    for (auto table = this; table != nullptr; table = table->parent, depth++) {
+        for (const auto &sym: table->symbols) {
+            if (sym.first == name) {
+                recordLookup(depth);
+                return sym.second;
+            }
         }
     }
 
-    if (parent == nullptr) {
-        return nullptr;
-    }
-
-    return parent->lookup(name);
+    recordLookup(depth - 1);
+    return nullptr;
 }
 
 /**
@@ -96,17 +120,19 @@ Value *SymbolTable::lookup(const std::string &name) {
  * @return Desired symbol / nullptr if the symbol was not found
  */
 Value *SymbolTable::lookupStruct(const std::string &name) {
-    for (auto sym: symbols) {
-        if (sym.second->getType()->getLLVMType() != nullptr && sym.second->getType()->isOneOf({TY_CLASS, TY_ENUM}) &&
-            llvm::cast<llvm::StructType>(sym.second->getType()->getLLVMType())->getName() == name)
-            return sym.second;
-    }
-
-    if (parent == nullptr) {
-        return nullptr;
+    unsigned depth = 0;
+    for (auto table = this; table != nullptr; table = table->parent, depth++) {
+        for (const auto &sym: table->symbols) {
+            if (sym.second->getType()->getLLVMType() != nullptr && sym.second->getType()->isOneOf({TY_CLASS, TY_ENUM}) &&
+                llvm::cast<llvm::StructType>(sym.second->getType()->getLLVMType())->getName() == name) {
+                recordLookup(depth);
+                return sym.second;
+            }
+        }
     }
 
-    return parent->lookupStruct(name);
+    recordLookup(depth - 1);
+    return nullptr;
 }
 
 /**
@@ -116,12 +142,17 @@ Value *SymbolTable::lookupStruct(const std::string &name) {
  * @return Desired symbol / nullptr if the symbol was not found
  */
 Type *SymbolTable::lookupType(const std::string &name) {
-    if (types.find(name) == types.end()) {
-        if (parent == nullptr) return nullptr;
-        return parent->lookupType(name);
+    unsigned depth = 0;
+    for (auto table = this; table != nullptr; table = table->parent, depth++) {
+        auto it = table->types.find(name);
+        if (it != table->types.end()) {
+            recordLookup(depth);
+            return it->second;
+        }
     }
 
-    return types.at(name);
+    recordLookup(depth - 1);
+    return nullptr;
 }
 
 /**
@@ -24,6 +24,14 @@ namespace lesma {
         TY_CLASS,
         TY_ENUM,
         TY_IMPORT,
+        // Spawned function call, the element type is what joining it returns
+        TY_TASK,
+        // Call of an async function, the element type is what awaiting it returns
+        TY_FUTURE,
+        // Channel between threads, the element type is what it carries
+        TY_CHANNEL,
+        // Cell shared between threads, the element type is what it holds
+        TY_ATOMIC,
     };
 
     class Type;
@@ -66,6 +74,7 @@ namespace lesma {
         void setBaseType(BaseType type) { baseType = type; }
         void setElementType(lesma::Type *type) { elementType = type; }
         void setReturnType(lesma::Type *type) { returnType = type; }
+        void setFields(std::vector<Field *> newFields) { fields = std::move(newFields); }
 
         bool isEqual(Type *rhs) const {
             if (rhs == nullptr)
@@ -74,6 +83,10 @@ namespace lesma {
             if (this->getBaseType() != rhs->getBaseType())
                 return false;
 
+            // Classes are told apart by their struct, otherwise methods of imported classes match each other
+            if (baseType == TY_CLASS && llvmType != nullptr && rhs->llvmType != nullptr && llvmType != rhs->llvmType)
+                return false;
+
             Type *thisElementType = this->getElementType();
             Type *rhsElementType = rhs->getElementType();
 
@@ -125,6 +138,18 @@ namespace lesma {
                 case TY_IMPORT:
                     result = "Import";
                     break;
+                case TY_TASK:
+                    result = "Task";
+                    break;
+                case TY_FUTURE:
+                    result = "Future";
+                    break;
+                case TY_CHANNEL:
+                    result = "Channel";
+                    break;
+                case TY_ATOMIC:
+                    result = "Atomic";
+                    break;
             }
 
             if (elementType) {
@@ -42,6 +42,8 @@ namespace lesma {
         [[nodiscard]] Type *getType() { return type; }
         [[nodiscard]] lesma::Value *getConstructor() { return constructor; }
         [[nodiscard]] bool isExported() const { return exported; }
+        [[nodiscard]] bool isExtern() const { return external; }
+        [[nodiscard]] bool isRuntime() const { return runtime; }
         [[nodiscard]] bool isUsed() const { return used; }
 
         void setLLVMValue(llvm::Value *value) { llvmValue = value; }
@@ -51,6 +53,8 @@ namespace lesma {
         void setSigned(bool signed_) { mutableVar = signed_; }
         void setMutable(bool mutable_) { mutableVar = mutable_; }
         void setExported(bool exported_) { exported = exported_; }
+        void setExtern(bool extern_) { external = extern_; }
+        void setRuntime(bool runtime_) { runtime = runtime_; }
         void setConstructor(lesma::Value *constructor_) { constructor = constructor_; }
 
         std::string toString() {
@@ -77,6 +81,9 @@ namespace lesma {
         bool signedVar = true;
         // For functions
         bool exported = false;
+        bool external = false;
+        // Extern declared by the standard library, implemented by the runtime with Lesma strings
+        bool runtime = false;
         // For classes
         lesma::Value *constructor = nullptr;
     };
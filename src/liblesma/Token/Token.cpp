@@ -35,6 +35,18 @@ TokenType Token::GetIdentifierType(const std::string &identifier, Token *lastTok
         return TokenType::DEF;
     else if (identifier == "defer")
         return TokenType::DEFER;
+    else if (identifier == "region")
+        return TokenType::REGION;
+    else if (identifier == "delete")
+        return TokenType::DELETE_;
+    else if (identifier == "spawn")
+        return TokenType::SPAWN;
+    else if (identifier == "join")
+        return TokenType::JOIN;
+    else if (identifier == "async")
+        return TokenType::ASYNC;
+    else if (identifier == "await")
+        return TokenType::AWAIT;
     else if (identifier == "func")
         return TokenType::FUNC;
     else if (identifier == "if")
@@ -91,6 +103,10 @@ TokenType Token::GetIdentifierType(const std::string &identifier, Token *lastTok
         return TokenType::BOOL_TYPE;
     else if (identifier == "void")
         return TokenType::VOID_TYPE;
+    else if (identifier == "chan")
+        return TokenType::CHAN_TYPE;
+    else if (identifier == "atomic")
+        return TokenType::ATOMIC_TYPE;
     else if (identifier == "import")
         return TokenType::IMPORT;
     else if (identifier == "from")
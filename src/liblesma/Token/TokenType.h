@@ -51,6 +51,10 @@ namespace lesma {
         // Literals.
         IDENTIFIER,
         STRING,
+        // Pieces of an interpolated string, around the expressions in braces
+        STRING_HEAD,
+        STRING_MIDDLE,
+        STRING_TAIL,
         INTEGER,
         DOUBLE,
         BOOL,
@@ -68,6 +72,8 @@ namespace lesma {
         INT16_TYPE,
         INT32_TYPE,
         FLOAT32_TYPE,
+        CHAN_TYPE,
+        ATOMIC_TYPE,
 
         // Keywords.
         AND,
@@ -95,6 +101,12 @@ namespace lesma {
         BREAK,
         CONTINUE,
         DEFER,
+        REGION,
+        DELETE_,
+        SPAWN,
+        JOIN,
+        ASYNC,
+        AWAIT,
         AS,
         IS,
         IS_NOT,
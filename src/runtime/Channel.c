@@ -0,0 +1,596 @@
+/* sched_yield is not part of strict C11 */
+#define _DEFAULT_SOURCE
+
+#include "Runtime.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define cpu_relax() _mm_pause()
+#else
+#define cpu_relax() ((void) 0)
+#endif
+
+/* Attempts a blocked send or receive makes before the thread parks, the first ones only pause the core */
+#define LESMA_CHANNEL_SPINS 64
+#define LESMA_CHANNEL_PAUSES 16
+
+/*
+ * Unbounded channels are a list of blocks of LESMA_BLOCK_SLOTS slots, like the list flavor of crossbeam-channel.
+ * Positions count LESMA_BLOCK_LAP per block, the extra one marks a block being replaced by the next one.
+ */
+#define LESMA_BLOCK_SLOTS 31
+#define LESMA_BLOCK_LAP 32
+
+/* States of a slot in a block */
+#define LESMA_SLOT_WRITTEN 1
+#define LESMA_SLOT_READ 2
+#define LESMA_SLOT_DESTROY 4
+
+#define LESMA_CACHE_LINE 64
+
+/*
+ * A thread waiting for channels sleeps on its parker, which the first channel ready for it points back to. It's
+ * registered as a waiter of every channel it waits for, with a single parker a select is only woken once.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    _Atomic(struct lesma_channel *) notifier;
+} lesma_parker;
+
+typedef struct lesma_waiter {
+    struct lesma_waiter *next;
+    struct lesma_waiter *prev;
+    lesma_parker *parker;
+} lesma_waiter;
+
+typedef struct {
+    lesma_waiter *first;
+    lesma_waiter *last;
+    /* Read without the lock, so operations that find nobody waiting don't take it */
+    _Atomic int64_t count;
+} lesma_waiters;
+
+typedef struct lesma_block {
+    _Atomic(struct lesma_block *) next;
+    char slots[];
+} lesma_block;
+
+/* Every slot, cell or block slot starts with its state, followed by the element */
+#define LESMA_SLOT_HEADER 8
+
+typedef struct lesma_channel {
+    /* Positions the consumers and the producers move, each on its own cache line */
+    _Alignas(LESMA_CACHE_LINE) _Atomic int64_t head;
+    _Atomic(lesma_block *) head_block;
+    /* What the consumer of a single producer channel last saw of the tail */
+    int64_t cached_tail;
+
+    _Alignas(LESMA_CACHE_LINE) _Atomic int64_t tail;
+    _Atomic(lesma_block *) tail_block;
+    int64_t cached_head;
+
+    _Alignas(LESMA_CACHE_LINE) int64_t kind;
+    int64_t element_size;
+    int64_t slot_size;
+    /* Rings and queues have a power of two of slots, capacities in between leave the ones over empty */
+    int64_t capacity;
+    int64_t mask;
+    char *slots;
+    atomic_bool closed;
+
+    pthread_mutex_t lock;
+    lesma_waiters receivers;
+    lesma_waiters senders;
+} lesma_channel;
+
+static _Thread_local lesma_parker parker = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL};
+
+static void *checked_alloc(size_t alignment, size_t size) {
+    /* aligned_alloc wants a multiple of the alignment */
+    void *ptr = aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+    if (ptr == NULL) {
+        fprintf(stderr, "lesma: out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+static _Atomic int64_t *slot_state(char *slot) {
+    return (_Atomic int64_t *) slot;
+}
+
+static char *slot_value(char *slot) {
+    return slot + LESMA_SLOT_HEADER;
+}
+
+/* Single producer single consumer ring, the positions only ever grow and index the ring through the mask */
+
+static bool ring_push(lesma_channel *channel, const void *value) {
+    int64_t tail = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+    if (tail - channel->cached_head >= channel->capacity) {
+        channel->cached_head = atomic_load_explicit(&channel->head, memory_order_acquire);
+        if (tail - channel->cached_head >= channel->capacity)
+            return false;
+    }
+
+    memcpy(channel->slots + (tail & channel->mask) * channel->element_size, value, (size_t) channel->element_size);
+    atomic_store_explicit(&channel->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static bool ring_pop(lesma_channel *channel, void *value) {
+    int64_t head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+    if (head == channel->cached_tail) {
+        channel->cached_tail = atomic_load_explicit(&channel->tail, memory_order_acquire);
+        if (head == channel->cached_tail)
+            return false;
+    }
+
+    memcpy(value, channel->slots + (head & channel->mask) * channel->element_size, (size_t) channel->element_size);
+    atomic_store_explicit(&channel->head, head + 1, memory_order_release);
+    return true;
+}
+
+/*
+ * Bounded multi-producer multi-consumer queue by Dmitry Vyukov. The state of a cell is the position that can use
+ * it next: a producer at position p waits for p, then sets p + 1 for the consumer, which sets p + capacity.
+ */
+
+static bool array_push(lesma_channel *channel, const void *value) {
+    int64_t tail = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+    for (;;) {
+        /* Only read with cells over, a stale head looks full and the sender checks again after its fence */
+        if (channel->capacity <= channel->mask && tail - atomic_load_explicit(&channel->head, memory_order_relaxed) >= channel->capacity)
+            return false;
+
+        char *cell = channel->slots + (tail & channel->mask) * channel->slot_size;
+        int64_t state = atomic_load_explicit(slot_state(cell), memory_order_acquire);
+        if (state == tail) {
+            if (atomic_compare_exchange_weak_explicit(&channel->tail, &tail, tail + 1, memory_order_relaxed, memory_order_relaxed)) {
+                memcpy(slot_value(cell), value, (size_t) channel->element_size);
+                atomic_store_explicit(slot_state(cell), tail + 1, memory_order_release);
+                return true;
+            }
+        } else if (state < tail) {
+            /* The consumer of the previous lap didn't get to this cell, the queue is full */
+            return false;
+        } else {
+            tail = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+        }
+    }
+}
+
+static bool array_pop(lesma_channel *channel, void *value) {
+    int64_t head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+    for (;;) {
+        char *cell = channel->slots + (head & channel->mask) * channel->slot_size;
+        int64_t state = atomic_load_explicit(slot_state(cell), memory_order_acquire);
+        if (state == head + 1) {
+            if (atomic_compare_exchange_weak_explicit(&channel->head, &head, head + 1, memory_order_relaxed, memory_order_relaxed)) {
+                memcpy(value, slot_value(cell), (size_t) channel->element_size);
+                atomic_store_explicit(slot_state(cell), head + channel->mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (state < head + 1) {
+            return false;
+        } else {
+            head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+        }
+    }
+}
+
+/*
+ * Unbounded list of blocks. Producers claim a slot by moving the tail and the one taking the last slot of a block
+ * links the next one, consumers do the same with the head. Blocks are freed by whoever reads their last slot once
+ * every other slot was read, or by the last reader of the slots it had to wait for.
+ */
+
+static char *block_slot(lesma_channel *channel, lesma_block *block, int64_t offset) {
+    return block->slots + offset * channel->slot_size;
+}
+
+static lesma_block *block_new(lesma_channel *channel) {
+    lesma_block *block = checked_alloc(LESMA_CACHE_LINE, sizeof(lesma_block) + LESMA_BLOCK_SLOTS * (size_t) channel->slot_size);
+    atomic_init(&block->next, NULL);
+    for (int64_t offset = 0; offset < LESMA_BLOCK_SLOTS; offset++)
+        atomic_init(slot_state(block_slot(channel, block, offset)), 0);
+    return block;
+}
+
+static void block_destroy(lesma_channel *channel, lesma_block *block, int64_t start) {
+    /* The last slot isn't checked, its reader started the destruction */
+    for (int64_t offset = start; offset < LESMA_BLOCK_SLOTS - 1; offset++) {
+        _Atomic int64_t *state = slot_state(block_slot(channel, block, offset));
+        if ((atomic_load_explicit(state, memory_order_acquire) & LESMA_SLOT_READ) == 0 &&
+            (atomic_fetch_or_explicit(state, LESMA_SLOT_DESTROY, memory_order_acq_rel) & LESMA_SLOT_READ) == 0)
+            return;
+    }
+    free(block);
+}
+
+static void list_push(lesma_channel *channel, const void *value) {
+    lesma_block *next = NULL;
+    int64_t tail = atomic_load_explicit(&channel->tail, memory_order_acquire);
+    lesma_block *block = atomic_load_explicit(&channel->tail_block, memory_order_acquire);
+    for (;;) {
+        int64_t offset = tail % LESMA_BLOCK_LAP;
+        if (offset == LESMA_BLOCK_SLOTS) {
+            /* Another producer is linking the next block */
+            sched_yield();
+            tail = atomic_load_explicit(&channel->tail, memory_order_acquire);
+            block = atomic_load_explicit(&channel->tail_block, memory_order_acquire);
+            continue;
+        }
+
+        /* Allocated before claiming the last slot, so the others don't wait for malloc */
+        if (offset + 1 == LESMA_BLOCK_SLOTS && next == NULL)
+            next = block_new(channel);
+
+        if (atomic_compare_exchange_weak_explicit(&channel->tail, &tail, tail + 1, memory_order_seq_cst, memory_order_acquire)) {
+            if (offset + 1 == LESMA_BLOCK_SLOTS) {
+                atomic_store_explicit(&channel->tail_block, next, memory_order_release);
+                atomic_fetch_add_explicit(&channel->tail, 1, memory_order_release);
+                atomic_store_explicit(&block->next, next, memory_order_release);
+                next = NULL;
+            }
+
+            char *slot = block_slot(channel, block, offset);
+            memcpy(slot_value(slot), value, (size_t) channel->element_size);
+            atomic_fetch_or_explicit(slot_state(slot), LESMA_SLOT_WRITTEN, memory_order_release);
+            break;
+        }
+        block = atomic_load_explicit(&channel->tail_block, memory_order_acquire);
+    }
+    free(next);
+}
+
+static bool list_pop(lesma_channel *channel, void *value) {
+    int64_t head = atomic_load_explicit(&channel->head, memory_order_acquire);
+    lesma_block *block = atomic_load_explicit(&channel->head_block, memory_order_acquire);
+    for (;;) {
+        int64_t offset = head % LESMA_BLOCK_LAP;
+        if (offset == LESMA_BLOCK_SLOTS) {
+            sched_yield();
+            head = atomic_load_explicit(&channel->head, memory_order_acquire);
+            block = atomic_load_explicit(&channel->head_block, memory_order_acquire);
+            continue;
+        }
+
+        atomic_thread_fence(memory_order_seq_cst);
+        if (head == atomic_load_explicit(&channel->tail, memory_order_relaxed))
+            return false;
+
+        if (atomic_compare_exchange_weak_explicit(&channel->head, &head, head + 1, memory_order_seq_cst, memory_order_acquire)) {
+            if (offset + 1 == LESMA_BLOCK_SLOTS) {
+                lesma_block *next;
+                while ((next = atomic_load_explicit(&block->next, memory_order_acquire)) == NULL)
+                    sched_yield();
+                atomic_store_explicit(&channel->head_block, next, memory_order_release);
+                atomic_fetch_add_explicit(&channel->head, 1, memory_order_release);
+            }
+
+            /* The producer claimed the slot, it may still be writing it */
+            char *slot = block_slot(channel, block, offset);
+            while ((atomic_load_explicit(slot_state(slot), memory_order_acquire) & LESMA_SLOT_WRITTEN) == 0)
+                cpu_relax();
+            memcpy(value, slot_value(slot), (size_t) channel->element_size);
+
+            if (offset + 1 == LESMA_BLOCK_SLOTS)
+                block_destroy(channel, block, 0);
+            else if (atomic_fetch_or_explicit(slot_state(slot), LESMA_SLOT_READ, memory_order_acq_rel) & LESMA_SLOT_DESTROY)
+                block_destroy(channel, block, offset + 1);
+            return true;
+        }
+        block = atomic_load_explicit(&channel->head_block, memory_order_acquire);
+    }
+}
+
+static bool try_send(lesma_channel *channel, const void *value) {
+    switch (channel->kind) {
+        case LESMA_CHANNEL_SPSC:
+            return ring_push(channel, value);
+        case LESMA_CHANNEL_MPMC:
+            return array_push(channel, value);
+        default:
+            list_push(channel, value);
+            return true;
+    }
+}
+
+static bool try_recv(lesma_channel *channel, void *value) {
+    switch (channel->kind) {
+        case LESMA_CHANNEL_SPSC:
+            return ring_pop(channel, value);
+        case LESMA_CHANNEL_MPMC:
+            return array_pop(channel, value);
+        default:
+            return list_pop(channel, value);
+    }
+}
+
+/* Waiting */
+
+static void waiters_add(lesma_channel *channel, lesma_waiters *waiters, lesma_waiter *waiter) {
+    waiter->parker = &parker;
+    waiter->next = NULL;
+    pthread_mutex_lock(&channel->lock);
+    waiter->prev = waiters->last;
+    if (waiters->last != NULL)
+        waiters->last->next = waiter;
+    else
+        waiters->first = waiter;
+    waiters->last = waiter;
+    atomic_fetch_add(&waiters->count, 1);
+    pthread_mutex_unlock(&channel->lock);
+
+    /* Ordered before checking the channel again, so either we see its value or its sender sees us */
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static void waiters_remove(lesma_channel *channel, lesma_waiters *waiters, lesma_waiter *waiter) {
+    pthread_mutex_lock(&channel->lock);
+    if (waiter->prev != NULL)
+        waiter->prev->next = waiter->next;
+    else
+        waiters->first = waiter->next;
+    if (waiter->next != NULL)
+        waiter->next->prev = waiter->prev;
+    else
+        waiters->last = waiter->prev;
+    atomic_fetch_sub(&waiters->count, 1);
+    pthread_mutex_unlock(&channel->lock);
+}
+
+static bool wake(lesma_channel *channel, lesma_parker *waiting) {
+    lesma_channel *expected = NULL;
+    if (!atomic_compare_exchange_strong(&waiting->notifier, &expected, channel))
+        return false;
+
+    pthread_mutex_lock(&waiting->lock);
+    pthread_cond_signal(&waiting->cond);
+    pthread_mutex_unlock(&waiting->lock);
+    return true;
+}
+
+/* Wakes the first waiter that isn't already woken by another channel, or all of them */
+static void notify(lesma_channel *channel, lesma_waiters *waiters, bool all) {
+    /* Ordered after the operation that made the channel ready, so either we see the waiter or it sees the channel */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&waiters->count, memory_order_relaxed) == 0)
+        return;
+
+    pthread_mutex_lock(&channel->lock);
+    for (lesma_waiter *waiter = waiters->first; waiter != NULL; waiter = waiter->next)
+        if (wake(channel, waiter->parker) && !all)
+            break;
+    pthread_mutex_unlock(&channel->lock);
+}
+
+static void park(void) {
+    pthread_mutex_lock(&parker.lock);
+    while (atomic_load(&parker.notifier) == NULL)
+        pthread_cond_wait(&parker.cond, &parker.lock);
+    pthread_mutex_unlock(&parker.lock);
+}
+
+/*
+ * Called after a parked receiver took a value from channel. A receiver woken for a value of another channel, which
+ * it left to someone else, hands the notification on to the next receiver of that channel.
+ */
+static void pass_on(lesma_channel *channel) {
+    lesma_channel *notifier = atomic_load(&parker.notifier);
+    if (notifier != NULL && notifier != channel)
+        notify(notifier, &notifier->receivers, false);
+}
+
+static void spin(int attempt) {
+    if (attempt < LESMA_CHANNEL_PAUSES)
+        cpu_relax();
+    else
+        sched_yield();
+}
+
+static int64_t round_capacity(int64_t capacity) {
+    int64_t rounded = 1;
+    while (rounded < capacity)
+        rounded <<= 1;
+    return rounded;
+}
+
+void *lesma_channel_new(int64_t kind, int64_t capacity, int64_t element_size) {
+    if (kind != LESMA_CHANNEL_UNBOUNDED && capacity < 1) {
+        fprintf(stderr, "lesma: channel capacity must be at least 1, found %lld\n", (long long) capacity);
+        exit(1);
+    }
+
+    lesma_channel *channel = checked_alloc(LESMA_CACHE_LINE, sizeof(lesma_channel));
+    atomic_init(&channel->head, 0);
+    atomic_init(&channel->head_block, NULL);
+    atomic_init(&channel->tail, 0);
+    atomic_init(&channel->tail_block, NULL);
+    channel->cached_head = 0;
+    channel->cached_tail = 0;
+    channel->kind = kind;
+    channel->element_size = element_size;
+    /* Elements follow the state of their slot, aligned to 8 bytes */
+    channel->slot_size = LESMA_SLOT_HEADER + ((element_size + 7) & ~(int64_t) 7);
+    channel->capacity = capacity;
+    channel->mask = 0;
+    channel->slots = NULL;
+    atomic_init(&channel->closed, false);
+    pthread_mutex_init(&channel->lock, NULL);
+    channel->receivers = (lesma_waiters){NULL, NULL, 0};
+    channel->senders = (lesma_waiters){NULL, NULL, 0};
+
+    if (kind == LESMA_CHANNEL_UNBOUNDED) {
+        lesma_block *block = block_new(channel);
+        atomic_init(&channel->head_block, block);
+        atomic_init(&channel->tail_block, block);
+        return channel;
+    }
+
+    /* A cell of the queue tells the next producer from the next consumer by position, that takes two of them */
+    int64_t slots = round_capacity(kind == LESMA_CHANNEL_MPMC && capacity < 2 ? 2 : capacity);
+    channel->mask = slots - 1;
+    if (kind == LESMA_CHANNEL_SPSC) {
+        channel->slots = checked_alloc(LESMA_CACHE_LINE, (size_t) (slots * element_size));
+    } else {
+        channel->slots = checked_alloc(LESMA_CACHE_LINE, (size_t) (slots * channel->slot_size));
+        for (int64_t i = 0; i < slots; i++)
+            atomic_init(slot_state(channel->slots + i * channel->slot_size), i);
+    }
+    return channel;
+}
+
+bool lesma_channel_send(void *handle, const void *value) {
+    lesma_channel *channel = handle;
+    for (int attempt = 0;; attempt++) {
+        if (atomic_load_explicit(&channel->closed, memory_order_acquire))
+            return false;
+        if (try_send(channel, value)) {
+            notify(channel, &channel->receivers, false);
+            return true;
+        }
+        if (attempt < LESMA_CHANNEL_SPINS) {
+            spin(attempt);
+            continue;
+        }
+
+        /* Full for a while, sleep until a receiver makes room or the channel is closed */
+        lesma_waiter waiter;
+        atomic_store(&parker.notifier, NULL);
+        waiters_add(channel, &channel->senders, &waiter);
+        bool sent = !atomic_load(&channel->closed) && try_send(channel, value);
+        if (!sent && !atomic_load(&channel->closed)) {
+            lesma_task_blocking();
+            park();
+            lesma_task_unblocked();
+        }
+        waiters_remove(channel, &channel->senders, &waiter);
+        if (sent) {
+            notify(channel, &channel->receivers, false);
+            return true;
+        }
+        attempt = 0;
+    }
+}
+
+bool lesma_channel_recv(void *handle, void *value) {
+    lesma_channel *channel = handle;
+    for (int attempt = 0;; attempt++) {
+        /* Values sent before the channel was closed are still received */
+        bool closed = atomic_load_explicit(&channel->closed, memory_order_acquire);
+        if (try_recv(channel, value)) {
+            if (channel->kind != LESMA_CHANNEL_UNBOUNDED)
+                notify(channel, &channel->senders, false);
+            return true;
+        }
+        if (closed)
+            return false;
+        if (attempt < LESMA_CHANNEL_SPINS) {
+            spin(attempt);
+            continue;
+        }
+
+        return lesma_channel_select((void **) &channel, 1, value) >= 0;
+    }
+}
+
+/* Takes a value from the first ready channel, starting at start so every channel gets its turn */
+static int64_t select_ready(lesma_channel **channels, int64_t count, int64_t start, void *value, bool *open) {
+    *open = false;
+    for (int64_t i = 0; i < count; i++) {
+        int64_t index = (start + i) % count;
+        lesma_channel *channel = channels[index];
+        bool closed = atomic_load_explicit(&channel->closed, memory_order_acquire);
+        if (try_recv(channel, value)) {
+            if (channel->kind != LESMA_CHANNEL_UNBOUNDED)
+                notify(channel, &channel->senders, false);
+            return index;
+        }
+        /* Closed before it was found empty, so it stays empty */
+        if (!closed)
+            *open = true;
+    }
+    return -1;
+}
+
+int64_t lesma_channel_select(void **handles, int64_t count, void *value) {
+    lesma_channel **channels = (lesma_channel **) handles;
+    static _Thread_local uint64_t turn = 0;
+    int64_t start = count > 0 ? (int64_t) (turn++ % (uint64_t) count) : 0;
+
+    bool open;
+    for (int attempt = 0; attempt < LESMA_CHANNEL_SPINS; attempt++) {
+        int64_t index = select_ready(channels, count, start, value, &open);
+        if (index >= 0 || !open)
+            return index;
+        spin(attempt);
+    }
+
+    /* Nothing for a while, sleep until one of the channels has a value or gets closed */
+    lesma_waiter stack_waiters[8];
+    lesma_waiter *waiters = count <= 8 ? stack_waiters : checked_alloc(_Alignof(lesma_waiter), sizeof(lesma_waiter) * (size_t) count);
+    int64_t index;
+    for (;;) {
+        atomic_store(&parker.notifier, NULL);
+        for (int64_t i = 0; i < count; i++)
+            waiters_add(channels[i], &channels[i]->receivers, &waiters[i]);
+
+        index = select_ready(channels, count, start, value, &open);
+        if (index < 0 && open) {
+            lesma_task_blocking();
+            park();
+            lesma_task_unblocked();
+        }
+
+        for (int64_t i = 0; i < count; i++)
+            waiters_remove(channels[i], &channels[i]->receivers, &waiters[i]);
+
+        if (index < 0 && open)
+            index = select_ready(channels, count, start, value, &open);
+        if (index >= 0 || !open)
+            break;
+    }
+
+    pass_on(index >= 0 ? channels[index] : NULL);
+    if (waiters != stack_waiters)
+        free(waiters);
+    return index;
+}
+
+void lesma_channel_close(void *handle) {
+    lesma_channel *channel = handle;
+    atomic_store(&channel->closed, true);
+    notify(channel, &channel->receivers, true);
+    notify(channel, &channel->senders, true);
+}
+
+bool lesma_channel_closed(void *handle) {
+    lesma_channel *channel = handle;
+    return atomic_load_explicit(&channel->closed, memory_order_acquire);
+}
+
+void lesma_channel_free(void *handle) {
+    lesma_channel *channel = handle;
+    if (channel->kind == LESMA_CHANNEL_UNBOUNDED) {
+        /* Blocks before the head were freed by their readers */
+        lesma_block *block = atomic_load(&channel->head_block);
+        while (block != NULL) {
+            lesma_block *next = atomic_load(&block->next);
+            free(block);
+            block = next;
+        }
+    }
+    free(channel->slots);
+    pthread_mutex_destroy(&channel->lock);
+    free(channel);
+}
@@ -0,0 +1,69 @@
+#include "Runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LESMA_READY_INITIAL_SIZE 64
+
+/* Coroutines resumed between looks at the event loop while others are ready, a power of two */
+#define LESMA_EVENT_POLL_INTERVAL 64
+
+/*
+ * Coroutines ready to be resumed, in a ring buffer that doubles when it's full. Every thread runs its own
+ * coroutines, so the queue is thread local and needs no locking.
+ */
+typedef struct {
+    lesma_coroutine **items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    size_t steps;
+} lesma_ready_queue;
+
+static _Thread_local lesma_ready_queue ready = {NULL, 0, 0, 0, 0};
+
+static void grow_ready_queue(void) {
+    size_t capacity = ready.capacity == 0 ? LESMA_READY_INITIAL_SIZE : ready.capacity * 2;
+    lesma_coroutine **items = malloc(capacity * sizeof(lesma_coroutine *));
+    if (items == NULL) {
+        fprintf(stderr, "lesma: out of memory growing the ready queue\n");
+        abort();
+    }
+
+    for (size_t i = 0; i < ready.count; i++)
+        items[i] = ready.items[(ready.head + i) & (ready.capacity - 1)];
+
+    free(ready.items);
+    ready.items = items;
+    ready.capacity = capacity;
+    ready.head = 0;
+}
+
+void lesma_async_ready(lesma_coroutine *coroutine) {
+    if (ready.count == ready.capacity)
+        grow_ready_queue();
+
+    ready.items[(ready.head + ready.count) & (ready.capacity - 1)] = coroutine;
+    ready.count++;
+}
+
+void lesma_async_step(void *awaited) {
+    (void) awaited;
+
+    /* Completed I/O is picked up now and then, so coroutines waiting for it aren't starved by busy ones */
+    if ((++ready.steps & (LESMA_EVENT_POLL_INTERVAL - 1)) == 0)
+        lesma_event_poll(false);
+
+    while (ready.count == 0) {
+        if (!lesma_event_poll(true)) {
+            fprintf(stderr, "lesma: awaiting a coroutine that can never finish, no other coroutine is ready\n");
+            abort();
+        }
+    }
+
+    lesma_coroutine *coroutine = ready.items[ready.head];
+    ready.head = (ready.head + 1) & (ready.capacity - 1);
+    ready.count--;
+
+    coroutine->resume(coroutine->frame);
+}
@@ -0,0 +1,697 @@
+/* pipe2, epoll and the io_uring system calls are not part of strict C11 */
+#define _GNU_SOURCE
+
+#include "Runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LESMA_RING_ENTRIES 256
+#define LESMA_EPOLL_EVENTS 64
+#define LESMA_TIMERS_INITIAL_SIZE 16
+#define LESMA_DESCRIPTORS_INITIAL_SIZE 64
+
+typedef enum {
+    EVENT_READ,
+    EVENT_WRITE,
+    EVENT_POLL,
+    EVENT_TIMER,
+} lesma_event_kind;
+
+/*
+ * An operation waiting on the event loop, with the coroutine to queue once it's done. Reads and writes of whole
+ * files or strings are resubmitted until everything went through, a single read completes with what it got.
+ */
+typedef struct lesma_event {
+    lesma_event_kind kind;
+    lesma_coroutine *coroutine;
+    void *result;
+    int fd;
+    bool whole;
+    bool owns_fd;
+    /* Waiting for the descriptor to become ready before the read or write is submitted again */
+    bool polling;
+    uint32_t events;
+    char *buffer;
+    int64_t size;
+    int64_t done;
+    int64_t deadline;
+    struct __kernel_timespec timeout;
+    /* Next event in the free list, or waiting for the same descriptor */
+    struct lesma_event *next;
+} lesma_event;
+
+/* Operations waiting with epoll for a descriptor to become readable or writable */
+typedef struct {
+    bool registered;
+    lesma_event *readers;
+    lesma_event *writers;
+} lesma_descriptor;
+
+typedef struct {
+    int fd;
+    unsigned to_submit;
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+} lesma_ring;
+
+/*
+ * Every thread has its own event loop, created with its first operation, like its ready queue. io_uring is used
+ * when the kernel supports it, otherwise readiness is waited for with epoll and timers are kept in a binary heap.
+ * With epoll, descriptors are registered edge-triggered the first time an operation would block on them, and stay
+ * registered until lesma_event_close, so waiting again costs no system call.
+ */
+typedef struct {
+    bool initialized;
+    bool uring;
+    lesma_ring ring;
+    int epoll;
+    lesma_descriptor *descriptors;
+    size_t descriptor_count;
+    lesma_event **timers;
+    size_t timer_count;
+    size_t timer_capacity;
+    int64_t pending;
+    lesma_event *free_events;
+} lesma_event_loop;
+
+static _Thread_local lesma_event_loop loop;
+
+static void fail(const char *action, int fd, int error) {
+    fprintf(stderr, "lesma: cannot %s descriptor %d: %s\n", action, fd, strerror(error));
+    exit(1);
+}
+
+static void *checked_alloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        fprintf(stderr, "lesma: out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+static int64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool ring_init(void) {
+    const char *backend = getenv("LESMA_EVENT_LOOP");
+    if (backend != NULL && strcmp(backend, "epoll") == 0)
+        return false;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int) syscall(__NR_io_uring_setup, LESMA_RING_ENTRIES, &params);
+    if (fd < 0)
+        return false;
+
+    /* Fast poll came after reads and writes at the current position, and lets the kernel wait for readiness */
+    const unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_RW_CUR_POS | IORING_FEAT_FAST_POLL;
+    if ((params.features & needed) != needed) {
+        close(fd);
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t rings_size = sq_size > cq_size ? sq_size : cq_size;
+    char *rings = mmap(NULL, rings_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    struct io_uring_sqe *sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        munmap(rings, rings_size);
+        close(fd);
+        return false;
+    }
+
+    lesma_ring *ring = &loop.ring;
+    ring->fd = fd;
+    ring->to_submit = 0;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_head = (unsigned *) (rings + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (rings + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (rings + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (rings + params.sq_off.array);
+    ring->sqes = sqes;
+    ring->cq_head = (unsigned *) (rings + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (rings + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (rings + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (rings + params.cq_off.cqes);
+    return true;
+}
+
+static void loop_init(void) {
+    loop.initialized = true;
+    loop.uring = ring_init();
+    if (loop.uring)
+        return;
+
+    loop.epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (loop.epoll < 0) {
+        fprintf(stderr, "lesma: cannot create the event loop: %s\n", strerror(errno));
+        abort();
+    }
+}
+
+static lesma_event *event_new(lesma_event_kind kind, lesma_coroutine *coroutine, void *result, int fd) {
+    if (!loop.initialized)
+        loop_init();
+
+    lesma_event *event = loop.free_events;
+    if (event != NULL)
+        loop.free_events = event->next;
+    else
+        event = checked_alloc(malloc(sizeof(lesma_event)), sizeof(lesma_event));
+
+    memset(event, 0, sizeof(lesma_event));
+    event->kind = kind;
+    event->coroutine = coroutine;
+    event->result = result;
+    event->fd = fd;
+    loop.pending++;
+    return event;
+}
+
+static void ring_enter(unsigned min_complete) {
+    lesma_ring *ring = &loop.ring;
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (ring->to_submit > 0 || min_complete > 0) {
+        int submitted = (int) syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, min_complete, flags, NULL, 0);
+        if (submitted < 0) {
+            /* Completions that don't fit are left for the next call, once the ones that do fit are reaped */
+            if (errno == EINTR || errno == EBUSY)
+                return;
+            fprintf(stderr, "lesma: cannot submit to the event loop: %s\n", strerror(errno));
+            abort();
+        }
+        ring->to_submit -= (unsigned) submitted;
+        min_complete = 0;
+    }
+}
+
+/* Queues an entry for the event, it reaches the kernel with the next wait, so operations are submitted in batches */
+static void ring_submit(lesma_event *event) {
+    lesma_ring *ring = &loop.ring;
+    unsigned tail = *ring->sq_tail;
+    if (tail - atomic_load_explicit((_Atomic unsigned *) ring->sq_head, memory_order_acquire) == ring->sq_entries) {
+        ring_enter(0);
+        tail = *ring->sq_tail;
+    }
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = event->fd;
+    sqe->user_data = (uint64_t) (uintptr_t) event;
+
+    if (event->polling) {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll32_events = event->kind == EVENT_READ ? POLLIN : POLLOUT;
+    } else if (event->kind == EVENT_READ || event->kind == EVENT_WRITE) {
+        sqe->opcode = event->kind == EVENT_READ ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->addr = (uint64_t) (uintptr_t) (event->buffer + event->done);
+        sqe->len = (uint32_t) (event->size - event->done);
+        /* At the current position of the descriptor, which is where pipes and sockets are anyway */
+        sqe->off = (uint64_t) -1;
+    } else if (event->kind == EVENT_POLL) {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll32_events = event->events;
+    } else {
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->addr = (uint64_t) (uintptr_t) &event->timeout;
+        sqe->len = 1;
+    }
+
+    ring->sq_array[index] = index;
+    atomic_store_explicit((_Atomic unsigned *) ring->sq_tail, tail + 1, memory_order_release);
+    ring->to_submit++;
+}
+
+static void timer_swap(size_t a, size_t b) {
+    lesma_event *event = loop.timers[a];
+    loop.timers[a] = loop.timers[b];
+    loop.timers[b] = event;
+}
+
+static void timer_push(lesma_event *event) {
+    if (loop.timer_count == loop.timer_capacity) {
+        loop.timer_capacity = loop.timer_capacity == 0 ? LESMA_TIMERS_INITIAL_SIZE : loop.timer_capacity * 2;
+        size_t size = loop.timer_capacity * sizeof(lesma_event *);
+        loop.timers = checked_alloc(realloc(loop.timers, size), size);
+    }
+
+    size_t i = loop.timer_count++;
+    loop.timers[i] = event;
+    while (i > 0 && loop.timers[(i - 1) / 2]->deadline > loop.timers[i]->deadline) {
+        timer_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static lesma_event *timer_pop(void) {
+    lesma_event *first = loop.timers[0];
+    loop.timers[0] = loop.timers[--loop.timer_count];
+
+    size_t i = 0;
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < loop.timer_count && loop.timers[left]->deadline < loop.timers[smallest]->deadline)
+            smallest = left;
+        if (right < loop.timer_count && loop.timers[right]->deadline < loop.timers[smallest]->deadline)
+            smallest = right;
+        if (smallest == i)
+            return first;
+        timer_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+static void event_complete(lesma_event *event, int64_t res);
+
+static lesma_descriptor *descriptor(int fd) {
+    if ((size_t) fd >= loop.descriptor_count) {
+        size_t count = loop.descriptor_count == 0 ? LESMA_DESCRIPTORS_INITIAL_SIZE : loop.descriptor_count;
+        while (count <= (size_t) fd)
+            count *= 2;
+
+        size_t size = count * sizeof(lesma_descriptor);
+        loop.descriptors = checked_alloc(realloc(loop.descriptors, size), size);
+        memset(loop.descriptors + loop.descriptor_count, 0, (count - loop.descriptor_count) * sizeof(lesma_descriptor));
+        loop.descriptor_count = count;
+    }
+
+    return &loop.descriptors[fd];
+}
+
+/* Parks the event until epoll reports its descriptor, which only happens for changes after it's registered */
+static void epoll_wait_for(lesma_event *event) {
+    lesma_descriptor *waiting = descriptor(event->fd);
+    if (!waiting->registered) {
+        struct epoll_event registration = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data = {.fd = event->fd}};
+        if (epoll_ctl(loop.epoll, EPOLL_CTL_ADD, event->fd, &registration) < 0 && errno != EEXIST) {
+            event_complete(event, -errno);
+            return;
+        }
+        waiting->registered = true;
+    }
+
+    bool reading = event->kind == EVENT_READ || (event->kind == EVENT_POLL && (event->events & POLLIN));
+    lesma_event **list = reading ? &waiting->readers : &waiting->writers;
+    event->next = *list;
+    *list = event;
+}
+
+/* Reads and writes are attempted right away, and only wait for the descriptor when they would block */
+static void epoll_submit(lesma_event *event) {
+    if (event->kind == EVENT_POLL) {
+        /* Readiness from before the descriptor was waited for isn't reported again, so it's checked first */
+        struct pollfd poller = {.fd = event->fd, .events = (short) event->events};
+        if (poll(&poller, 1, 0) > 0)
+            event_complete(event, poller.revents & POLLNVAL ? -EBADF : 0);
+        else
+            epoll_wait_for(event);
+        return;
+    }
+
+    size_t length = (size_t) (event->size - event->done);
+    ssize_t res = event->kind == EVENT_READ ? read(event->fd, event->buffer + event->done, length)
+                                            : write(event->fd, event->buffer + event->done, length);
+    if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        epoll_wait_for(event);
+    else
+        event_complete(event, res < 0 ? -errno : res);
+}
+
+/* Retries the operations that waited for a descriptor, those that would still block go back to waiting */
+static void epoll_retry(lesma_event *waiting) {
+    while (waiting != NULL) {
+        lesma_event *event = waiting;
+        waiting = event->next;
+        event->next = NULL;
+
+        if (event->kind == EVENT_POLL)
+            event_complete(event, 0);
+        else
+            epoll_submit(event);
+    }
+}
+
+static void event_submit(lesma_event *event) {
+    if (loop.uring)
+        ring_submit(event);
+    else if (event->kind == EVENT_TIMER)
+        timer_push(event);
+    else
+        epoll_submit(event);
+}
+
+static void event_finish(lesma_event *event) {
+    if (event->owns_fd)
+        lesma_event_close(event->fd);
+
+    lesma_async_ready(event->coroutine);
+    loop.pending--;
+    event->next = loop.free_events;
+    loop.free_events = event;
+}
+
+/* Handles the result of the system call of an event, the number of bytes for reads and writes, or an error */
+static void event_complete(lesma_event *event, int64_t res) {
+    if (event->polling) {
+        event->polling = false;
+        event_submit(event);
+        return;
+    }
+
+    switch (event->kind) {
+        case EVENT_READ:
+        case EVENT_WRITE:
+            /* A descriptor without data yet, or a full pipe, is waited for before trying again */
+            if (res == -EAGAIN || res == -EINTR) {
+                event->polling = loop.uring && res == -EAGAIN;
+                event_submit(event);
+                return;
+            }
+            /* A connection closed by the other end ends reads and writes, like the end of a file */
+            if (res == -ECONNRESET || res == -EPIPE)
+                res = 0;
+            if (res < 0)
+                fail(event->kind == EVENT_READ ? "read from" : "write to", event->fd, (int) -res);
+
+            event->done += res;
+            if (event->whole && res > 0 && event->done < event->size) {
+                event_submit(event);
+                return;
+            }
+
+            if (event->kind == EVENT_READ) {
+                lesma_string_header *header = (lesma_string_header *) event->buffer - 1;
+                header->length = event->done;
+                event->buffer[event->done] = '\0';
+                *(char **) event->result = event->buffer;
+            } else {
+                *(int64_t *) event->result = event->done;
+            }
+            break;
+        case EVENT_POLL:
+            if (res < 0)
+                fail("wait for", event->fd, (int) -res);
+            break;
+        case EVENT_TIMER:
+            break;
+    }
+
+    event_finish(event);
+}
+
+static void ring_wait(bool wait) {
+    lesma_ring *ring = &loop.ring;
+    ring_enter(wait ? 1 : 0);
+
+    unsigned head = *ring->cq_head;
+    unsigned tail = atomic_load_explicit((_Atomic unsigned *) ring->cq_tail, memory_order_acquire);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        lesma_event *event = (lesma_event *) (uintptr_t) cqe->user_data;
+        int64_t res = cqe->res;
+        head++;
+        atomic_store_explicit((_Atomic unsigned *) ring->cq_head, head, memory_order_release);
+        event_complete(event, event->kind == EVENT_TIMER && res == -ETIME ? 0 : res);
+        tail = atomic_load_explicit((_Atomic unsigned *) ring->cq_tail, memory_order_acquire);
+    }
+}
+
+static void epoll_wait_events(bool wait) {
+    int timeout = 0;
+    if (wait && loop.timer_count > 0) {
+        /* Rounded up, so the earliest timer is due once epoll returns */
+        int64_t remaining = loop.timers[0]->deadline - now();
+        timeout = remaining <= 0 ? 0 : (int) ((remaining + 999999) / 1000000);
+    } else if (wait) {
+        timeout = -1;
+    }
+
+    struct epoll_event events[LESMA_EPOLL_EVENTS];
+    int count = 0;
+    if (wait && loop.pending == (int64_t) loop.timer_count && timeout > 0) {
+        /* Nothing else to wait for, sleeping is enough */
+        struct timespec sleep = {timeout / 1000, (long) (timeout % 1000) * 1000000};
+        nanosleep(&sleep, NULL);
+    } else {
+        count = epoll_wait(loop.epoll, events, LESMA_EPOLL_EVENTS, timeout);
+        if (count < 0 && errno != EINTR) {
+            fprintf(stderr, "lesma: cannot wait for the event loop: %s\n", strerror(errno));
+            abort();
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        lesma_descriptor *waiting = &loop.descriptors[events[i].data.fd];
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+            lesma_event *readers = waiting->readers;
+            waiting->readers = NULL;
+            epoll_retry(readers);
+        }
+        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+            lesma_event *writers = waiting->writers;
+            waiting->writers = NULL;
+            epoll_retry(writers);
+        }
+    }
+
+    int64_t time = now();
+    while (loop.timer_count > 0 && loop.timers[0]->deadline <= time)
+        event_complete(timer_pop(), 0);
+}
+
+bool lesma_event_poll(bool wait) {
+    if (loop.pending == 0)
+        return false;
+
+    if (loop.uring)
+        ring_wait(wait);
+    else
+        epoll_wait_events(wait);
+    return true;
+}
+
+/* Allocates a string with room for size bytes, its length is set once they are read */
+static char *read_buffer(int64_t size) {
+    lesma_string_header *header = lesma_alloc((int64_t) sizeof(lesma_string_header) + size + 1);
+    header->length = 0;
+    header->capacity = size;
+    return (char *) (header + 1);
+}
+
+void lesma_event_read(lesma_coroutine *coroutine, char **result, int64_t fd, int64_t size) {
+    lesma_event *event = event_new(EVENT_READ, coroutine, result, (int) fd);
+    event->buffer = read_buffer(size < 0 ? 0 : size);
+    event->size = size < 0 ? 0 : size;
+    event_submit(event);
+}
+
+void lesma_event_read_into(lesma_coroutine *coroutine, char **result, int64_t fd, char *buffer) {
+    lesma_event *event = event_new(EVENT_READ, coroutine, result, (int) fd);
+    event->buffer = buffer;
+    event->size = ((lesma_string_header *) buffer - 1)->capacity;
+    event_submit(event);
+}
+
+void lesma_event_write(lesma_coroutine *coroutine, int64_t *result, int64_t fd, const char *data) {
+    lesma_event *event = event_new(EVENT_WRITE, coroutine, result, (int) fd);
+    event->buffer = (char *) data;
+    event->size = lesma_string_length(data);
+    event->whole = true;
+    if (event->size == 0)
+        event_complete(event, 0);
+    else
+        event_submit(event);
+}
+
+void lesma_event_read_file(lesma_coroutine *coroutine, char **result, const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "lesma: cannot open '%s': %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    lesma_event *event = event_new(EVENT_READ, coroutine, result, fd);
+    event->buffer = read_buffer(st.st_size);
+    event->size = st.st_size;
+    event->whole = true;
+    event->owns_fd = true;
+    if (event->size == 0)
+        event_complete(event, 0);
+    else
+        event_submit(event);
+}
+
+void lesma_event_write_file(lesma_coroutine *coroutine, int64_t *result, const char *path, const char *data, int64_t append) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666);
+    if (fd < 0) {
+        fprintf(stderr, "lesma: cannot open '%s': %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    lesma_event *event = event_new(EVENT_WRITE, coroutine, result, fd);
+    event->buffer = (char *) data;
+    event->size = lesma_string_length(data);
+    event->whole = true;
+    event->owns_fd = true;
+    if (event->size == 0)
+        event_complete(event, 0);
+    else
+        event_submit(event);
+}
+
+void lesma_event_readable(lesma_coroutine *coroutine, int64_t fd) {
+    lesma_event *event = event_new(EVENT_POLL, coroutine, NULL, (int) fd);
+    event->events = POLLIN;
+    event_submit(event);
+}
+
+void lesma_event_writable(lesma_coroutine *coroutine, int64_t fd) {
+    lesma_event *event = event_new(EVENT_POLL, coroutine, NULL, (int) fd);
+    event->events = POLLOUT;
+    event_submit(event);
+}
+
+void lesma_event_sleep(lesma_coroutine *coroutine, int64_t nanoseconds) {
+    lesma_event *event = event_new(EVENT_TIMER, coroutine, NULL, -1);
+    if (nanoseconds <= 0) {
+        event_complete(event, 0);
+        return;
+    }
+
+    event->deadline = now() + nanoseconds;
+    event->timeout.tv_sec = nanoseconds / 1000000000;
+    event->timeout.tv_nsec = nanoseconds % 1000000000;
+    event_submit(event);
+}
+
+int64_t lesma_event_close(int64_t fd) {
+    /* Closing doesn't unregister descriptors that were duplicated, their events would be reported for the next one */
+    if (fd >= 0 && (size_t) fd < loop.descriptor_count && loop.descriptors[fd].registered) {
+        epoll_ctl(loop.epoll, EPOLL_CTL_DEL, (int) fd, NULL);
+        memset(&loop.descriptors[fd], 0, sizeof(lesma_descriptor));
+    }
+
+    return close((int) fd);
+}
+
+int64_t lesma_event_pipe(void) {
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+        fprintf(stderr, "lesma: cannot create a pipe: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    return (int64_t) fds[0] | (int64_t) fds[1] << 32;
+}
+
+#else
+
+/* Only Linux has an event loop so far, waiting for I/O elsewhere ends the program */
+static void unsupported(void) {
+    fprintf(stderr, "lesma: asynchronous I/O is only supported on Linux\n");
+    exit(1);
+}
+
+bool lesma_event_poll(bool wait) {
+    (void) wait;
+    return false;
+}
+
+void lesma_event_read(lesma_coroutine *coroutine, char **result, int64_t fd, int64_t size) {
+    (void) coroutine;
+    (void) result;
+    (void) fd;
+    (void) size;
+    unsupported();
+}
+void lesma_event_read_into(lesma_coroutine *coroutine, char **result, int64_t fd, char *buffer) {
+    (void) coroutine;
+    (void) result;
+    (void) fd;
+    (void) buffer;
+    unsupported();
+}
+void lesma_event_write(lesma_coroutine *coroutine, int64_t *result, int64_t fd, const char *data) {
+    (void) coroutine;
+    (void) result;
+    (void) fd;
+    (void) data;
+    unsupported();
+}
+void lesma_event_read_file(lesma_coroutine *coroutine, char **result, const char *path) {
+    (void) coroutine;
+    (void) result;
+    (void) path;
+    unsupported();
+}
+void lesma_event_write_file(lesma_coroutine *coroutine, int64_t *result, const char *path, const char *data, int64_t append) {
+    (void) coroutine;
+    (void) result;
+    (void) path;
+    (void) data;
+    (void) append;
+    unsupported();
+}
+void lesma_event_readable(lesma_coroutine *coroutine, int64_t fd) {
+    (void) coroutine;
+    (void) fd;
+    unsupported();
+}
+void lesma_event_writable(lesma_coroutine *coroutine, int64_t fd) {
+    (void) coroutine;
+    (void) fd;
+    unsupported();
+}
+void lesma_event_sleep(lesma_coroutine *coroutine, int64_t nanoseconds) {
+    (void) coroutine;
+    (void) nanoseconds;
+    unsupported();
+}
+int64_t lesma_event_close(int64_t fd) {
+    (void) fd;
+    unsupported();
+    return -1;
+}
+int64_t lesma_event_pipe(void) {
+    unsupported();
+    return 0;
+}
+
+#endif
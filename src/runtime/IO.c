@@ -0,0 +1,401 @@
+/* MAP_ANONYMOUS and posix_fadvise are not part of strict C11 */
+#define _DEFAULT_SOURCE
+
+#include "Runtime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 32))
+#include <sys/single_threaded.h>
+#define LESMA_SINGLE_THREADED() __libc_single_threaded
+#else
+#define LESMA_SINGLE_THREADED() false
+#endif
+
+#define LESMA_OUTPUT_BUFFER_SIZE (64 * 1024)
+#define LESMA_READER_BUFFER_SIZE (256 * 1024)
+#define LESMA_LINE_MIN_CAPACITY 128
+
+/*
+ * Everything written to the standard output or to a file goes through the buffer of a writer, and only reaches
+ * the system when it's full. Open writers are kept in a list, so whatever is still buffered is written at exit.
+ * Tasks and programs compiled side by side in one process share writers, so each one has a lock around its buffer.
+ */
+struct lesma_writer {
+    struct lesma_writer *next;
+    struct lesma_writer *prev;
+    pthread_mutex_t lock;
+    int fd;
+    bool line_buffered;
+    size_t length;
+    char *buffer;
+};
+
+struct lesma_reader {
+    int fd;
+    bool eof;
+    size_t start;
+    size_t end;
+    char *buffer;
+    lesma_string_header *line;
+    char *path;
+};
+
+static char output_buffer[LESMA_OUTPUT_BUFFER_SIZE];
+static lesma_writer standard_output = {NULL, NULL, PTHREAD_MUTEX_INITIALIZER, STDOUT_FILENO, false, 0, output_buffer};
+static lesma_writer *open_writers = &standard_output;
+static pthread_mutex_t open_writers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t output_once = PTHREAD_ONCE_INIT;
+static atomic_bool output_initialized = false;
+
+static void fail(const char *action, const char *path) {
+    fprintf(stderr, "lesma: cannot %s '%s': %s\n", action, path, strerror(errno));
+    exit(1);
+}
+
+static void *checked_alloc(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        fprintf(stderr, "lesma: out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+static void flush_open_writers(void) {
+    /* printf and friends have their own buffer, so it's emptied first */
+    fflush(stdout);
+    pthread_mutex_lock(&open_writers_lock);
+    for (lesma_writer *writer = open_writers; writer != NULL; writer = writer->next)
+        lesma_writer_flush(writer);
+    pthread_mutex_unlock(&open_writers_lock);
+}
+
+static void output_init(void) {
+    /* A terminal shows every line as soon as it's complete, pipes and files get the whole buffer */
+    standard_output.line_buffered = isatty(STDOUT_FILENO);
+    atexit(flush_open_writers);
+#ifndef __APPLE__
+    /* lesma server ends requests with quick_exit, which skips the destructors of the compiler but not this */
+    at_quick_exit(flush_open_writers);
+#endif
+    atomic_store_explicit(&output_initialized, true, memory_order_release);
+}
+
+/* The flag spares every write a call into pthread_once */
+static void ensure_output_init(void) {
+    if (!atomic_load_explicit(&output_initialized, memory_order_acquire))
+        pthread_once(&output_once, output_init);
+}
+
+static void write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        /* Nothing sensible to do when the output is gone, like a closed pipe, the rest is dropped */
+        if (written <= 0)
+            return;
+
+        data += written;
+        length -= (size_t) written;
+    }
+}
+
+/*
+ * Until a process starts a second thread nobody else can hold the lock, so it's skipped like the C library does for
+ * its own streams. The process can become single threaded again once its other threads exit, so the lock returns
+ * whether it was taken and the unlock goes by that rather than by the current state.
+ */
+static bool writer_lock(lesma_writer *writer) {
+    if (LESMA_SINGLE_THREADED())
+        return false;
+
+    pthread_mutex_lock(&writer->lock);
+    return true;
+}
+
+static void writer_unlock(lesma_writer *writer, bool locked) {
+    if (locked)
+        pthread_mutex_unlock(&writer->lock);
+}
+
+static void flush_locked(lesma_writer *writer) {
+    write_all(writer->fd, writer->buffer, writer->length);
+    writer->length = 0;
+}
+
+/*
+ * Locks the writer and returns room for at least size bytes at the end of its buffer, size must fit in the buffer.
+ * Whether the lock was taken is stored in locked, for the matching unlock.
+ */
+static char *reserve(lesma_writer *writer, size_t size, bool *locked) {
+    ensure_output_init();
+    *locked = writer_lock(writer);
+    if (writer->length + size > LESMA_OUTPUT_BUFFER_SIZE)
+        flush_locked(writer);
+
+    return writer->buffer + writer->length;
+}
+
+void lesma_flush(void) {
+    fflush(stdout);
+    lesma_writer_flush(&standard_output);
+}
+
+void lesma_panic(const char *message) {
+    lesma_flush();
+    fprintf(stderr, "lesma: %s\n", message);
+    exit(1);
+}
+
+void lesma_write_string(const char *str) {
+    lesma_writer_write_string(&standard_output, str);
+}
+
+void lesma_write_int(int64_t value) {
+    lesma_writer_write_int(&standard_output, value);
+}
+
+void lesma_write_float(double value) {
+    lesma_writer_write_float(&standard_output, value);
+}
+
+void lesma_write_newline(void) {
+    bool locked;
+    *reserve(&standard_output, 1, &locked) = '\n';
+    standard_output.length++;
+    writer_unlock(&standard_output, locked);
+
+    if (standard_output.line_buffered)
+        lesma_flush();
+}
+
+lesma_writer *lesma_writer_open(const char *path, int64_t append) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666);
+    if (fd < 0)
+        fail("open", path);
+
+    lesma_writer *writer = checked_alloc(malloc(sizeof(lesma_writer)), sizeof(lesma_writer));
+    writer->buffer = checked_alloc(malloc(LESMA_OUTPUT_BUFFER_SIZE), LESMA_OUTPUT_BUFFER_SIZE);
+    pthread_mutex_init(&writer->lock, NULL);
+    writer->fd = fd;
+    writer->line_buffered = false;
+    writer->length = 0;
+
+    ensure_output_init();
+    pthread_mutex_lock(&open_writers_lock);
+    writer->prev = NULL;
+    writer->next = open_writers;
+    open_writers->prev = writer;
+    open_writers = writer;
+    pthread_mutex_unlock(&open_writers_lock);
+    return writer;
+}
+
+void lesma_writer_write_string(lesma_writer *writer, const char *str) {
+    size_t length = (size_t) lesma_string_length(str);
+    bool locked;
+    if (length > LESMA_OUTPUT_BUFFER_SIZE / 2) {
+        /* Big strings go out directly, after what is already buffered */
+        reserve(writer, 0, &locked);
+        flush_locked(writer);
+        write_all(writer->fd, str, length);
+        writer_unlock(writer, locked);
+        return;
+    }
+
+    memcpy(reserve(writer, length, &locked), str, length);
+    writer->length += length;
+    writer_unlock(writer, locked);
+}
+
+void lesma_writer_write_int(lesma_writer *writer, int64_t value) {
+    /* The length is only read once reserve holds the lock, and possibly flushed the buffer */
+    bool locked;
+    char *dst = reserve(writer, LESMA_FORMAT_INT_SIZE, &locked);
+    writer->length += (size_t) lesma_format_int(dst, value);
+    writer_unlock(writer, locked);
+}
+
+void lesma_writer_write_float(lesma_writer *writer, double value) {
+    bool locked;
+    char *dst = reserve(writer, LESMA_FORMAT_FLOAT_SIZE, &locked);
+    writer->length += (size_t) lesma_format_float(dst, value);
+    writer_unlock(writer, locked);
+}
+
+void lesma_writer_flush(lesma_writer *writer) {
+    bool locked = writer_lock(writer);
+    flush_locked(writer);
+    writer_unlock(writer, locked);
+}
+
+void lesma_writer_close(lesma_writer *writer) {
+    pthread_mutex_lock(&open_writers_lock);
+    if (writer->prev != NULL)
+        writer->prev->next = writer->next;
+    else
+        open_writers = writer->next;
+    if (writer->next != NULL)
+        writer->next->prev = writer->prev;
+    pthread_mutex_unlock(&open_writers_lock);
+
+    lesma_writer_flush(writer);
+    close(writer->fd);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->buffer);
+    free(writer);
+}
+
+bool lesma_file_exists(const char *path) {
+    return access(path, F_OK) == 0;
+}
+
+bool lesma_file_remove(const char *path) {
+    return unlink(path) == 0;
+}
+
+/*
+ * The file is mapped one page into an anonymous reservation: the header of the string goes at the end of the page
+ * in front, and the zeroes after the end of the file, up to the page after it, are the null terminator.
+ */
+static size_t mapping_size(size_t length, size_t page) {
+    return page + ((length + page - 1) & ~(page - 1)) + page;
+}
+
+char *lesma_file_map(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        fail("open", path);
+
+    struct stat info;
+    if (fstat(fd, &info) < 0)
+        fail("read", path);
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t length = (size_t) info.st_size;
+    char *base = mmap(NULL, mapping_size(length, page), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        fail("map", path);
+    if (length > 0 && mmap(base + page, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+        fail("map", path);
+    close(fd);
+
+    lesma_string_header *header = (lesma_string_header *) (base + page) - 1;
+    header->length = (int64_t) length;
+    header->capacity = (int64_t) length;
+
+    /* Strings are immutable, the header page is sealed like the file */
+    mprotect(base, page, PROT_READ);
+    return base + page;
+}
+
+void lesma_file_unmap(const char *contents) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    munmap((char *) contents - page, mapping_size((size_t) lesma_string_length(contents), page));
+}
+
+lesma_reader *lesma_reader_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        fail("open", path);
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    lesma_reader *reader = checked_alloc(malloc(sizeof(lesma_reader)), sizeof(lesma_reader));
+    reader->fd = fd;
+    reader->eof = false;
+    reader->start = 0;
+    reader->end = 0;
+    reader->buffer = checked_alloc(malloc(LESMA_READER_BUFFER_SIZE), LESMA_READER_BUFFER_SIZE);
+    reader->path = checked_alloc(strdup(path), strlen(path) + 1);
+
+    /* The line lives outside of the Lesma heap, so it outlives any region the reader is used in */
+    size_t size = sizeof(lesma_string_header) + LESMA_LINE_MIN_CAPACITY + 1;
+    reader->line = checked_alloc(malloc(size), size);
+    reader->line->length = 0;
+    reader->line->capacity = LESMA_LINE_MIN_CAPACITY;
+    ((char *) (reader->line + 1))[0] = '\0';
+    return reader;
+}
+
+static void append_to_line(lesma_reader *reader, const char *data, size_t length) {
+    lesma_string_header *line = reader->line;
+    if (line->length + (int64_t) length > line->capacity) {
+        int64_t capacity = line->capacity;
+        while (capacity < line->length + (int64_t) length)
+            capacity *= 2;
+
+        size_t size = sizeof(lesma_string_header) + (size_t) capacity + 1;
+        line = checked_alloc(realloc(line, size), size);
+        line->capacity = capacity;
+        reader->line = line;
+    }
+
+    memcpy((char *) (line + 1) + line->length, data, length);
+    line->length += (int64_t) length;
+}
+
+bool lesma_reader_next(lesma_reader *reader) {
+    reader->line->length = 0;
+    bool found = false;
+
+    while (true) {
+        if (reader->start == reader->end) {
+            if (reader->eof)
+                break;
+
+            ssize_t count = read(reader->fd, reader->buffer, LESMA_READER_BUFFER_SIZE);
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count < 0)
+                fail("read", reader->path);
+
+            reader->start = 0;
+            reader->end = (size_t) count;
+            reader->eof = count == 0;
+            continue;
+        }
+
+        /* A line can span several reads, its pieces are gathered in the line buffer */
+        char *data = reader->buffer + reader->start;
+        char *newline = memchr(data, '\n', reader->end - reader->start);
+        size_t length = newline != NULL ? (size_t) (newline - data) : reader->end - reader->start;
+        append_to_line(reader, data, length);
+        found = true;
+
+        reader->start += length;
+        if (newline != NULL) {
+            reader->start++;
+            break;
+        }
+    }
+
+    char *line = (char *) (reader->line + 1);
+    if (reader->line->length > 0 && line[reader->line->length - 1] == '\r')
+        reader->line->length--;
+    line[reader->line->length] = '\0';
+    return found;
+}
+
+char *lesma_reader_line(lesma_reader *reader) {
+    return (char *) (reader->line + 1);
+}
+
+void lesma_reader_close(lesma_reader *reader) {
+    close(reader->fd);
+    free(reader->buffer);
+    free(reader->line);
+    free(reader->path);
+    free(reader);
+}
@@ -0,0 +1,285 @@
+#include "Runtime.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LESMA_ALIGNMENT 16
+#define LESMA_CHUNK_SIZE (64 * 1024)
+#define LESMA_LARGE_OBJECT (LESMA_CHUNK_SIZE / 4)
+#define LESMA_MAX_SPARE_CHUNKS 16
+
+/* A thread keeps at most LESMA_CACHE_LIMIT free objects per size class, they move to and from the shared lists in batches */
+#define LESMA_CACHE_LIMIT 512
+#define LESMA_BATCH_SIZE 256
+
+/*
+ * All memory handed out by the runtime lives in chunks aligned to LESMA_CHUNK_SIZE, so the chunk owning an object
+ * is found by masking its address. The header sits at the start of the chunk, padded to keep the data aligned.
+ */
+typedef enum {
+    LESMA_CHUNK_REGION,
+    LESMA_CHUNK_POOL,
+    LESMA_CHUNK_LARGE,
+} lesma_chunk_kind;
+
+typedef struct lesma_chunk {
+    struct lesma_chunk *next;
+    size_t size;
+    lesma_chunk_kind kind;
+    int size_class;
+} lesma_chunk;
+
+#define LESMA_CHUNK_HEADER ((sizeof(lesma_chunk) + LESMA_ALIGNMENT - 1) & ~(size_t) (LESMA_ALIGNMENT - 1))
+#define LESMA_CHUNK_DATA(chunk) ((char *) (chunk) + LESMA_CHUNK_HEADER)
+
+typedef struct lesma_region {
+    struct lesma_region *parent;
+    lesma_chunk *chunks;
+    char *cursor;
+    char *end;
+} lesma_region;
+
+typedef struct lesma_free_object {
+    struct lesma_free_object *next;
+} lesma_free_object;
+
+typedef struct lesma_free_list {
+    lesma_free_object *head;
+    int count;
+} lesma_free_list;
+
+/* Objects smaller than LESMA_LARGE_OBJECT are rounded up to one of these sizes */
+static const size_t size_classes[] = {
+        16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240, 256,
+        320, 384, 448, 512, 640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+        2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192, 10240, 12288, 14336, LESMA_LARGE_OBJECT};
+
+#define LESMA_SIZE_CLASS_COUNT (int) (sizeof(size_classes) / sizeof(size_classes[0]))
+
+static _Thread_local lesma_region *current_region = NULL;
+static _Thread_local lesma_free_list thread_cache[LESMA_SIZE_CLASS_COUNT];
+
+/* Released regions and chunks are kept around, so a region entered in a loop doesn't go back to malloc */
+static _Thread_local lesma_region *spare_regions = NULL;
+static _Thread_local lesma_chunk *spare_chunks = NULL;
+static _Thread_local int spare_chunk_count = 0;
+
+/* Free objects shared by all threads, refilled by threads whose cache overflows */
+static lesma_free_list shared_lists[LESMA_SIZE_CLASS_COUNT];
+static pthread_mutex_t shared_locks[LESMA_SIZE_CLASS_COUNT];
+static pthread_once_t shared_locks_once = PTHREAD_ONCE_INIT;
+
+static void out_of_memory(size_t size) {
+    fprintf(stderr, "lesma: out of memory allocating %zu bytes\n", size);
+    abort();
+}
+
+static void init_shared_locks(void) {
+    for (int i = 0; i < LESMA_SIZE_CLASS_COUNT; i++)
+        pthread_mutex_init(&shared_locks[i], NULL);
+}
+
+static lesma_chunk *new_chunk(size_t size, lesma_chunk_kind kind) {
+    size_t total = (LESMA_CHUNK_HEADER + size + LESMA_CHUNK_SIZE - 1) & ~(size_t) (LESMA_CHUNK_SIZE - 1);
+
+    lesma_chunk *chunk = NULL;
+    if (total == LESMA_CHUNK_SIZE && spare_chunks != NULL) {
+        chunk = spare_chunks;
+        spare_chunks = chunk->next;
+        spare_chunk_count--;
+    } else {
+        chunk = aligned_alloc(LESMA_CHUNK_SIZE, total);
+        if (chunk == NULL)
+            out_of_memory(total);
+    }
+
+    chunk->next = NULL;
+    chunk->size = total - LESMA_CHUNK_HEADER;
+    chunk->kind = kind;
+    chunk->size_class = -1;
+    return chunk;
+}
+
+static void release_chunk(lesma_chunk *chunk) {
+    if (chunk->size + LESMA_CHUNK_HEADER == LESMA_CHUNK_SIZE && spare_chunk_count < LESMA_MAX_SPARE_CHUNKS) {
+        chunk->next = spare_chunks;
+        spare_chunks = chunk;
+        spare_chunk_count++;
+        return;
+    }
+
+    free(chunk);
+}
+
+static size_t round_size(int64_t size) {
+    size_t rounded = ((size_t) size + LESMA_ALIGNMENT - 1) & ~(size_t) (LESMA_ALIGNMENT - 1);
+    return rounded == 0 ? LESMA_ALIGNMENT : rounded;
+}
+
+static void *region_alloc(lesma_region *region, size_t size) {
+    if ((size_t) (region->end - region->cursor) >= size) {
+        void *ptr = region->cursor;
+        region->cursor += size;
+        return ptr;
+    }
+
+    /* Large objects get a chunk of their own, the current chunk stays in use */
+    if (size >= LESMA_LARGE_OBJECT) {
+        lesma_chunk *chunk = new_chunk(size, LESMA_CHUNK_REGION);
+        chunk->next = region->chunks;
+        region->chunks = chunk;
+        return LESMA_CHUNK_DATA(chunk);
+    }
+
+    lesma_chunk *chunk = new_chunk(LESMA_CHUNK_SIZE - LESMA_CHUNK_HEADER, LESMA_CHUNK_REGION);
+    chunk->next = region->chunks;
+    region->chunks = chunk;
+    region->cursor = LESMA_CHUNK_DATA(chunk) + size;
+    region->end = LESMA_CHUNK_DATA(chunk) + chunk->size;
+    return LESMA_CHUNK_DATA(chunk);
+}
+
+static int size_class_of(size_t size) {
+    if (size <= 256)
+        return (int) (size / LESMA_ALIGNMENT) - 1;
+
+    int size_class = 16;
+    while (size_classes[size_class] < size)
+        size_class++;
+    return size_class;
+}
+
+/* Moves up to count objects from one list to another, returns how many were moved */
+static int move_objects(lesma_free_list *from, lesma_free_list *to, int count) {
+    int moved = 0;
+    while (moved < count && from->head != NULL) {
+        lesma_free_object *object = from->head;
+        from->head = object->next;
+        object->next = to->head;
+        to->head = object;
+        moved++;
+    }
+
+    from->count -= moved;
+    to->count += moved;
+    return moved;
+}
+
+/* Refills an empty thread cache, first from the shared list, then by carving a new chunk into objects */
+static void refill(int size_class) {
+    lesma_free_list *cache = &thread_cache[size_class];
+
+    pthread_once(&shared_locks_once, init_shared_locks);
+    pthread_mutex_lock(&shared_locks[size_class]);
+    int moved = move_objects(&shared_lists[size_class], cache, LESMA_BATCH_SIZE);
+    pthread_mutex_unlock(&shared_locks[size_class]);
+    if (moved > 0)
+        return;
+
+    size_t object_size = size_classes[size_class];
+    lesma_chunk *chunk = new_chunk(LESMA_CHUNK_SIZE - LESMA_CHUNK_HEADER, LESMA_CHUNK_POOL);
+    chunk->size_class = size_class;
+
+    /* Linked back to front, so objects are handed out in address order */
+    char *data = LESMA_CHUNK_DATA(chunk);
+    for (size_t offset = (chunk->size / object_size) * object_size; offset > 0; offset -= object_size) {
+        lesma_free_object *object = (lesma_free_object *) (data + offset - object_size);
+        object->next = cache->head;
+        cache->head = object;
+        cache->count++;
+    }
+}
+
+static void pool_free(void *ptr, int size_class) {
+    lesma_free_list *cache = &thread_cache[size_class];
+    lesma_free_object *object = ptr;
+    object->next = cache->head;
+    cache->head = object;
+    cache->count++;
+
+    if (cache->count > LESMA_CACHE_LIMIT) {
+        pthread_once(&shared_locks_once, init_shared_locks);
+        pthread_mutex_lock(&shared_locks[size_class]);
+        move_objects(cache, &shared_lists[size_class], LESMA_BATCH_SIZE);
+        pthread_mutex_unlock(&shared_locks[size_class]);
+    }
+}
+
+static void *pool_alloc(size_t rounded) {
+    if (rounded > LESMA_LARGE_OBJECT)
+        return LESMA_CHUNK_DATA(new_chunk(rounded, LESMA_CHUNK_LARGE));
+
+    int size_class = size_class_of(rounded);
+    lesma_free_list *cache = &thread_cache[size_class];
+    if (cache->head == NULL)
+        refill(size_class);
+
+    lesma_free_object *object = cache->head;
+    cache->head = object->next;
+    cache->count--;
+    return object;
+}
+
+void *lesma_alloc(int64_t size) {
+    size_t rounded = round_size(size);
+    if (current_region != NULL)
+        return region_alloc(current_region, rounded);
+    return pool_alloc(rounded);
+}
+
+void *lesma_alloc_frame(int64_t size) {
+    return pool_alloc(round_size(size));
+}
+
+void lesma_free(void *ptr) {
+    if (ptr == NULL)
+        return;
+
+    lesma_chunk *chunk = (lesma_chunk *) ((uintptr_t) ptr & ~(uintptr_t) (LESMA_CHUNK_SIZE - 1));
+    switch (chunk->kind) {
+        case LESMA_CHUNK_POOL:
+            pool_free(ptr, chunk->size_class);
+            break;
+        case LESMA_CHUNK_LARGE:
+            free(chunk);
+            break;
+        case LESMA_CHUNK_REGION:
+            /* Released together with its region */
+            break;
+    }
+}
+
+void lesma_region_enter(void) {
+    lesma_region *region = spare_regions;
+    if (region != NULL) {
+        spare_regions = region->parent;
+    } else {
+        region = malloc(sizeof(lesma_region));
+        if (region == NULL)
+            out_of_memory(sizeof(lesma_region));
+    }
+
+    region->parent = current_region;
+    region->chunks = NULL;
+    region->cursor = NULL;
+    region->end = NULL;
+    current_region = region;
+}
+
+void lesma_region_exit(void) {
+    lesma_region *region = current_region;
+    if (region == NULL) {
+        fprintf(stderr, "lesma: region exited without being entered\n");
+        abort();
+    }
+
+    for (lesma_chunk *chunk = region->chunks, *next; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        release_chunk(chunk);
+    }
+
+    current_region = region->parent;
+    region->parent = spare_regions;
+    spare_regions = region;
+}
@@ -0,0 +1,282 @@
+/* accept4 and getaddrinfo are not part of strict C11 */
+#define _GNU_SOURCE
+
+#include "Runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Released buffers a thread keeps for later connections, the others are freed */
+#define LESMA_NET_POOLED_BUFFERS 256
+
+/* Buffers are linked through their first bytes while they're in the pool */
+typedef struct {
+    char *first;
+    size_t count;
+} lesma_buffer_pool;
+
+static _Thread_local lesma_buffer_pool pool = {NULL, 0};
+
+/* Requests and responses are small and written whole, so they're sent right away */
+static void set_nodelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static struct addrinfo *resolve(const char *host, int64_t port, bool passive) {
+    char service[LESMA_FORMAT_INT_SIZE + 1];
+    service[lesma_format_int(service, port)] = '\0';
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | (passive ? AI_PASSIVE : 0);
+
+    struct addrinfo *addresses;
+    int error = getaddrinfo(host[0] == '\0' ? NULL : host, service, &hints, &addresses);
+    if (error != 0) {
+        fprintf(stderr, "lesma: cannot resolve '%s': %s\n", host, gai_strerror(error));
+        exit(1);
+    }
+    return addresses;
+}
+
+int64_t lesma_net_listen(const char *host, int64_t port, int64_t reuse_port) {
+    signal(SIGPIPE, SIG_IGN);
+
+    struct addrinfo *addresses = resolve(host, port, true);
+    int fd = -1;
+    int error = 0;
+    for (struct addrinfo *address = addresses; address != NULL && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            error = errno;
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if ((reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) ||
+            bind(fd, address->ai_addr, address->ai_addrlen) < 0 || listen(fd, SOMAXCONN) < 0) {
+            error = errno;
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (fd < 0) {
+        fprintf(stderr, "lesma: cannot listen on %s:%lld: %s\n", host, (long long) port, strerror(error));
+        exit(1);
+    }
+    return fd;
+}
+
+int64_t lesma_net_local_port(int64_t fd) {
+    struct sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    if (getsockname((int) fd, (struct sockaddr *) &address, &length) < 0) {
+        fprintf(stderr, "lesma: cannot get the address of descriptor %lld: %s\n", (long long) fd, strerror(errno));
+        exit(1);
+    }
+
+    if (address.ss_family == AF_INET6)
+        return ntohs(((struct sockaddr_in6 *) &address)->sin6_port);
+    return ntohs(((struct sockaddr_in *) &address)->sin_port);
+}
+
+int64_t lesma_net_accept(int64_t fd) {
+    for (;;) {
+        int connection = accept4((int) fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (connection >= 0) {
+            set_nodelay(connection);
+            return connection;
+        }
+
+        /* Connections reset before they were accepted are skipped */
+        if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -1;
+
+        fprintf(stderr, "lesma: cannot accept connections on descriptor %lld: %s\n", (long long) fd, strerror(errno));
+        exit(1);
+    }
+}
+
+struct lesma_connect {
+    struct addrinfo *addresses;
+    /* Tried after the one being connected to */
+    struct addrinfo *next;
+    int fd;
+    int error;
+    int64_t port;
+    char host[];
+};
+
+/* Starts connecting to the next address that doesn't fail right away, exits once none are left */
+static void connect_next(lesma_connect *attempt) {
+    attempt->fd = -1;
+    while (attempt->next != NULL && attempt->fd < 0) {
+        struct addrinfo *address = attempt->next;
+        attempt->next = address->ai_next;
+
+        int fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            attempt->error = errno;
+            continue;
+        }
+
+        if (connect(fd, address->ai_addr, address->ai_addrlen) < 0 && errno != EINPROGRESS) {
+            attempt->error = errno;
+            close(fd);
+            continue;
+        }
+        attempt->fd = fd;
+    }
+
+    if (attempt->fd < 0) {
+        fprintf(stderr, "lesma: cannot connect to %s:%lld: %s\n", attempt->host, (long long) attempt->port, strerror(attempt->error));
+        exit(1);
+    }
+}
+
+lesma_connect *lesma_net_connect(const char *host, int64_t port) {
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t size = sizeof(lesma_connect) + strlen(host) + 1;
+    lesma_connect *attempt = malloc(size);
+    if (attempt == NULL) {
+        fprintf(stderr, "lesma: out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    strcpy(attempt->host, host);
+    attempt->port = port;
+    attempt->error = 0;
+    attempt->addresses = resolve(host, port, false);
+    attempt->next = attempt->addresses;
+    connect_next(attempt);
+    return attempt;
+}
+
+int64_t lesma_net_connecting(lesma_connect *attempt) {
+    return attempt->fd;
+}
+
+int64_t lesma_net_connected(lesma_connect *attempt) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(attempt->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+        error = errno;
+
+    /* Failures found once the connection is writable move on too, like ::1 when the server only listens on IPv4 */
+    if (error != 0) {
+        attempt->error = error;
+        lesma_event_close(attempt->fd);
+        connect_next(attempt);
+        return -1;
+    }
+
+    int fd = attempt->fd;
+    freeaddrinfo(attempt->addresses);
+    free(attempt);
+    set_nodelay(fd);
+    return fd;
+}
+
+char *lesma_net_buffer_acquire(void) {
+    char *buffer = pool.first;
+    if (buffer != NULL) {
+        pool.first = *(char **) buffer;
+        pool.count--;
+    } else {
+        /* Not from lesma_alloc, connections outlive the regions they may be opened in */
+        size_t size = sizeof(lesma_string_header) + LESMA_NET_BUFFER_SIZE + 1;
+        lesma_string_header *header = malloc(size);
+        if (header == NULL) {
+            fprintf(stderr, "lesma: out of memory allocating %zu bytes\n", size);
+            abort();
+        }
+        header->capacity = LESMA_NET_BUFFER_SIZE;
+        buffer = (char *) (header + 1);
+    }
+
+    ((lesma_string_header *) buffer - 1)->length = 0;
+    buffer[0] = '\0';
+    return buffer;
+}
+
+void lesma_net_buffer_release(char *buffer) {
+    if (pool.count == LESMA_NET_POOLED_BUFFERS) {
+        free((lesma_string_header *) buffer - 1);
+        return;
+    }
+
+    *(char **) buffer = pool.first;
+    pool.first = buffer;
+    pool.count++;
+}
+
+#else
+
+/* Sockets are waited for with the event loop, which only exists on Linux so far */
+static void unsupported(void) {
+    fprintf(stderr, "lesma: networking is only supported on Linux\n");
+    exit(1);
+}
+
+int64_t lesma_net_listen(const char *host, int64_t port, int64_t reuse_port) {
+    (void) host;
+    (void) port;
+    (void) reuse_port;
+    unsupported();
+    return -1;
+}
+int64_t lesma_net_local_port(int64_t fd) {
+    (void) fd;
+    unsupported();
+    return -1;
+}
+int64_t lesma_net_accept(int64_t fd) {
+    (void) fd;
+    unsupported();
+    return -1;
+}
+lesma_connect *lesma_net_connect(const char *host, int64_t port) {
+    (void) host;
+    (void) port;
+    unsupported();
+    return NULL;
+}
+int64_t lesma_net_connecting(lesma_connect *attempt) {
+    (void) attempt;
+    unsupported();
+    return -1;
+}
+int64_t lesma_net_connected(lesma_connect *attempt) {
+    (void) attempt;
+    unsupported();
+    return -1;
+}
+char *lesma_net_buffer_acquire(void) {
+    unsupported();
+    return NULL;
+}
+void lesma_net_buffer_release(char *buffer) {
+    (void) buffer;
+    unsupported();
+}
+
+#endif
@@ -0,0 +1,422 @@
+#pragma once
+
+/**
+ * Lesma runtime library. It is linked into every executable produced by `lesma compile`, and into the
+ * compiler itself so the JIT can resolve the same symbols.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Allocates memory for an object that outlives the frame which created it, aligned to 16 bytes.
+ * The memory belongs to the innermost open region of the thread, otherwise it comes from per-thread size-class
+ * pools and lives until it is given to lesma_free. Aborts when the system is out of memory, the result is never null.
+ */
+void *lesma_alloc(int64_t size);
+
+/**
+ * Allocates the frame of a coroutine like lesma_alloc, but never inside a region, a coroutine can outlive the region
+ * it was started in. Released with lesma_free.
+ */
+void *lesma_alloc_frame(int64_t size);
+
+/**
+ * Returns memory from lesma_alloc to its pool, from any thread. Memory owned by a region is left to the region.
+ */
+void lesma_free(void *ptr);
+
+/**
+ * Opens a region on the current thread. Until the matching lesma_region_exit, every lesma_alloc of the thread
+ * is bump allocated inside the region, and all of it is released at once when the region exits.
+ */
+void lesma_region_enter(void);
+
+/**
+ * Releases everything allocated since the matching lesma_region_enter and returns to the enclosing region.
+ */
+void lesma_region_exit(void);
+
+/**
+ * Header in front of the bytes of every Lesma string. A string is passed around as a pointer to its bytes,
+ * which are always followed by a null terminator, so it can be handed to C functions without a copy.
+ */
+typedef struct {
+    int64_t length;
+    int64_t capacity;
+} lesma_string_header;
+
+/**
+ * Returns the length of a string in bytes, without looking at its contents.
+ */
+int64_t lesma_string_length(const char *str);
+
+/**
+ * Copies a null terminated C string into a new Lesma string, null becomes the empty string.
+ */
+char *lesma_string_from_c(const char *str);
+
+/**
+ * Returns the concatenation of two strings. When either of them is empty the other one is returned without a copy.
+ */
+char *lesma_string_concat(const char *left, const char *right);
+
+/**
+ * Checks whether two strings hold the same bytes, strings of different lengths are rejected without reading them.
+ */
+bool lesma_string_equal(const char *left, const char *right);
+
+/**
+ * Compares two strings byte by byte, returning a negative number, zero or a positive number like memcmp.
+ * A string that is a prefix of the other one is the smaller one.
+ */
+int64_t lesma_string_compare(const char *left, const char *right);
+
+/**
+ * Returns the bytes between start and end, negative indices count from the end of the string and indices out
+ * of range are clamped. Slicing the whole string returns it without a copy.
+ */
+char *lesma_string_slice(const char *str, int64_t start, int64_t end);
+
+/** Most bytes written by lesma_format_int and lesma_format_float */
+#define LESMA_FORMAT_INT_SIZE 20
+#define LESMA_FORMAT_FLOAT_SIZE 32
+
+/**
+ * Writes the decimal digits of an integer to dst, which has room for LESMA_FORMAT_INT_SIZE bytes, and returns
+ * how many were written. No null terminator is added.
+ */
+int64_t lesma_format_int(char *dst, int64_t value);
+
+/**
+ * Writes a float to dst like the %g conversion of printf, dst has room for LESMA_FORMAT_FLOAT_SIZE bytes.
+ * Returns how many bytes were written, no null terminator is added.
+ */
+int64_t lesma_format_float(char *dst, double value);
+
+/**
+ * Reads a line from the standard input without its newline, growing the string as needed. Returns the empty
+ * string at the end of the input.
+ */
+char *lesma_string_read_line(void);
+
+/**
+ * Write a value to the buffered standard output, without parsing a format string. The buffer is written out when
+ * it's full, on lesma_flush and at exit, or after every newline when the output is a terminal. Every call writes
+ * its value whole, even with other threads writing at the same time.
+ */
+void lesma_write_string(const char *str);
+void lesma_write_int(int64_t value);
+void lesma_write_float(double value);
+void lesma_write_newline(void);
+
+/**
+ * Writes out the standard output buffer, after anything buffered by the C library.
+ */
+void lesma_flush(void);
+
+/**
+ * Ends the program with an error message, after writing out the standard output. Generated code calls it for
+ * errors only found at runtime, like a range whose step is zero.
+ */
+void lesma_panic(const char *message);
+
+/**
+ * Buffered writer to a file, with the same buffering as the standard output. Whatever is still buffered is
+ * written out at exit if the writer wasn't closed. Failing to open the file ends the program with an error.
+ * Writers can be shared between threads, but not used after another thread closed them.
+ */
+typedef struct lesma_writer lesma_writer;
+
+lesma_writer *lesma_writer_open(const char *path, int64_t append);
+void lesma_writer_write_string(lesma_writer *writer, const char *str);
+void lesma_writer_write_int(lesma_writer *writer, int64_t value);
+void lesma_writer_write_float(lesma_writer *writer, double value);
+void lesma_writer_flush(lesma_writer *writer);
+void lesma_writer_close(lesma_writer *writer);
+
+/**
+ * Checks whether something exists at the given path.
+ */
+bool lesma_file_exists(const char *path);
+
+/**
+ * Deletes a file, returns false if it couldn't be deleted.
+ */
+bool lesma_file_remove(const char *path);
+
+/**
+ * Maps a whole file into memory as a read-only string, without copying it. Pages are read by the system when
+ * they are first touched, so files bigger than memory can be scanned. The file must not shrink while it's mapped.
+ */
+char *lesma_file_map(const char *path);
+
+/**
+ * Releases a string returned by lesma_file_map, it must not be used afterwards.
+ */
+void lesma_file_unmap(const char *contents);
+
+/**
+ * Reads a file line by line through a fixed buffer, however big the file is. Lines are returned without their
+ * newline, or carriage return and newline.
+ */
+typedef struct lesma_reader lesma_reader;
+
+lesma_reader *lesma_reader_open(const char *path);
+
+/**
+ * Advances to the next line, returns false at the end of the file.
+ */
+bool lesma_reader_next(lesma_reader *reader);
+
+/**
+ * Returns the current line. The string is reused by the next call to lesma_reader_next, and freed by
+ * lesma_reader_close, so it has to be copied to be kept.
+ */
+char *lesma_reader_line(lesma_reader *reader);
+void lesma_reader_close(lesma_reader *reader);
+
+/**
+ * Function run by a task, given the arguments it was spawned with.
+ */
+typedef void (*lesma_task_function)(void *env);
+
+/**
+ * Allocates a task running function, with env_size bytes for its arguments and result. Returns the argument
+ * storage, which identifies the task in the other lesma_task functions and is filled before lesma_task_spawn.
+ */
+void *lesma_task_new(lesma_task_function function, int64_t env_size);
+
+/**
+ * Queues a task on the work-stealing pool. The pool starts with the first task, with one worker less than the
+ * LESMA_THREADS environment variable or the number of processors, since joining threads run tasks as well.
+ * Tasks spawned by a worker go to the bottom of its own deque, idle workers steal from the top of the others.
+ */
+void lesma_task_spawn(void *env);
+
+/**
+ * Waits until a task is done, running it right here if no thread started it yet. Its result can be read afterwards.
+ * Other tasks never run meanwhile, one of them could wait on a channel for something done after the join.
+ */
+void lesma_task_join(void *env);
+
+/**
+ * Releases a joined task.
+ */
+void lesma_task_free(void *env);
+
+/**
+ * Tells the pool the current thread is about to block, on a channel or a task it joins, until lesma_task_unblocked.
+ * If tasks are queued and no worker is idle to run them, a spare thread is started for them, so tasks waiting for
+ * each other can't hold every thread of the pool. There are never more spare threads than blocked ones, and they
+ * leave once there are no tasks left.
+ */
+void lesma_task_blocking(void);
+void lesma_task_unblocked(void);
+
+/**
+ * Outlined body of a parallel loop, running iterations [begin, end) with the captured variables in env. Calls made
+ * with the same slot never overlap, so the slot indexes partial results of the loop.
+ */
+typedef void (*lesma_loop_function)(void *env, int64_t begin, int64_t end, int64_t slot);
+
+/**
+ * Number of slots parallel loops use, one per thread of the pool, which is started if needed.
+ */
+int64_t lesma_parallel_slots(void);
+
+/**
+ * Sets the partial results of a parallel loop, one for each of its slots and size bytes apiece, to identity.
+ */
+void lesma_parallel_fill(void *partials, const void *identity, int64_t size);
+
+/**
+ * Runs iterations [0, count) of a parallel loop on the pool and returns once all of them ran. Chunks of chunk
+ * iterations are handed out as threads get to them, or each thread gets an equal share if chunk is zero.
+ */
+void lesma_parallel_for(lesma_loop_function function, void *env, int64_t count, int64_t chunk);
+
+/**
+ * Typed channels between threads. Elements are copied in and out by value, element_size bytes of them, which the
+ * compiler takes from the LLVM type of the element. Channels are either a single producer single consumer ring or
+ * a bounded multi-producer multi-consumer queue of at least two, both with their capacity rounded up to a power of two, or an
+ * unbounded multi-producer multi-consumer list of blocks. Operations are lock-free until a channel is full or
+ * empty: then the thread spins for a while and parks until another thread makes it ready or closes it.
+ */
+#define LESMA_CHANNEL_UNBOUNDED 0
+#define LESMA_CHANNEL_MPMC 1
+#define LESMA_CHANNEL_SPSC 2
+
+/**
+ * Creates a channel of one of the kinds above, the capacity of unbounded channels is ignored.
+ */
+void *lesma_channel_new(int64_t kind, int64_t capacity, int64_t element_size);
+
+/**
+ * Copies value into the channel, waiting for room if it's full. Returns false without sending once the channel is
+ * closed, a value sent while another thread closes the channel may be lost.
+ */
+bool lesma_channel_send(void *channel, const void *value);
+
+/**
+ * Copies the oldest value of the channel into value, waiting for one if it's empty. Values sent before the
+ * channel was closed are still received, after them false is returned and value is left as it was.
+ */
+bool lesma_channel_recv(void *channel, void *value);
+
+/**
+ * Receives from the first of count channels that has a value, waiting for one if none has. Channels are tried
+ * from a different one on every call, so none of them starves the others. Returns the index of the channel, or -1
+ * once all of them are closed and empty.
+ */
+int64_t lesma_channel_select(void **channels, int64_t count, void *value);
+
+/**
+ * Closes a channel, waking the threads waiting on it.
+ */
+void lesma_channel_close(void *channel);
+bool lesma_channel_closed(void *channel);
+
+/**
+ * Releases a channel nobody uses anymore, with the values left in it.
+ */
+void lesma_channel_free(void *channel);
+
+/**
+ * Start of the promise of every coroutine, the frame of an async function. Resuming the coroutine calls
+ * resume(frame), a function generated next to it, so the runtime doesn't depend on how LLVM lays out the frame.
+ */
+typedef struct lesma_coroutine {
+    void (*resume)(void *frame);
+    void *frame;
+} lesma_coroutine;
+
+/**
+ * Queues a suspended coroutine on the ready queue of the current thread. A coroutine awaiting another one is queued
+ * when that one finishes, and async extern functions receive the coroutine awaiting them to queue once they're done.
+ */
+void lesma_async_ready(lesma_coroutine *coroutine);
+
+/**
+ * Resumes the oldest coroutine in the ready queue of the current thread, until it suspends again or finishes.
+ * When nothing is ready it waits for the event loop, and if no I/O is pending either, the awaited coroutine can
+ * never finish and the program is aborted. The awaited coroutine is passed so the compiler knows its frame may
+ * change, it's otherwise unused.
+ */
+void lesma_async_step(void *awaited);
+
+/**
+ * Asynchronous I/O on the event loop of the current thread, which uses io_uring when the kernel supports it and
+ * epoll otherwise, or when the LESMA_EVENT_LOOP environment variable is set to epoll. These are async extern
+ * functions: they get the coroutine awaiting them, queued once the operation completed, and where to store the
+ * result if there is one. Failing operations end the program with an error, like the other I/O functions.
+ */
+
+/**
+ * Reads up to size bytes from a descriptor, as soon as some are available. Returns the empty string at the end.
+ */
+void lesma_event_read(lesma_coroutine *coroutine, char **result, int64_t fd, int64_t size);
+
+/**
+ * Reads into a string allocated with room for some bytes, like the buffers of lesma_net_buffer_acquire, as soon as
+ * some are available, and returns it. Returns it empty at the end.
+ */
+void lesma_event_read_into(lesma_coroutine *coroutine, char **result, int64_t fd, char *buffer);
+
+/**
+ * Writes a whole string to a descriptor, and returns how many bytes were written. A connection closed by the other
+ * end stops the write early, and makes reads return the empty string.
+ */
+void lesma_event_write(lesma_coroutine *coroutine, int64_t *result, int64_t fd, const char *data);
+
+/**
+ * Reads a whole file into a string.
+ */
+void lesma_event_read_file(lesma_coroutine *coroutine, char **result, const char *path);
+
+/**
+ * Writes a string to a file, which is replaced or appended to, and returns how many bytes were written.
+ */
+void lesma_event_write_file(lesma_coroutine *coroutine, int64_t *result, const char *path, const char *data, int64_t append);
+
+/**
+ * Wait until a descriptor can be read from or written to without blocking.
+ */
+void lesma_event_readable(lesma_coroutine *coroutine, int64_t fd);
+void lesma_event_writable(lesma_coroutine *coroutine, int64_t fd);
+
+/**
+ * Waits for the given number of nanoseconds, without blocking the thread.
+ */
+void lesma_event_sleep(lesma_coroutine *coroutine, int64_t nanoseconds);
+
+/**
+ * Closes a descriptor that operations of the event loop used, which has to forget about it before the number is
+ * reused. Returns the result of close.
+ */
+int64_t lesma_event_close(int64_t fd);
+
+/**
+ * Creates a non-blocking pipe, and returns the descriptor of its read end in the lower 32 bits and of its write end
+ * in the upper 32 bits.
+ */
+int64_t lesma_event_pipe(void);
+
+/**
+ * Queues the coroutines of the operations of the current thread that completed, waiting for at least one of
+ * them if wait is set. Returns false when no operation is pending, so nothing would ever complete.
+ */
+bool lesma_event_poll(bool wait);
+
+/**
+ * Non-blocking TCP sockets, waited for with the event loop. Hosts are resolved with getaddrinfo, the empty host
+ * listens on every interface. Writing to a closed connection doesn't raise SIGPIPE, which these ignore. Failing to
+ * listen or connect ends the program with an error.
+ */
+
+/**
+ * Listens on a port of a host, or a free one if port is 0, and returns the descriptor. With reuse_port, several
+ * listeners of the same user can bind the same port, and the kernel spreads connections between them.
+ */
+int64_t lesma_net_listen(const char *host, int64_t port, int64_t reuse_port);
+
+/**
+ * Returns the port a socket is bound to.
+ */
+int64_t lesma_net_local_port(int64_t fd);
+
+/**
+ * Accepts a connection waiting on a listener without blocking, returns -1 when there is none yet.
+ */
+int64_t lesma_net_accept(int64_t fd);
+
+/**
+ * Connection being made to a port of a host, trying its addresses in order until one of them accepts.
+ * lesma_net_connect starts with the first address that doesn't fail right away, and lesma_net_connecting is the
+ * descriptor of the current one, writable once its connection went through or failed. lesma_net_connected then
+ * returns that descriptor and releases the attempt, or starts on the next address and returns -1.
+ * Exits with an error once every address failed.
+ */
+typedef struct lesma_connect lesma_connect;
+
+lesma_connect *lesma_net_connect(const char *host, int64_t port);
+int64_t lesma_net_connecting(lesma_connect *attempt);
+int64_t lesma_net_connected(lesma_connect *attempt);
+
+/**
+ * Takes an empty string with room for LESMA_NET_BUFFER_SIZE bytes from a pool of the current thread, to read
+ * a connection into. Released buffers go back to the pool of the thread releasing them.
+ */
+#define LESMA_NET_BUFFER_SIZE 16384
+
+char *lesma_net_buffer_acquire(void);
+void lesma_net_buffer_release(char *buffer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,260 @@
+#include "Runtime.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LESMA_STRING_MIN_CAPACITY 64
+
+/* Significant digits of a float, the default precision of %g */
+#define LESMA_FLOAT_DIGITS 6
+
+/* Every string is the bytes right after a header, so a string is also a valid C string */
+#define LESMA_STRING_HEADER(str) ((lesma_string_header *) (str) -1)
+
+static const char digit_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+/* Powers of ten that are exact doubles */
+static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const struct {
+    lesma_string_header header;
+    char data[1];
+} empty_string = {{0, 0}, ""};
+
+#define LESMA_EMPTY_STRING ((char *) empty_string.data)
+
+/* Allocates a string with room for capacity bytes, holding the first length of them */
+static char *string_alloc(int64_t length, int64_t capacity) {
+    lesma_string_header *header = lesma_alloc((int64_t) sizeof(lesma_string_header) + capacity + 1);
+    header->length = length;
+    header->capacity = capacity;
+
+    char *str = (char *) (header + 1);
+    str[length] = '\0';
+    return str;
+}
+
+static char *string_copy(const char *data, int64_t length) {
+    if (length == 0)
+        return LESMA_EMPTY_STRING;
+
+    char *str = string_alloc(length, length);
+    memcpy(str, data, (size_t) length);
+    return str;
+}
+
+int64_t lesma_string_length(const char *str) {
+    return LESMA_STRING_HEADER(str)->length;
+}
+
+char *lesma_string_from_c(const char *str) {
+    if (str == NULL)
+        return LESMA_EMPTY_STRING;
+
+    return string_copy(str, (int64_t) strlen(str));
+}
+
+char *lesma_string_concat(const char *left, const char *right) {
+    int64_t left_length = lesma_string_length(left);
+    int64_t right_length = lesma_string_length(right);
+
+    /* Strings are immutable, so one side can be returned as it is */
+    if (right_length == 0)
+        return (char *) left;
+    if (left_length == 0)
+        return (char *) right;
+
+    char *str = string_alloc(left_length + right_length, left_length + right_length);
+    memcpy(str, left, (size_t) left_length);
+    memcpy(str + left_length, right, (size_t) right_length);
+    return str;
+}
+
+bool lesma_string_equal(const char *left, const char *right) {
+    if (left == right)
+        return true;
+
+    int64_t length = lesma_string_length(left);
+    if (length != lesma_string_length(right))
+        return false;
+
+    return memcmp(left, right, (size_t) length) == 0;
+}
+
+int64_t lesma_string_compare(const char *left, const char *right) {
+    int64_t left_length = lesma_string_length(left);
+    int64_t right_length = lesma_string_length(right);
+
+    int result = memcmp(left, right, (size_t) (left_length < right_length ? left_length : right_length));
+    if (result != 0)
+        return result;
+
+    return left_length < right_length ? -1 : left_length > right_length;
+}
+
+char *lesma_string_slice(const char *str, int64_t start, int64_t end) {
+    int64_t length = lesma_string_length(str);
+
+    /* Negative indices count from the end, anything out of range is clamped like in Python */
+    if (start < 0)
+        start = start + length < 0 ? 0 : start + length;
+    if (end < 0)
+        end = end + length < 0 ? 0 : end + length;
+    if (start > length)
+        start = length;
+    if (end > length)
+        end = length;
+
+    if (start == 0 && end == length)
+        return (char *) str;
+    if (start >= end)
+        return LESMA_EMPTY_STRING;
+
+    return string_copy(str + start, end - start);
+}
+
+char *lesma_string_read_line(void) {
+    int64_t length = 0;
+    int64_t capacity = LESMA_STRING_MIN_CAPACITY;
+    char *str = string_alloc(0, capacity);
+
+    while (fgets(str + length, (int) (capacity - length + 1), stdin) != NULL) {
+        length += (int64_t) strlen(str + length);
+        if (length > 0 && str[length - 1] == '\n') {
+            str[--length] = '\0';
+            break;
+        }
+
+        /* Stopped before filling the buffer, so the input ended without a newline */
+        if (length < capacity)
+            break;
+
+        char *grown = string_alloc(length, capacity * 2);
+        memcpy(grown, str, (size_t) length);
+        lesma_free(LESMA_STRING_HEADER(str));
+        str = grown;
+        capacity *= 2;
+    }
+
+    LESMA_STRING_HEADER(str)->length = length;
+    str[length] = '\0';
+    return str;
+}
+
+int64_t lesma_format_int(char *dst, int64_t value) {
+    char buffer[LESMA_FORMAT_INT_SIZE];
+    char *end = buffer + sizeof(buffer);
+    char *cursor = end;
+
+    /* Two digits at a time, from the back */
+    uint64_t remaining = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+    while (remaining >= 100) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + (remaining % 100) * 2, 2);
+        remaining /= 100;
+    }
+    if (remaining >= 10) {
+        cursor -= 2;
+        memcpy(cursor, digit_pairs + remaining * 2, 2);
+    } else {
+        *--cursor = (char) ('0' + remaining);
+    }
+    if (value < 0)
+        *--cursor = '-';
+
+    memcpy(dst, cursor, (size_t) (end - cursor));
+    return end - cursor;
+}
+
+int64_t lesma_format_float(char *dst, double value) {
+    char *cursor = dst;
+    if (isnan(value)) {
+        if (signbit(value))
+            *cursor++ = '-';
+        memcpy(cursor, "nan", 3);
+        return cursor - dst + 3;
+    }
+    if (signbit(value)) {
+        *cursor++ = '-';
+        value = -value;
+    }
+    if (isinf(value)) {
+        memcpy(cursor, "inf", 3);
+        return cursor - dst + 3;
+    }
+    if (value == 0) {
+        *cursor++ = '0';
+        return cursor - dst;
+    }
+
+    /* Scale to the six significant digits %g prints, with a single exact power of ten so only one rounding happens */
+    int exponent = (int) floor(log10(value));
+    int shift = LESMA_FLOAT_DIGITS - 1 - exponent;
+    if (shift < -22 || shift > 22)
+        goto fallback;
+
+    double scaled = shift >= 0 ? value * powers_of_ten[shift] : value / powers_of_ten[-shift];
+    double digits = nearbyint(scaled);
+
+    /* log10 is off by one next to powers of ten, and ties need the exact decimal expansion, both go to the C library */
+    if (digits < 1e5 || digits > 1e6 || fabs(fabs(scaled - digits) - 0.5) < 1e-6)
+        goto fallback;
+    if (digits == 1e6) {
+        digits = 1e5;
+        exponent++;
+    }
+
+    char text[LESMA_FLOAT_DIGITS];
+    int64_t mantissa = (int64_t) digits;
+    for (int i = LESMA_FLOAT_DIGITS - 1; i >= 0; i--, mantissa /= 10)
+        text[i] = (char) ('0' + mantissa % 10);
+
+    int length = LESMA_FLOAT_DIGITS;
+    while (length > 1 && text[length - 1] == '0')
+        length--;
+
+    if (exponent >= -4 && exponent < LESMA_FLOAT_DIGITS) {
+        if (exponent < 0) {
+            memcpy(cursor, "0.", 2);
+            cursor += 2;
+            for (int i = -1; i > exponent; i--)
+                *cursor++ = '0';
+            memcpy(cursor, text, (size_t) length);
+            return cursor - dst + length;
+        }
+
+        int whole = exponent + 1;
+        if (length <= whole) {
+            memcpy(cursor, text, (size_t) length);
+            memset(cursor + length, '0', (size_t) (whole - length));
+            return cursor - dst + whole;
+        }
+        memcpy(cursor, text, (size_t) whole);
+        cursor[whole] = '.';
+        memcpy(cursor + whole + 1, text + whole, (size_t) (length - whole));
+        return cursor - dst + length + 1;
+    }
+
+    *cursor++ = text[0];
+    if (length > 1) {
+        *cursor++ = '.';
+        memcpy(cursor, text + 1, (size_t) (length - 1));
+        cursor += length - 1;
+    }
+    *cursor++ = 'e';
+    *cursor++ = exponent < 0 ? '-' : '+';
+    int magnitude = exponent < 0 ? -exponent : exponent;
+    if (magnitude >= 100)
+        *cursor++ = (char) ('0' + magnitude / 100);
+    memcpy(cursor, digit_pairs + (magnitude % 100) * 2, 2);
+    return cursor - dst + 2;
+
+fallback:
+    return (cursor - dst) + snprintf(cursor, LESMA_FORMAT_FLOAT_SIZE - (size_t) (cursor - dst), "%g", value);
+}
@@ -0,0 +1,573 @@
+/* _SC_NPROCESSORS_ONLN and sched_yield are not part of strict C11 */
+#define _DEFAULT_SOURCE
+
+#include "Runtime.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LESMA_DEQUE_INITIAL_SIZE 256
+#define LESMA_MAX_THREADS 1024
+
+/* Rounds an idle worker looks for work before it goes to sleep */
+#define LESMA_IDLE_ROUNDS 64
+
+/* Joiners only park once a task ran longer than it takes them to look this many times */
+#define LESMA_JOIN_ROUNDS 64
+
+/* Parking lots joiners wait in, shared by the tasks that hash to them */
+#define LESMA_PARKING_LOTS 64
+
+enum {
+    LESMA_TASK_PENDING,
+    /* Pending, and a joiner is parked on it */
+    LESMA_TASK_WAITED,
+    LESMA_TASK_DONE
+};
+
+/*
+ * A task is allocated together with the arguments it was spawned with, which follow its header. Generated code
+ * only sees the arguments, the task is found in front of them like the header of a string.
+ */
+typedef struct lesma_task {
+    lesma_task_function function;
+    struct lesma_task *next;
+    atomic_int state;
+} lesma_task;
+
+#define LESMA_TASK_HEADER ((sizeof(lesma_task) + 15) & ~(size_t) 15)
+#define LESMA_TASK_OF(env) ((lesma_task *) ((char *) (env) -LESMA_TASK_HEADER))
+#define LESMA_TASK_ENV(task) ((char *) (task) + LESMA_TASK_HEADER)
+
+/*
+ * Chase-Lev deque, as described in "Correct and Efficient Work-Stealing for Weak Memory Models" by Lê et al., with
+ * sequentially consistent accesses to top and bottom in place of its fences. The owning worker pushes and takes at
+ * the bottom, other threads steal from the top.
+ */
+typedef struct lesma_deque_array {
+    int64_t size;
+    /* Smaller arrays this one replaced, a thief may still be reading them so they're never freed */
+    struct lesma_deque_array *retired;
+    _Atomic(lesma_task *) tasks[];
+} lesma_deque_array;
+
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    _Atomic(lesma_deque_array *) array;
+} lesma_deque;
+
+typedef struct {
+    lesma_deque deque;
+    pthread_t thread;
+} lesma_worker;
+
+static lesma_worker *workers = NULL;
+static int worker_count = 0;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static _Thread_local lesma_worker *current_worker = NULL;
+static _Thread_local uint64_t steal_seed = 0;
+
+/* Tasks spawned by threads that aren't workers, like the main thread, wait here in order */
+static pthread_mutex_t injected_lock = PTHREAD_MUTEX_INITIALIZER;
+static lesma_task *injected_head = NULL;
+static lesma_task *injected_tail = NULL;
+static _Atomic int64_t injected_count = 0;
+
+/* Workers that found nothing to do sleep until a task is spawned */
+static pthread_mutex_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleep_cond = PTHREAD_COND_INITIALIZER;
+static _Atomic int sleepers = 0;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} lesma_parking_lot;
+
+static lesma_parking_lot parking_lots[LESMA_PARKING_LOTS];
+static pthread_once_t parking_once = PTHREAD_ONCE_INIT;
+
+/* Threads started for blocked threads, which leave once they run out of tasks */
+static _Atomic int spares = 0;
+static _Atomic int blocked = 0;
+
+static void *checked_alloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "lesma: out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return ptr;
+}
+
+static lesma_deque_array *deque_array_new(int64_t size) {
+    lesma_deque_array *array = checked_alloc(sizeof(lesma_deque_array) + (size_t) size * sizeof(lesma_task *));
+    array->size = size;
+    array->retired = NULL;
+    return array;
+}
+
+static void deque_init(lesma_deque *deque) {
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, deque_array_new(LESMA_DEQUE_INITIAL_SIZE));
+}
+
+static lesma_deque_array *deque_grow(lesma_deque *deque, lesma_deque_array *array, int64_t top, int64_t bottom) {
+    lesma_deque_array *grown = deque_array_new(array->size * 2);
+    for (int64_t i = top; i < bottom; i++) {
+        lesma_task *task = atomic_load_explicit(&array->tasks[i & (array->size - 1)], memory_order_relaxed);
+        atomic_store_explicit(&grown->tasks[i & (grown->size - 1)], task, memory_order_relaxed);
+    }
+
+    grown->retired = array;
+    atomic_store_explicit(&deque->array, grown, memory_order_release);
+    return grown;
+}
+
+static void deque_push(lesma_deque *deque, lesma_task *task) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    lesma_deque_array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    if (bottom - top > array->size - 1)
+        array = deque_grow(deque, array, top, bottom);
+
+    atomic_store_explicit(&array->tasks[bottom & (array->size - 1)], task, memory_order_relaxed);
+    /* Sequentially consistent rather than release, it's ordered before the check for sleeping workers */
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_seq_cst);
+}
+
+static lesma_task *deque_take(lesma_deque *deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    lesma_deque_array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    /* Thieves either see the smaller bottom, or we see their larger top */
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    lesma_task *task = atomic_load_explicit(&array->tasks[bottom & (array->size - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        /* The last task, a thief might be taking it at the same time */
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+            task = NULL;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static lesma_task *deque_steal(lesma_deque *deque) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_seq_cst);
+    if (top >= bottom)
+        return NULL;
+
+    lesma_deque_array *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    lesma_task *task = atomic_load_explicit(&array->tasks[top & (array->size - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+    return task;
+}
+
+static bool deque_empty(lesma_deque *deque) {
+    return atomic_load(&deque->top) >= atomic_load(&deque->bottom);
+}
+
+static void inject(lesma_task *task) {
+    task->next = NULL;
+    pthread_mutex_lock(&injected_lock);
+    if (injected_tail != NULL)
+        injected_tail->next = task;
+    else
+        injected_head = task;
+    injected_tail = task;
+    atomic_fetch_add(&injected_count, 1);
+    pthread_mutex_unlock(&injected_lock);
+}
+
+static lesma_task *take_injected(void) {
+    if (atomic_load_explicit(&injected_count, memory_order_relaxed) == 0)
+        return NULL;
+
+    pthread_mutex_lock(&injected_lock);
+    lesma_task *task = injected_head;
+    if (task != NULL) {
+        injected_head = task->next;
+        if (injected_head == NULL)
+            injected_tail = NULL;
+        atomic_fetch_sub(&injected_count, 1);
+    }
+    pthread_mutex_unlock(&injected_lock);
+    return task;
+}
+
+static uint64_t next_random(void) {
+    /* xorshift64, only used to spread thieves over the workers */
+    if (steal_seed == 0)
+        steal_seed = (uint64_t) (uintptr_t) &steal_seed | 1;
+    steal_seed ^= steal_seed << 13;
+    steal_seed ^= steal_seed >> 7;
+    steal_seed ^= steal_seed << 17;
+    return steal_seed;
+}
+
+static lesma_task *steal_any(void) {
+    if (worker_count == 0)
+        return NULL;
+
+    int start = (int) (next_random() % (uint64_t) worker_count);
+    for (int i = 0; i < worker_count; i++) {
+        lesma_worker *victim = &workers[(start + i) % worker_count];
+        if (victim == current_worker)
+            continue;
+
+        lesma_task *task = deque_steal(&victim->deque);
+        if (task != NULL)
+            return task;
+    }
+    return NULL;
+}
+
+static lesma_task *find_task(void) {
+    lesma_task *task = NULL;
+    if (current_worker != NULL)
+        task = deque_take(&current_worker->deque);
+    if (task == NULL)
+        task = take_injected();
+    if (task == NULL)
+        task = steal_any();
+    return task;
+}
+
+static void init_parking_lots(void) {
+    for (int i = 0; i < LESMA_PARKING_LOTS; i++) {
+        pthread_mutex_init(&parking_lots[i].lock, NULL);
+        pthread_cond_init(&parking_lots[i].cond, NULL);
+    }
+}
+
+static lesma_parking_lot *parking_lot_of(lesma_task *task) {
+    pthread_once(&parking_once, init_parking_lots);
+    /* Tasks are at least 16 bytes apart */
+    return &parking_lots[((uintptr_t) task >> 4) % LESMA_PARKING_LOTS];
+}
+
+static bool task_done(lesma_task *task) {
+    return atomic_load_explicit(&task->state, memory_order_acquire) == LESMA_TASK_DONE;
+}
+
+static void run_task(lesma_task *task) {
+    task->function(LESMA_TASK_ENV(task));
+
+    /* A joiner marks the task before it parks and checks it under the lock of its lot, so it's always woken */
+    if (atomic_exchange_explicit(&task->state, LESMA_TASK_DONE, memory_order_acq_rel) == LESMA_TASK_WAITED) {
+        lesma_parking_lot *lot = parking_lot_of(task);
+        pthread_mutex_lock(&lot->lock);
+        pthread_cond_broadcast(&lot->cond);
+        pthread_mutex_unlock(&lot->lock);
+    }
+}
+
+/* Waits for a task another thread runs, briefly looking before parking in the lot of the task */
+static void wait_done(lesma_task *task) {
+    for (int round = 0; round < LESMA_JOIN_ROUNDS; round++) {
+        if (task_done(task))
+            return;
+        sched_yield();
+    }
+
+    lesma_parking_lot *lot = parking_lot_of(task);
+    pthread_mutex_lock(&lot->lock);
+    int expected = LESMA_TASK_PENDING;
+    atomic_compare_exchange_strong_explicit(&task->state, &expected, LESMA_TASK_WAITED, memory_order_acq_rel, memory_order_acquire);
+    while (!task_done(task))
+        pthread_cond_wait(&lot->cond, &lot->lock);
+    pthread_mutex_unlock(&lot->lock);
+}
+
+static bool has_work(void) {
+    if (atomic_load(&injected_count) > 0)
+        return true;
+    for (int i = 0; i < worker_count; i++)
+        if (!deque_empty(&workers[i].deque))
+            return true;
+    return false;
+}
+
+static void sleep_until_work(void) {
+    /* Spawning makes the task visible before checking for sleepers, and sleepers announce themselves before
+     * checking for tasks, so one side always sees the other */
+    pthread_mutex_lock(&sleep_lock);
+    atomic_fetch_add(&sleepers, 1);
+    while (!has_work())
+        pthread_cond_wait(&sleep_cond, &sleep_lock);
+    atomic_fetch_sub(&sleepers, 1);
+    pthread_mutex_unlock(&sleep_lock);
+}
+
+static void wake_sleeper(void) {
+    if (atomic_load(&sleepers) == 0)
+        return;
+
+    pthread_mutex_lock(&sleep_lock);
+    pthread_cond_signal(&sleep_cond);
+    pthread_mutex_unlock(&sleep_lock);
+}
+
+static void *worker_main(void *arg) {
+    current_worker = arg;
+
+    int idle = 0;
+    while (true) {
+        lesma_task *task = find_task();
+        if (task != NULL) {
+            run_task(task);
+            idle = 0;
+        } else if (++idle < LESMA_IDLE_ROUNDS) {
+            sched_yield();
+        } else {
+            sleep_until_work();
+            idle = 0;
+        }
+    }
+    return NULL;
+}
+
+static void *spare_main(void *arg) {
+    (void) arg;
+    for (int idle = 0; idle < LESMA_IDLE_ROUNDS; idle++) {
+        lesma_task *task = find_task();
+        if (task != NULL) {
+            run_task(task);
+            idle = 0;
+        } else {
+            sched_yield();
+        }
+    }
+    atomic_fetch_sub(&spares, 1);
+    return NULL;
+}
+
+static int thread_count(void) {
+    const char *threads = getenv("LESMA_THREADS");
+    long count = threads != NULL ? strtol(threads, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+        count = 1;
+    return count > LESMA_MAX_THREADS ? LESMA_MAX_THREADS : (int) count;
+}
+
+static void start_pool(void) {
+    /* The thread that joins a task helps running tasks while it waits, so it counts as one of the threads */
+    int count = thread_count() - 1;
+    workers = checked_alloc(sizeof(lesma_worker) * (size_t) (count > 0 ? count : 1));
+    for (int i = 0; i < count; i++)
+        deque_init(&workers[i].deque);
+    worker_count = count;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    /* A worker that can't be started leaves an empty deque behind, its share of the work goes to the others */
+    for (int i = 0; i < count; i++)
+        pthread_create(&workers[i].thread, &attr, worker_main, &workers[i]);
+    pthread_attr_destroy(&attr);
+}
+
+void *lesma_task_new(lesma_task_function function, int64_t env_size) {
+    lesma_task *task = checked_alloc(LESMA_TASK_HEADER + (size_t) env_size);
+    task->function = function;
+    task->next = NULL;
+    atomic_init(&task->state, LESMA_TASK_PENDING);
+    return LESMA_TASK_ENV(task);
+}
+
+void lesma_task_spawn(void *env) {
+    pthread_once(&pool_once, start_pool);
+
+    lesma_task *task = LESMA_TASK_OF(env);
+    if (current_worker != NULL)
+        deque_push(&current_worker->deque, task);
+    else
+        inject(task);
+    wake_sleeper();
+}
+
+/* Takes a task nobody started yet out of the queue it's in, if it's at the bottom of our deque or injected */
+static bool take_queued(lesma_task *task) {
+    if (current_worker != NULL) {
+        lesma_task *bottom = deque_take(&current_worker->deque);
+        if (bottom == task)
+            return true;
+        if (bottom != NULL)
+            deque_push(&current_worker->deque, bottom);
+        return false;
+    }
+
+    if (atomic_load_explicit(&injected_count, memory_order_relaxed) == 0)
+        return false;
+
+    bool taken = false;
+    pthread_mutex_lock(&injected_lock);
+    lesma_task *previous = NULL;
+    for (lesma_task *queued = injected_head; queued != NULL; previous = queued, queued = queued->next) {
+        if (queued != task)
+            continue;
+
+        if (previous != NULL)
+            previous->next = task->next;
+        else
+            injected_head = task->next;
+        if (injected_tail == task)
+            injected_tail = previous;
+        atomic_fetch_sub(&injected_count, 1);
+        taken = true;
+        break;
+    }
+    pthread_mutex_unlock(&injected_lock);
+    return taken;
+}
+
+void lesma_task_join(void *env) {
+    lesma_task *task = LESMA_TASK_OF(env);
+    if (task_done(task))
+        return;
+
+    /* Usually the task is still at the bottom of our own deque and runs right here */
+    if (take_queued(task)) {
+        run_task(task);
+        return;
+    }
+
+    /* Otherwise another thread runs it, or will once it gets to it */
+    lesma_task_blocking();
+    wait_done(task);
+    lesma_task_unblocked();
+}
+
+void lesma_task_blocking(void) {
+    pthread_once(&pool_once, start_pool);
+    int now_blocked = atomic_fetch_add(&blocked, 1) + 1;
+    if (!has_work())
+        return;
+
+    /* A sleeping worker can take the queued tasks, otherwise a spare thread does */
+    if (atomic_load(&sleepers) > 0) {
+        wake_sleeper();
+        return;
+    }
+    if (atomic_fetch_add(&spares, 1) >= (now_blocked < LESMA_MAX_THREADS ? now_blocked : LESMA_MAX_THREADS)) {
+        atomic_fetch_sub(&spares, 1);
+        return;
+    }
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, spare_main, NULL) != 0)
+        atomic_fetch_sub(&spares, 1);
+    pthread_attr_destroy(&attr);
+}
+
+void lesma_task_unblocked(void) {
+    atomic_fetch_sub(&blocked, 1);
+}
+
+void lesma_task_free(void *env) {
+    free(LESMA_TASK_OF(env));
+}
+
+/* A parallel loop lives on the stack of the thread running it, which returns only after every share is done */
+typedef struct {
+    lesma_loop_function function;
+    void *env;
+    int64_t count;
+    int64_t chunk;
+    int64_t shares;
+    _Atomic int64_t next;
+} lesma_loop;
+
+typedef struct {
+    lesma_loop *loop;
+    int64_t slot;
+} lesma_loop_share;
+
+static void run_share(lesma_loop *loop, int64_t slot) {
+    if (loop->chunk == 0) {
+        /* The first count % shares shares get one more iteration */
+        int64_t size = loop->count / loop->shares;
+        int64_t rest = loop->count % loop->shares;
+        int64_t begin = slot * size + (slot < rest ? slot : rest);
+        int64_t end = begin + size + (slot < rest ? 1 : 0);
+        if (begin < end)
+            loop->function(loop->env, begin, end, slot);
+        return;
+    }
+
+    while (true) {
+        int64_t begin = atomic_fetch_add_explicit(&loop->next, loop->chunk, memory_order_relaxed);
+        if (begin >= loop->count)
+            return;
+        int64_t end = loop->count - begin > loop->chunk ? begin + loop->chunk : loop->count;
+        loop->function(loop->env, begin, end, slot);
+    }
+}
+
+static void share_main(void *env) {
+    lesma_loop_share *share = env;
+    run_share(share->loop, share->slot);
+}
+
+int64_t lesma_parallel_slots(void) {
+    pthread_once(&pool_once, start_pool);
+    return worker_count + 1;
+}
+
+void lesma_parallel_fill(void *partials, const void *identity, int64_t size) {
+    int64_t slots = lesma_parallel_slots();
+    for (int64_t slot = 0; slot < slots; slot++)
+        memcpy((char *) partials + slot * size, identity, (size_t) size);
+}
+
+void lesma_parallel_for(lesma_loop_function function, void *env, int64_t count, int64_t chunk) {
+    if (count <= 0)
+        return;
+
+    int64_t shares = lesma_parallel_slots();
+    if (chunk < 0)
+        chunk = 1;
+    /* Every share should get at least one iteration or chunk */
+    int64_t pieces = chunk == 0 ? count : (count - 1) / chunk + 1;
+    if (shares > pieces)
+        shares = pieces;
+
+    lesma_loop loop = {.function = function, .env = env, .count = count, .chunk = chunk, .shares = shares};
+    atomic_init(&loop.next, 0);
+
+    /* The other shares are queued first so idle workers pick them up while this thread runs the first one */
+    lesma_loop_share *others[LESMA_MAX_THREADS];
+    for (int64_t slot = 1; slot < shares; slot++) {
+        lesma_loop_share *share = lesma_task_new(share_main, sizeof(lesma_loop_share));
+        share->loop = &loop;
+        share->slot = slot;
+        lesma_task_spawn(share);
+        others[slot] = share;
+    }
+
+    run_share(&loop, 0);
+
+    /* Latest first, the shares nobody took are still at the bottom of our deque in that order */
+    for (int64_t slot = shares - 1; slot > 0; slot--) {
+        lesma_task_join(others[slot]);
+        lesma_task_free(others[slot]);
+    }
+}
@@ -2,9 +2,17 @@
 
 #include "liblesma/Backend/Codegen.h"
 #include "liblesma/Common/Utils.h"
+#include "liblesma/Driver/Driver.h"
+#include "liblesma/Driver/Engine.h"
+#include "liblesma/Driver/Server.h"
 #include "liblesma/Frontend/Lexer.h"
 #include "liblesma/Frontend/Parser.h"
 
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <sys/wait.h>
+#include <thread>
 #include <vector>
 
 using namespace lesma;
@@ -134,7 +142,7 @@ TEST_F(ParserTest, AST) {
     EXPECT_EQ(parser->getAST()->getChildren().at(1)->toString(srcMgr.get(), "", true), "└──Assignment[Line(2-2):Col(1-8)]: y EQUAL 101\n");
 }
 
-// We cannot return from top-level, and the exit function just exits the whole process including the test
+// The exit code comes back from the JIT, the exit function would end the whole process including the test
 TEST_F(CodegenTest, Run) {
     codegen->Optimize(OptimizationLevel::O3);
     codegen->PrepareJIT();
@@ -143,6 +151,156 @@ TEST_F(CodegenTest, Run) {
     EXPECT_TRUE(exit_code == 0);
 }
 
+static int64_t fib(int64_t n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+// Every program gets its own context and JIT, so they can be compiled and run on many threads of one process.
+// LESMA_STRESS_PROGRAMS and LESMA_STRESS_THREADS override how many programs and threads, build with the
+// ThreadSanitizer preset to look for races.
+TEST(DriverTest, ConcurrentRuns) {
+    unsigned programs = getenv("LESMA_STRESS_PROGRAMS") ? std::stoul(getenv("LESMA_STRESS_PROGRAMS")) : 1000;
+    unsigned threads = getenv("LESMA_STRESS_THREADS") ? std::stoul(getenv("LESMA_STRESS_THREADS")) : std::max(4u, std::thread::hardware_concurrency());
+
+    std::atomic<unsigned> next = 0;
+    std::atomic<unsigned> failures = 0;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (unsigned i = next++; i < programs; i = next++) {
+                // A wrong text returns an exit code, counted with the programs that failed to compile or run
+                std::string expected = std::to_string(i + 4950) + " " + std::to_string(fib(i % 20));
+                auto options = std::make_unique<Options>();
+                options->sourceType = SourceType::STRING;
+                options->source =
+                        "class Counter\n"
+                        "    var value: int\n"
+                        "\n"
+                        "    def new(value: int)\n"
+                        "        self.value = value\n"
+                        "\n"
+                        "def fib(n: int) -> int\n"
+                        "    if n < 2\n"
+                        "        return n\n"
+                        "    return fib(n - 1) + fib(n - 2)\n"
+                        "\n"
+                        "let task = spawn fib(" + std::to_string(i % 20) + ")\n"
+                        "let counter = Counter(" + std::to_string(i) + ")\n"
+                        "for j in 0..100\n"
+                        "    counter.value = counter.value + j\n"
+                        "let text = \"{counter.value} {join task}\"\n"
+                        "if text != \"" + expected + "\"\n"
+                        "    return 1\n"
+                        "delete counter\n";
+
+                if (Driver::Run(std::move(options)) != 0)
+                    failures++;
+            }
+        });
+    }
+
+    for (auto &worker: workers)
+        worker.join();
+
+    EXPECT_EQ(failures.load(), 0);
+}
+
+// Exported functions are found by their name and signature, and called through the handle from any thread
+TEST(EngineTest, Call) {
+    auto engine = Engine::FromSource(
+            "export def add(a: int, b: int) -> int\n"
+            "    return a + b\n"
+            "\n"
+            "export def half(x: float) -> float\n"
+            "    return x / 2.0\n"
+            "\n"
+            "export def positive(x: int) -> bool\n"
+            "    return x > 0\n"
+            "\n"
+            "def hidden(x: int) -> int\n"
+            "    return x\n");
+
+    auto add = engine->get<int64_t(int64_t, int64_t)>("add");
+    EXPECT_EQ(add(40, 2), 42);
+    EXPECT_EQ(engine->get<double(double)>("half")(5.0), 2.5);
+    EXPECT_TRUE(engine->get<bool(int64_t)>("positive")(3));
+    EXPECT_FALSE(engine->get<bool(int64_t)>("positive")(-3));
+
+    EXPECT_THROW(engine->get<double(int64_t, int64_t)>("add"), LesmaError);
+    EXPECT_THROW(engine->get<int64_t(int64_t)>("hidden"), LesmaError);
+    EXPECT_THROW(engine->get<void()>("missing"), LesmaError);
+
+    std::vector<std::thread> workers;
+    std::atomic<int64_t> total = 0;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&] {
+            int64_t sum = 0;
+            for (int64_t i = 0; i < 100000; i++)
+                sum = add(sum, i);
+            total += sum;
+        });
+    }
+    for (auto &worker: workers)
+        worker.join();
+    EXPECT_EQ(total.load(), 4 * 4999950000);
+}
+
+TEST(EngineTest, CompileError) {
+    try {
+        Engine::FromSource("export def broken() -> int\n    return missing\n");
+        FAIL() << "Expected a compile error";
+    } catch (const LesmaError &err) {
+        EXPECT_EQ(std::string(err.what()), "<source>:2:12: Unknown variable name missing");
+    }
+}
+
+// Requests run in forks of the server, with the environment of their client, and report how the fork exited
+TEST(ServerTest, Forward) {
+    // In a directory of its own, the shared temporary directory would let anyone else swap the socket
+    auto directory = (std::filesystem::temp_directory_path() / "lesma-test-XXXXXX").string();
+    ASSERT_NE(mkdtemp(directory.data()), nullptr);
+    auto socketPath = directory + "/server.sock";
+    EXPECT_FALSE(Client::Forward(socketPath, {"lesma", "0"}).has_value());
+
+    pid_t server = fork();
+    if (server == 0) {
+        _exit(Server::Serve(socketPath, [](const std::vector<std::string> &args) {
+            if (args[1] == "abort")
+                abort();
+            if (args[1] == "environment")
+                return getenv("LESMA_TEST_VALUE") != nullptr && std::string(getenv("LESMA_TEST_VALUE")) == "42" ? 0 : 1;
+            return std::stoi(args[1]);
+        }));
+    }
+
+    // The fork may not have started listening yet
+    std::optional<int> exit_code;
+    for (int i = 0; i < 1000 && !exit_code; i++) {
+        exit_code = Client::Forward(socketPath, {"lesma", "7"});
+        if (!exit_code)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(exit_code.value_or(-1), 7);
+
+    using std::filesystem::perms;
+    EXPECT_EQ(std::filesystem::status(socketPath).permissions() & (perms::group_all | perms::others_all), perms::none);
+
+    setenv("LESMA_TEST_VALUE", "42", 1);
+    EXPECT_EQ(Client::Forward(socketPath, {"lesma", "environment"}).value_or(-1), 0);
+    unsetenv("LESMA_TEST_VALUE");
+    EXPECT_EQ(Client::Forward(socketPath, {"lesma", "environment"}).value_or(-1), 1);
+    EXPECT_EQ(Client::Forward(socketPath, {"lesma", "abort"}).value_or(-1), 128 + SIGABRT);
+
+    EXPECT_THROW(Server::Serve(socketPath, [](const std::vector<std::string> &) { return 0; }), LesmaError);
+
+    int status;
+    kill(server, SIGTERM);
+    waitpid(server, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    EXPECT_FALSE(std::filesystem::exists(socketPath));
+    std::filesystem::remove_all(directory);
+}
+
 // Google Test main function
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);